@@ -0,0 +1,290 @@
+#ifndef _MATH_AFFINE_
+#define _MATH_AFFINE_
+
+#include <iostream>
+#include <cstddef>
+#include <type_traits>
+
+#include "vector.hpp"
+#include "matrix.hpp"
+
+namespace math
+{
+/**
+ * Affine transform class, p * linear + translation for row vectors
+ *
+ * Same transform as matrix4 whose last column is (0, 0, 0, 1), but the
+ * constant column is neither stored nor multiplied: 12 values instead of 16
+ * and compose takes 36 multiplies instead of 64. Composition follows matrix
+ * product, (a * b).to_matrix4() == a.to_matrix4() * b.to_matrix4(), so a is
+ * applied first.
+ */
+template<class T>
+class affine3
+{
+    typedef T type;
+
+public:
+    /**
+     * Linear part
+     */
+    matrix3<T> linear;
+
+    /**
+     * Translation
+     */
+    vector3<T> translation;
+
+    /**
+     * Construct identity transform
+     */
+    constexpr affine3() :
+        linear(), translation(T(0))
+    {
+    }
+
+    /**
+     * Construct transform of linear part followed by translation
+     */
+    constexpr affine3(const matrix3<T> &linear,
+                      const vector3<T> &translation = vector3<T>(T(0))) :
+        linear(linear), translation(translation)
+    {
+    }
+
+    /**
+     * Construct transform from upper 3x3 part and last row of matrix, last
+     * column is ignored
+     */
+    explicit constexpr affine3(const matrix4<T> &m) :
+        linear(m(0, 0), m(0, 1), m(0, 2),
+               m(1, 0), m(1, 1), m(1, 2),
+               m(2, 0), m(2, 1), m(2, 2)),
+        translation(m(3, 0), m(3, 1), m(3, 2))
+    {
+    }
+
+    /**
+     * Set transform of linear part followed by translation
+     */
+    inline constexpr affine3<T> &set(const matrix3<T> &linear,
+                                     const vector3<T> &translation)
+    {
+        this->linear = linear;
+        this->translation = translation;
+        return *this;
+    }
+
+    /**
+     * Set transform from matrix, last column is ignored
+     */
+    inline constexpr affine3<T> &set(const matrix4<T> &m)
+    {
+        *this = affine3<T>(m);
+        return *this;
+    }
+
+    /**
+     * Set identity transform
+     */
+    inline constexpr affine3<T> &set_identity()
+    {
+        linear.set_identity();
+        translation.set(T(0), T(0), T(0));
+        return *this;
+    }
+
+    /**
+     * Operator *=, rhs is applied after this
+     */
+    inline constexpr affine3<T> &operator *=(const affine3<T> &rhs)
+    {
+        *this = *this * rhs;
+        return *this;
+    }
+
+    /**
+     * Operator *, compose transforms, rhs is applied after this
+     */
+    inline constexpr affine3<T> operator *(const affine3<T> &rhs) const
+    {
+        vector3<T> r0 = linear(0) * rhs.linear;
+        vector3<T> r1 = linear(1) * rhs.linear;
+        vector3<T> r2 = linear(2) * rhs.linear;
+        return affine3<T>(matrix3<T>(r0.x, r0.y, r0.z,
+                                     r1.x, r1.y, r1.z,
+                                     r2.x, r2.y, r2.z),
+                          translation * rhs.linear + rhs.translation);
+    }
+
+    /**
+     * Operator ==
+     */
+    inline constexpr bool operator ==(const affine3<T> &rhs) const
+    {
+        return linear == rhs.linear && translation == rhs.translation;
+    }
+
+    /**
+     * Operator !=
+     */
+    inline constexpr bool operator !=(const affine3<T> &rhs) const
+    {
+        return !operator ==(rhs);
+    }
+
+    /**
+     * @return inversed transform, undefined for singular linear part
+     */
+    inline constexpr affine3<T> get_inverse() const
+    {
+        matrix3<T> m = linear.get_inverse();
+        return affine3<T>(m, -(translation * m));
+    }
+
+    /**
+     * Set inversed transform
+     */
+    inline constexpr affine3<T> &inverse()
+    {
+        *this = get_inverse();
+        return *this;
+    }
+
+    /**
+     * @return inversed rigid transform, linear part must be orthonormal
+     */
+    inline constexpr affine3<T> get_inverse_rigid() const
+    {
+        matrix3<T> m = linear.get_transpose();
+        return affine3<T>(m, -(translation * m));
+    }
+
+    /**
+     * Set inversed rigid transform
+     */
+    inline constexpr affine3<T> &inverse_rigid()
+    {
+        *this = get_inverse_rigid();
+        return *this;
+    }
+
+    /**
+     * @return transformed point
+     */
+    inline constexpr vector3<T> transform(const vector3<T> &rhs) const
+    {
+        return rhs * linear + translation;
+    }
+
+    /**
+     * @return transformed direction, translation is ignored
+     */
+    inline constexpr vector3<T> transform_direction(const vector3<T> &rhs) const
+    {
+        return rhs * linear;
+    }
+
+    /**
+     * Transform n points, in and out may be equal
+     */
+    inline void transform_points(const vector3<T> *in, vector3<T> *out,
+                                 std::size_t n) const
+    {
+        transform_points(reinterpret_cast<const T *>(in), sizeof(vector3<T>),
+                         reinterpret_cast<T *>(out), sizeof(vector3<T>), n);
+    }
+
+    /**
+     * Transform n points (x, y, z) placed stride bytes apart,
+     * in and out may be equal
+     */
+    inline void transform_points(const T *in, std::size_t in_stride,
+                                 T *out, std::size_t out_stride,
+                                 std::size_t n) const
+    {
+        transform3(in, in_stride, out, out_stride, n, T(1));
+    }
+
+    /**
+     * Transform n directions, in and out may be equal
+     */
+    inline void transform_directions(const vector3<T> *in, vector3<T> *out,
+                                     std::size_t n) const
+    {
+        transform_directions(reinterpret_cast<const T *>(in),
+                             sizeof(vector3<T>), reinterpret_cast<T *>(out),
+                             sizeof(vector3<T>), n);
+    }
+
+    /**
+     * Transform n directions (x, y, z) placed stride bytes apart,
+     * in and out may be equal
+     */
+    inline void transform_directions(const T *in, std::size_t in_stride,
+                                     T *out, std::size_t out_stride,
+                                     std::size_t n) const
+    {
+        transform3(in, in_stride, out, out_stride, n, T(0));
+    }
+
+    /**
+     * @return transform matrix for row vectors
+     */
+    inline constexpr matrix4<T> to_matrix4() const
+    {
+        const matrix3<T> &m = linear;
+        const vector3<T> &t = translation;
+        return matrix4<T>(m(0, 0), m(0, 1), m(0, 2), T(0),
+                          m(1, 0), m(1, 1), m(1, 2), T(0),
+                          m(2, 0), m(2, 1), m(2, 2), T(0),
+                          t.x, t.y, t.z, T(1));
+    }
+
+    /**
+     * @return affine transform of matrix, last column is ignored
+     */
+    static inline affine3<T> from_matrix(const matrix4<T> &m)
+    {
+        return affine3<T>(m);
+    }
+
+    friend inline std::ostream &operator <<(std::ostream &lhs,
+                                            const affine3<T> &rhs)
+    {
+        return lhs << "(" << rhs.linear << ", " << rhs.translation << ")";
+    }
+
+private:
+    inline void transform3(const T *in, std::size_t in_stride,
+                           T *out, std::size_t out_stride,
+                           std::size_t n, T w) const
+    {
+        const T m00 = linear(0, 0), m01 = linear(0, 1), m02 = linear(0, 2);
+        const T m10 = linear(1, 0), m11 = linear(1, 1), m12 = linear(1, 2);
+        const T m20 = linear(2, 0), m21 = linear(2, 1), m22 = linear(2, 2);
+        const T m30 = translation.x * w, m31 = translation.y * w;
+        const T m32 = translation.z * w;
+        const char *src = reinterpret_cast<const char *>(in);
+        char *dst = reinterpret_cast<char *>(out);
+        for (std::size_t i = 0; i < n; i++)
+        {
+            const T *p = reinterpret_cast<const T *>(src + i * in_stride);
+            T *q = reinterpret_cast<T *>(dst + i * out_stride);
+            T x = p[0], y = p[1], z = p[2];
+            q[0] = x * m00 + y * m10 + z * m20 + m30;
+            q[1] = x * m01 + y * m11 + z * m21 + m31;
+            q[2] = x * m02 + y * m12 + z * m22 + m32;
+        }
+    }
+};
+
+typedef affine3<float> affine3f;
+typedef affine3<double> affine3d;
+typedef affine3<long double> affine3ld;
+
+static_assert(std::is_trivially_copyable<affine3<double> >::value,
+              "affine3 must be trivially copyable");
+}
+
+#endif
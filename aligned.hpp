@@ -0,0 +1,72 @@
+#ifndef _MATH_ALIGNED_
+#define _MATH_ALIGNED_
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstdint>
+#include <new>
+
+namespace math
+{
+/**
+ * Allocator returning memory aligned to A bytes
+ */
+template<class T, std::size_t A = 64>
+class aligned_allocator
+{
+public:
+    typedef T value_type;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+
+    template<class U>
+    struct rebind
+    {
+        typedef aligned_allocator<U, A> other;
+    };
+
+    aligned_allocator()
+    {
+    }
+
+    template<class U>
+    aligned_allocator(const aligned_allocator<U, A> &)
+    {
+    }
+
+    /**
+     * Allocate n elements, original block pointer is kept right before
+     * the aligned address
+     */
+    inline T *allocate(std::size_t n)
+    {
+        void *p = std::malloc(n * sizeof(T) + A + sizeof(void *));
+        if (!p)
+            throw std::bad_alloc();
+        std::uintptr_t b = reinterpret_cast<std::uintptr_t>(p) + sizeof(void *);
+        b = (b + A - 1) & ~std::uintptr_t(A - 1);
+        reinterpret_cast<void **>(b)[-1] = p;
+        return reinterpret_cast<T *>(b);
+    }
+
+    inline void deallocate(T *p, std::size_t)
+    {
+        if (p)
+            std::free(reinterpret_cast<void **>(p)[-1]);
+    }
+
+    template<class U>
+    inline bool operator ==(const aligned_allocator<U, A> &) const
+    {
+        return true;
+    }
+
+    template<class U>
+    inline bool operator !=(const aligned_allocator<U, A> &) const
+    {
+        return false;
+    }
+};
+}
+
+#endif
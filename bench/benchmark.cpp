@@ -0,0 +1,555 @@
+/**
+ * Throughput of every operation of vector.hpp, matrix.hpp and quaternion.hpp
+ * for float, double and long double
+ *
+ *     benchmark [--time ms] [--filter text] [--json file]
+ *
+ * Every operation runs over arrays of elements inputs until time is spent,
+ * default 20 ms, and reports nanoseconds per operation and GFLOP/s. Flops
+ * are counted from generic formulas, division and square root count as one
+ * flop, comparisons and copies as none. --filter runs operations whose
+ * "type name" contains text, --json writes results to file, "-" is stdout.
+ * Operations named "x8" process 8 elements per call with packet.hpp.
+ * Dispatched batch kernels are reported under the name of their instruction
+ * set level, MATH_ISA environment variable selects a lower level, e.g.
+ * MATH_ISA=sse2 benchmark --filter sse2.
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "aligned.hpp"
+#include "vector.hpp"
+#include "matrix.hpp"
+#include "quaternion.hpp"
+#include "dispatch.hpp"
+#include "packet.hpp"
+
+using namespace math;
+
+typedef std::chrono::steady_clock clock_type;
+
+/**
+ * Number of elements of every input and output array
+ */
+static const std::size_t elements = 1024;
+
+template<class T>
+using array = std::vector<T, aligned_allocator<T> >;
+
+/**
+ * Make compiler assume memory was read and written, so results of previous
+ * repetition are not dropped and inputs are not hoisted
+ */
+static inline void clobber()
+{
+#if defined(__GNUC__)
+    asm volatile("" : : : "memory");
+#endif
+}
+
+class harness
+{
+public:
+    harness(double time, const char *filter) :
+        time(time), filter(filter)
+    {
+    }
+
+    /**
+     * Time out[i] = f(i) over all elements
+     */
+    template<class R, class F>
+    void op(const char *type, const char *name, double flops, F f)
+    {
+        if (!match(type, name))
+            return;
+        array<R> out(elements);
+        double ns = measure([&]()
+        {
+            for (std::size_t i = 0; i < elements; i++)
+                out[i] = f(i);
+        });
+        add(type, name, flops, ns);
+    }
+
+    /**
+     * Time f() processing all elements at once
+     */
+    template<class F>
+    void batch(const char *type, const char *name, double flops, F f)
+    {
+        if (!match(type, name))
+            return;
+        add(type, name, flops, measure(f));
+    }
+
+    void print() const
+    {
+        std::printf("%-12s %-28s %10s %10s\n", "type", "operation", "ns/op",
+                    "GFLOP/s");
+        for (std::size_t i = 0; i < results.size(); i++)
+            std::printf("%-12s %-28s %10.3f %10.3f\n",
+                        results[i].type.c_str(), results[i].name.c_str(),
+                        results[i].ns, results[i].gflops);
+    }
+
+    bool json(const char *path) const
+    {
+        std::FILE *f = std::strcmp(path, "-") ? std::fopen(path, "w") : stdout;
+        if (!f)
+            return false;
+        std::fprintf(f, "{\n  \"elements\": %zu,\n  \"results\": [\n",
+                     elements);
+        for (std::size_t i = 0; i < results.size(); i++)
+            std::fprintf(f, "    {\"type\": \"%s\", \"name\": \"%s\", "
+                         "\"ns\": %.4f, \"gflops\": %.4f}%s\n",
+                         results[i].type.c_str(), results[i].name.c_str(),
+                         results[i].ns, results[i].gflops,
+                         i + 1 < results.size() ? "," : "");
+        std::fprintf(f, "  ]\n}\n");
+        if (f != stdout)
+            std::fclose(f);
+        return true;
+    }
+
+private:
+    struct result
+    {
+        std::string type, name;
+        double ns, gflops;
+    };
+
+    double time;
+    const char *filter;
+    std::vector<result> results;
+
+    bool match(const char *type, const char *name) const
+    {
+        return !filter ||
+               (std::string(type) + " " + name).find(filter) !=
+               std::string::npos;
+    }
+
+    /**
+     * @return nanoseconds per element, repetitions double until time is
+     * spent
+     */
+    template<class F>
+    double measure(F f) const
+    {
+        for (std::size_t reps = 1; ; reps *= 2)
+        {
+            clock_type::time_point begin = clock_type::now();
+            for (std::size_t r = 0; r < reps; r++)
+            {
+                f();
+                clobber();
+            }
+            double s = std::chrono::duration<double>(clock_type::now() -
+                                                     begin).count();
+            if (s * 1e3 >= time)
+                return s * 1e9 / double(reps * elements);
+        }
+    }
+
+    void add(const char *type, const char *name, double flops, double ns)
+    {
+        result r = {type, name, ns, flops / ns};
+        results.push_back(r);
+    }
+};
+
+/**
+ * Random inputs, values in [0.5, 1.5], diagonally dominant matrices and
+ * unit quaternions
+ */
+template<class T>
+struct inputs
+{
+    array<T> s, t;
+    array<vector2<T> > a2, b2;
+    array<vector3<T> > a3, b3;
+    array<vector4<T> > a4, b4;
+    array<matrix3<T> > m3, n3;
+    array<matrix4<T> > m4, n4;
+    array<quaternion<T> > p, q;
+
+    inputs() :
+        s(elements), t(elements), a2(elements), b2(elements), a3(elements),
+        b3(elements), a4(elements), b4(elements), m3(elements), n3(elements),
+        m4(elements), n4(elements), p(elements), q(elements)
+    {
+        std::mt19937 g(1);
+        std::uniform_real_distribution<double> d(0.5, 1.5);
+        auto r = [&]() { return T(d(g)); };
+        for (std::size_t i = 0; i < elements; i++)
+        {
+            s[i] = r();
+            t[i] = r() - T(0.5);
+            a2[i].set(r(), r());
+            b2[i].set(r(), r());
+            a3[i].set(r(), r(), r());
+            b3[i].set(r(), r(), r());
+            a4[i].set(r(), r(), r(), r());
+            b4[i].set(r(), r(), r(), r());
+            for (unsigned int k = 0; k < 9; k++)
+                m3[i][k] = r() + T(k % 4 ? 0 : 4);
+            for (unsigned int k = 0; k < 9; k++)
+                n3[i][k] = r() + T(k % 4 ? 0 : 4);
+            for (unsigned int k = 0; k < 16; k++)
+                m4[i][k] = r() + T(k % 5 ? 0 : 4);
+            for (unsigned int k = 0; k < 16; k++)
+                n4[i][k] = r() + T(k % 5 ? 0 : 4);
+            p[i] = quaternion<T>(r(), r(), r(), r()).get_normalize();
+            q[i] = quaternion<T>(r(), r(), r(), r()).get_normalize();
+        }
+    }
+};
+
+/**
+ * Operations common to vector2, vector3 and vector4 of n components
+ */
+template<class T, class V>
+void vector_ops(harness &h, const char *type, const array<V> &a,
+                const array<V> &b, const array<T> &s, double n)
+{
+    h.op<V>(type, "+=", n, [&](std::size_t i)
+            { V r = a[i]; r += b[i]; return r; });
+    h.op<V>(type, "+", n, [&](std::size_t i)
+            { return a[i] + b[i]; });
+    h.op<V>(type, "-=", n, [&](std::size_t i)
+            { V r = a[i]; r -= b[i]; return r; });
+    h.op<V>(type, "unary -", n, [&](std::size_t i)
+            { return -a[i]; });
+    h.op<V>(type, "-", n, [&](std::size_t i)
+            { return a[i] - b[i]; });
+    h.op<V>(type, "*= scalar", n, [&](std::size_t i)
+            { V r = a[i]; r *= s[i]; return r; });
+    h.op<V>(type, "* scalar", n, [&](std::size_t i)
+            { return a[i] * s[i]; });
+    h.op<V>(type, "scalar *", n, [&](std::size_t i)
+            { return s[i] * a[i]; });
+    h.op<V>(type, "/= scalar", n, [&](std::size_t i)
+            { V r = a[i]; r /= s[i]; return r; });
+    h.op<V>(type, "/ scalar", n, [&](std::size_t i)
+            { return a[i] / s[i]; });
+    h.op<int>(type, "==", 0, [&](std::size_t i)
+              { return int(a[i] == b[i]); });
+    h.op<int>(type, "!=", 0, [&](std::size_t i)
+              { return int(a[i] != b[i]); });
+    h.op<T>(type, "dot", 2 * n - 1, [&](std::size_t i)
+            { return dot(a[i], b[i]); });
+    h.op<T>(type, "norm", 2 * n, [&](std::size_t i)
+            { return a[i].norm(); });
+    h.op<V>(type, "normalize", 3 * n, [&](std::size_t i)
+            { return a[i].normalize(); });
+    h.op<V>(type, "normalize_fast", 3 * n, [&](std::size_t i)
+            { return a[i].normalize_fast(); });
+    array<V> out(elements);
+    h.batch(type, "normalize_fast batch", 3 * n, [&]()
+            { normalize_fast(a.data(), out.data(), elements); });
+}
+
+template<class T>
+void matrix3_ops(harness &h, const char *type, const inputs<T> &in)
+{
+    typedef matrix3<T> M;
+    typedef vector3<T> V;
+    const array<M> &m = in.m3, &n = in.n3;
+    const array<V> &v = in.a3;
+    const array<T> &s = in.s;
+    h.op<M>(type, "+=", 9, [&](std::size_t i)
+            { M r = m[i]; r += n[i]; return r; });
+    h.op<M>(type, "+", 9, [&](std::size_t i)
+            { return m[i] + n[i]; });
+    h.op<M>(type, "*= scalar", 9, [&](std::size_t i)
+            { M r = m[i]; r *= s[i]; return r; });
+    h.op<M>(type, "*= matrix3", 45, [&](std::size_t i)
+            { M r = m[i]; r *= n[i]; return r; });
+    h.op<M>(type, "*= vector3", 54, [&](std::size_t i)
+            { M r = m[i]; r *= v[i]; return r; });
+    h.op<V>(type, "vector3 *=", 15, [&](std::size_t i)
+            { V r = v[i]; r *= m[i]; return r; });
+    h.op<M>(type, "* matrix3", 45, [&](std::size_t i)
+            { return m[i] * n[i]; });
+    h.op<M>(type, "* vector3", 54, [&](std::size_t i)
+            { return m[i] * v[i]; });
+    h.op<V>(type, "vector3 *", 15, [&](std::size_t i)
+            { return v[i] * m[i]; });
+    h.op<int>(type, "==", 0, [&](std::size_t i)
+              { return int(m[i] == n[i]); });
+    h.op<int>(type, "!=", 0, [&](std::size_t i)
+              { return int(m[i] != n[i]); });
+    h.op<M>(type, "get_transpose", 0, [&](std::size_t i)
+            { return m[i].get_transpose(); });
+    h.op<M>(type, "transpose", 0, [&](std::size_t i)
+            { M r = m[i]; r.transpose(); return r; });
+    h.op<T>(type, "get_determinant", 14, [&](std::size_t i)
+            { return m[i].get_determinant(); });
+    h.op<M>(type, "get_inverse", 42, [&](std::size_t i)
+            { return m[i].get_inverse(); });
+    h.op<M>(type, "inverse", 42, [&](std::size_t i)
+            { M r = m[i]; r.inverse(); return r; });
+    array<V> out(elements);
+    h.batch(type, "transform_points", 15, [&]()
+            { m[0].transform_points(v.data(), out.data(), elements); });
+    h.batch(type, "transform_directions", 15, [&]()
+            { m[0].transform_directions(v.data(), out.data(), elements); });
+    h.batch(type, "solve", 51, [&]()
+            { solve(m.data(), v.data(), out.data(), elements); });
+}
+
+template<class T>
+void matrix4_ops(harness &h, const char *type, const inputs<T> &in)
+{
+    typedef matrix4<T> M;
+    typedef vector4<T> V;
+    const array<M> &m = in.m4, &n = in.n4;
+    const array<V> &v = in.a4;
+    const array<vector3<T> > &v3 = in.a3;
+    const array<T> &s = in.s;
+    h.op<M>(type, "+=", 16, [&](std::size_t i)
+            { M r = m[i]; r += n[i]; return r; });
+    h.op<M>(type, "+", 16, [&](std::size_t i)
+            { return m[i] + n[i]; });
+    h.op<M>(type, "*= scalar", 16, [&](std::size_t i)
+            { M r = m[i]; r *= s[i]; return r; });
+    h.op<M>(type, "*= matrix4", 112, [&](std::size_t i)
+            { M r = m[i]; r *= n[i]; return r; });
+    h.op<M>(type, "*= vector4", 128, [&](std::size_t i)
+            { M r = m[i]; r *= v[i]; return r; });
+    h.op<V>(type, "vector4 *=", 28, [&](std::size_t i)
+            { V r = v[i]; r *= m[i]; return r; });
+    h.op<M>(type, "* matrix4", 112, [&](std::size_t i)
+            { return m[i] * n[i]; });
+    h.op<M>(type, "* vector4", 128, [&](std::size_t i)
+            { return m[i] * v[i]; });
+    h.op<V>(type, "vector4 *", 28, [&](std::size_t i)
+            { return v[i] * m[i]; });
+    h.op<int>(type, "==", 0, [&](std::size_t i)
+              { return int(m[i] == n[i]); });
+    h.op<int>(type, "!=", 0, [&](std::size_t i)
+              { return int(m[i] != n[i]); });
+    h.op<M>(type, "get_transpose", 0, [&](std::size_t i)
+            { return m[i].get_transpose(); });
+    h.op<M>(type, "transpose", 0, [&](std::size_t i)
+            { return m[i].transpose(); });
+    h.op<T>(type, "get_determinant", 47, [&](std::size_t i)
+            { return m[i].get_determinant(); });
+    h.op<M>(type, "get_inverse", 144, [&](std::size_t i)
+            { return m[i].get_inverse(); });
+    h.op<M>(type, "inverse", 144, [&](std::size_t i)
+            { M r = m[i]; r.inverse(); return r; });
+    h.op<M>(type, "get_inverse_affine", 57, [&](std::size_t i)
+            { return m[i].get_inverse_affine(); });
+    h.op<M>(type, "inverse_affine", 57, [&](std::size_t i)
+            { M r = m[i]; r.inverse_affine(); return r; });
+    h.op<M>(type, "get_inverse_rigid", 15, [&](std::size_t i)
+            { return m[i].get_inverse_rigid(); });
+    h.op<M>(type, "inverse_rigid", 15, [&](std::size_t i)
+            { M r = m[i]; r.inverse_rigid(); return r; });
+    array<vector3<T> > out3(elements);
+    array<V> out4(elements);
+    h.batch(type, "transform_points vector3", 18, [&]()
+            { m[0].transform_points(v3.data(), out3.data(), elements); });
+    h.batch(type, "transform_points vector4", 28, [&]()
+            { m[0].transform_points(v.data(), out4.data(), elements); });
+    h.batch(type, "transform_directions vector3", 15, [&]()
+            { m[0].transform_directions(v3.data(), out3.data(), elements); });
+    h.batch(type, "transform_directions vector4", 28, [&]()
+            { m[0].transform_directions(v.data(), out4.data(), elements); });
+    h.batch(type, "solve", 75, [&]()
+            { solve(m.data(), v.data(), out4.data(), elements); });
+}
+
+template<class T>
+void quaternion_ops(harness &h, const char *type, const inputs<T> &in)
+{
+    typedef quaternion<T> Q;
+    typedef vector3<T> V;
+    const array<Q> &p = in.p, &q = in.q;
+    const array<V> &v = in.a3;
+    const array<T> &s = in.s, &t = in.t;
+    h.op<Q>(type, "+= scalar", 1, [&](std::size_t i)
+            { Q r = p[i]; r += s[i]; return r; });
+    h.op<Q>(type, "+= vector3", 3, [&](std::size_t i)
+            { Q r = p[i]; r += v[i]; return r; });
+    h.op<Q>(type, "+= quaternion", 4, [&](std::size_t i)
+            { Q r = p[i]; r += q[i]; return r; });
+    h.op<Q>(type, "+ scalar", 1, [&](std::size_t i)
+            { return p[i] + s[i]; });
+    h.op<Q>(type, "+ vector3", 3, [&](std::size_t i)
+            { return p[i] + v[i]; });
+    h.op<Q>(type, "+ quaternion", 4, [&](std::size_t i)
+            { return p[i] + q[i]; });
+    h.op<Q>(type, "scalar +", 1, [&](std::size_t i)
+            { return s[i] + p[i]; });
+    h.op<Q>(type, "vector3 +", 3, [&](std::size_t i)
+            { return v[i] + p[i]; });
+    h.op<Q>(type, "-= scalar", 1, [&](std::size_t i)
+            { Q r = p[i]; r -= s[i]; return r; });
+    h.op<Q>(type, "-= vector3", 3, [&](std::size_t i)
+            { Q r = p[i]; r -= v[i]; return r; });
+    h.op<Q>(type, "-= quaternion", 4, [&](std::size_t i)
+            { Q r = p[i]; r -= q[i]; return r; });
+    h.op<Q>(type, "- scalar", 1, [&](std::size_t i)
+            { return p[i] - s[i]; });
+    h.op<Q>(type, "- vector3", 3, [&](std::size_t i)
+            { return p[i] - v[i]; });
+    h.op<Q>(type, "- quaternion", 4, [&](std::size_t i)
+            { return p[i] - q[i]; });
+    h.op<Q>(type, "scalar -", 4, [&](std::size_t i)
+            { return s[i] - p[i]; });
+    h.op<Q>(type, "vector3 -", 4, [&](std::size_t i)
+            { return v[i] - p[i]; });
+    h.op<Q>(type, "*= scalar", 4, [&](std::size_t i)
+            { Q r = p[i]; r *= s[i]; return r; });
+    h.op<Q>(type, "*= vector3", 20, [&](std::size_t i)
+            { Q r = p[i]; r *= v[i]; return r; });
+    h.op<Q>(type, "*= quaternion", 28, [&](std::size_t i)
+            { Q r = p[i]; r *= q[i]; return r; });
+    h.op<Q>(type, "* scalar", 4, [&](std::size_t i)
+            { return p[i] * s[i]; });
+    h.op<Q>(type, "* vector3", 20, [&](std::size_t i)
+            { return p[i] * v[i]; });
+    h.op<Q>(type, "* quaternion", 28, [&](std::size_t i)
+            { return p[i] * q[i]; });
+    h.op<Q>(type, "scalar *", 4, [&](std::size_t i)
+            { return s[i] * p[i]; });
+    h.op<Q>(type, "vector3 *", 20, [&](std::size_t i)
+            { return v[i] * p[i]; });
+    h.op<int>(type, "==", 0, [&](std::size_t i)
+              { return int(p[i] == q[i]); });
+    h.op<int>(type, "!=", 0, [&](std::size_t i)
+              { return int(p[i] != q[i]); });
+    h.op<T>(type, "get_norm", 7, [&](std::size_t i)
+            { return p[i].get_norm(); });
+    h.op<Q>(type, "get_normalize", 13, [&](std::size_t i)
+            { return p[i].get_normalize(); });
+    h.op<Q>(type, "normalize", 13, [&](std::size_t i)
+            { Q r = p[i]; r.normalize(); return r; });
+    h.op<Q>(type, "get_normalize_fast", 13, [&](std::size_t i)
+            { return p[i].get_normalize_fast(); });
+    h.op<Q>(type, "normalize_fast", 13, [&](std::size_t i)
+            { Q r = p[i]; r.normalize_fast(); return r; });
+    h.op<Q>(type, "get_conjugate", 3, [&](std::size_t i)
+            { return p[i].get_conjugate(); });
+    h.op<Q>(type, "conjugate", 3, [&](std::size_t i)
+            { Q r = p[i]; r.conjugate(); return r; });
+    h.op<Q>(type, "get_inverse", 15, [&](std::size_t i)
+            { return p[i].get_inverse(); });
+    h.op<Q>(type, "inverse", 15, [&](std::size_t i)
+            { Q r = p[i]; r.inverse(); return r; });
+    h.op<V>(type, "rotate", 30, [&](std::size_t i)
+            { return p[i].rotate(v[i]); });
+    h.op<matrix3<T> >(type, "to_matrix3", 30, [&](std::size_t i)
+                      { return p[i].to_matrix3(); });
+    h.op<matrix4<T> >(type, "to_matrix4", 30, [&](std::size_t i)
+                      { return p[i].to_matrix4(); });
+    h.op<Q>(type, "from_matrix matrix3", 15, [&](std::size_t i)
+            { return Q::from_matrix(in.m3[i]); });
+    h.op<Q>(type, "from_matrix matrix4", 15, [&](std::size_t i)
+            { return Q::from_matrix(in.m4[i]); });
+    h.op<T>(type, "dot", 7, [&](std::size_t i)
+            { return dot(p[i], q[i]); });
+    h.op<Q>(type, "nlerp", 33, [&](std::size_t i)
+            { return nlerp(p[i], q[i], t[i]); });
+    h.op<Q>(type, "slerp", 92, [&](std::size_t i)
+            { return slerp(p[i], q[i], t[i]); });
+    array<V> out(elements);
+    h.batch(type, "rotate batch", 30, [&]()
+            { p[0].rotate(v.data(), out.data(), elements); });
+    array<Q> normalized(elements);
+    h.batch(type, "normalize_fast batch", 13, [&]()
+            { normalize_fast(p.data(), normalized.data(), elements); });
+    typedef quaternionx8<T> Q8;
+    h.batch(type, "* quaternion x8", 28, [&]()
+    {
+        for (std::size_t i = 0; i < elements; i += 8)
+            (Q8(&p[i]) * Q8(&q[i])).store(&normalized[i]);
+    });
+    h.batch(type, "rotate x8", 30, [&]()
+    {
+        for (std::size_t i = 0; i < elements; i += 8)
+            Q8(&p[i]).rotate(vector3x8<T>(&v[i])).store(&out[i]);
+    });
+    h.batch(type, "slerp x8", 92, [&]()
+    {
+        for (std::size_t i = 0; i < elements; i += 8)
+            slerp(Q8(&p[i]), Q8(&q[i]), scalarx8<T>(&t[i]))
+                .store(&normalized[i]);
+    });
+}
+
+/**
+ * Batch kernels of get_batch_kernels()
+ */
+void dispatch_ops(harness &h)
+{
+    inputs<float> in;
+    const batch_kernels &k = get_batch_kernels();
+    const char *type = get_isa_name(k.get_level());
+    array<vector3<float> > out(elements);
+    h.batch(type, "transform_points", 18, [&]()
+            { k.transform_points(in.m4[0], in.a3.data(), out.data(),
+                                 elements); });
+    h.batch(type, "transform_directions", 15, [&]()
+            { k.transform_directions(in.m4[0], in.a3.data(), out.data(),
+                                     elements); });
+    h.batch(type, "normalize_fast", 9, [&]()
+            { k.normalize_fast(in.a3.data(), out.data(), elements); });
+}
+
+template<class T>
+void run(harness &h, const std::string &suffix)
+{
+    inputs<T> in;
+    std::string v3 = "vector3" + suffix;
+    vector_ops(h, ("vector2" + suffix).c_str(), in.a2, in.b2, in.s, 2);
+    vector_ops(h, v3.c_str(), in.a3, in.b3, in.s, 3);
+    h.op<vector3<T> >(v3.c_str(), "cross", 9, [&](std::size_t i)
+                      { return cross(in.a3[i], in.b3[i]); });
+    vector_ops(h, ("vector4" + suffix).c_str(), in.a4, in.b4, in.s, 4);
+    matrix3_ops(h, ("matrix3" + suffix).c_str(), in);
+    matrix4_ops(h, ("matrix4" + suffix).c_str(), in);
+    quaternion_ops(h, ("quaternion" + suffix).c_str(), in);
+}
+
+int main(int argc, char **argv)
+{
+    double time = 20.0;
+    const char *filter = nullptr, *json = nullptr;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!std::strcmp(argv[i], "--time") && i + 1 < argc)
+            time = std::strtod(argv[++i], nullptr);
+        else if (!std::strcmp(argv[i], "--filter") && i + 1 < argc)
+            filter = argv[++i];
+        else if (!std::strcmp(argv[i], "--json") && i + 1 < argc)
+            json = argv[++i];
+        else
+        {
+            std::fprintf(stderr, "usage: %s [--time ms] [--filter text] "
+                         "[--json file]\n", argv[0]);
+            return 1;
+        }
+    }
+    harness h(time, filter);
+    run<float>(h, "f");
+    run<double>(h, "d");
+    run<long double>(h, "ld");
+    dispatch_ops(h);
+    if (!json || std::strcmp(json, "-"))
+        h.print();
+    if (json && !h.json(json))
+    {
+        std::fprintf(stderr, "cannot write %s\n", json);
+        return 1;
+    }
+    return 0;
+}
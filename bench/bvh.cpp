@@ -0,0 +1,107 @@
+/**
+ * Build time and query throughput of bvh over a noisy terrain mesh
+ *
+ *     g++ -std=c++14 -O2 -pthread -I.. bvh.cpp -o bvh && ./bvh [size]
+ *
+ * Terrain has 2 * size^2 triangles, default size 512.
+ */
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "bvh.hpp"
+
+using namespace math;
+
+typedef std::chrono::steady_clock clock_type;
+
+static double seconds(clock_type::time_point begin)
+{
+    return std::chrono::duration<double>(clock_type::now() - begin).count();
+}
+
+int main(int argc, char **argv)
+{
+    std::size_t size = argc > 1 ? std::strtoul(argv[1], 0, 10) : 512;
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> noise(-0.5f, 0.5f);
+
+    std::vector<float> height((size + 1) * (size + 1));
+    for (std::size_t i = 0; i < height.size(); i++)
+    {
+        float x = float(i % (size + 1)), y = float(i / (size + 1));
+        height[i] = 8.0f * std::sin(x * 0.05f) * std::cos(y * 0.03f) +
+                    noise(random);
+    }
+    std::vector<vector3f> v;
+    v.reserve(6 * size * size);
+    for (std::size_t y = 0; y < size; y++)
+        for (std::size_t x = 0; x < size; x++)
+        {
+            vector3f p[4];
+            for (std::size_t k = 0; k < 4; k++)
+            {
+                std::size_t px = x + k % 2, py = y + k / 2;
+                p[k].set(float(px), height[py * (size + 1) + px], float(py));
+            }
+            v.push_back(p[0]);
+            v.push_back(p[1]);
+            v.push_back(p[2]);
+            v.push_back(p[2]);
+            v.push_back(p[1]);
+            v.push_back(p[3]);
+        }
+    std::size_t n = v.size() / 3;
+
+    clock_type::time_point begin = clock_type::now();
+    bvhf tree(v.data(), n);
+    double build = seconds(begin);
+    std::printf("triangles      %zu\n", n);
+    std::printf("nodes          %zu\n", tree.get_size());
+    std::printf("build          %.3f ms, %.1f Mtri/s\n", build * 1e3,
+                n / build * 1e-6);
+
+    const std::size_t queries = 1 << 20;
+    std::uniform_real_distribution<float> position(0.0f, float(size));
+    std::vector<rayf> rays(queries);
+    for (std::size_t i = 0; i < queries; i++)
+        rays[i].set(vector3f(position(random), 20.0f, position(random)),
+                    vector3f(noise(random), -1.0f, noise(random)));
+
+    std::size_t hits = 0;
+    begin = clock_type::now();
+    for (std::size_t i = 0; i < queries; i++)
+    {
+        float t = 1e30f, u, w;
+        std::uint32_t id;
+        hits += tree.intersect(rays[i], t, u, w, id);
+    }
+    double closest = seconds(begin);
+    std::printf("closest hit    %.2f Mray/s, %zu hits\n",
+                queries / closest * 1e-6, hits);
+
+    hits = 0;
+    begin = clock_type::now();
+    for (std::size_t i = 0; i < queries; i++)
+        hits += tree.occluded(rays[i], 1e30f);
+    double any = seconds(begin);
+    std::printf("any hit        %.2f Mray/s, %zu hits\n",
+                queries / any * 1e-6, hits);
+
+    std::vector<std::uint32_t> ids;
+    const std::size_t boxes = 1 << 16;
+    begin = clock_type::now();
+    for (std::size_t i = 0; i < boxes; i++)
+    {
+        vector3f c(position(random), 0.0f, position(random));
+        vector3f e(2.0f, 10.0f, 2.0f);
+        ids.clear();
+        hits += tree.overlap(aabbf(c - e, c + e), ids);
+    }
+    double overlap = seconds(begin);
+    std::printf("aabb overlap   %.2f Mquery/s\n", boxes / overlap * 1e-6);
+    return 0;
+}
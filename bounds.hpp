@@ -0,0 +1,666 @@
+#ifndef _MATH_BOUNDS_
+#define _MATH_BOUNDS_
+
+#include <iostream>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include "vector.hpp"
+#include "matrix.hpp"
+#include "parallel.hpp"
+
+namespace math
+{
+template<class T> class aabb;
+template<class T> class bsphere;
+
+/**
+ * Axis-aligned bounding box class
+ *
+ * Empty box has min greater than max, so it is neutral for union.
+ */
+template<class T>
+class aabb
+{
+    typedef T type;
+
+public:
+    vector3<T> min, max;
+
+    /**
+     * Number of points reduced by one kernel block
+     */
+    static const std::size_t lanes = 8;
+
+    /**
+     * Construct empty box
+     */
+    constexpr aabb() :
+        min(std::numeric_limits<T>::max()),
+        max(std::numeric_limits<T>::lowest())
+    {
+    }
+
+    /**
+     * Construct box (min, max)
+     */
+    constexpr aabb(const vector3<T> &min, const vector3<T> &max) :
+        min(min), max(max)
+    {
+    }
+
+    /**
+     * Construct box of n points
+     */
+    aabb(const vector3<T> *p, std::size_t n)
+    {
+        set(p, n);
+    }
+
+    /**
+     * Set empty box
+     */
+    inline constexpr aabb<T> &set()
+    {
+        *this = aabb<T>();
+        return *this;
+    }
+
+    /**
+     * Set box (min, max)
+     */
+    inline constexpr aabb<T> &set(const vector3<T> &min, const vector3<T> &max)
+    {
+        this->min = min;
+        this->max = max;
+        return *this;
+    }
+
+    /**
+     * Set box of n points
+     *
+     * Points are read as flat array of 3 * n values, blocks of lanes points
+     * are reduced into per-position minima and maxima, so the loop runs on
+     * full vector registers without gathering components.
+     */
+    inline aabb<T> &set(const vector3<T> *p, std::size_t n)
+    {
+        static_assert(sizeof(vector3<T>) == 3 * sizeof(T),
+                      "vector3 must be packed");
+        const std::size_t block = 3 * lanes;
+        const T *a = reinterpret_cast<const T *>(p);
+        T lo[block], hi[block];
+        for (std::size_t j = 0; j < block; j++)
+        {
+            lo[j] = std::numeric_limits<T>::max();
+            hi[j] = std::numeric_limits<T>::lowest();
+        }
+        std::size_t m = n / lanes * block;
+        for (std::size_t b = 0; b < m; b += block)
+            for (std::size_t j = 0; j < block; j++)
+            {
+                lo[j] = a[b + j] < lo[j] ? a[b + j] : lo[j];
+                hi[j] = a[b + j] > hi[j] ? a[b + j] : hi[j];
+            }
+        for (std::size_t j = 0; m + j < 3 * n; j++)
+        {
+            lo[j] = a[m + j] < lo[j] ? a[m + j] : lo[j];
+            hi[j] = a[m + j] > hi[j] ? a[m + j] : hi[j];
+        }
+        set();
+        for (std::size_t j = 0; j < block; j++)
+        {
+            unsigned int c = j % 3;
+            if (lo[j] < min[c])
+                min[c] = lo[j];
+            if (hi[j] > max[c])
+                max[c] = hi[j];
+        }
+        return *this;
+    }
+
+    /**
+     * Set box of n points reduced in chunks of at most chunk points on all
+     * cores
+     */
+    inline aabb<T> &set_parallel(const vector3<T> *p, std::size_t n,
+                                 std::size_t chunk = 65536)
+    {
+        std::vector<aabb<T> > part((n + chunk - 1) / chunk);
+        parallel_for(n, chunk, [&](std::size_t begin, std::size_t end)
+        {
+            part[begin / chunk].set(p + begin, end - begin);
+        });
+        set();
+        for (std::size_t i = 0; i < part.size(); i++)
+            unite(part[i]);
+        return *this;
+    }
+
+    /**
+     * @return true for empty box
+     */
+    inline constexpr bool is_empty() const
+    {
+        return min.x > max.x || min.y > max.y || min.z > max.z;
+    }
+
+    /**
+     * @return box center
+     */
+    inline constexpr vector3<T> get_center() const
+    {
+        return (min + max) * T(0.5);
+    }
+
+    /**
+     * @return half of box size
+     */
+    inline constexpr vector3<T> get_extent() const
+    {
+        return (max - min) * T(0.5);
+    }
+
+    /**
+     * @return surface area
+     */
+    inline constexpr T get_area() const
+    {
+        vector3<T> d = max - min;
+        return is_empty() ? T(0) : T(2) * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    /**
+     * @return box containing box and point
+     */
+    inline constexpr aabb<T> get_union(const vector3<T> &rhs) const
+    {
+        return aabb<T>(vector3<T>(rhs.x < min.x ? rhs.x : min.x,
+                                  rhs.y < min.y ? rhs.y : min.y,
+                                  rhs.z < min.z ? rhs.z : min.z),
+                       vector3<T>(rhs.x > max.x ? rhs.x : max.x,
+                                  rhs.y > max.y ? rhs.y : max.y,
+                                  rhs.z > max.z ? rhs.z : max.z));
+    }
+
+    /**
+     * @return box containing both boxes
+     */
+    inline constexpr aabb<T> get_union(const aabb<T> &rhs) const
+    {
+        return aabb<T>(vector3<T>(rhs.min.x < min.x ? rhs.min.x : min.x,
+                                  rhs.min.y < min.y ? rhs.min.y : min.y,
+                                  rhs.min.z < min.z ? rhs.min.z : min.z),
+                       vector3<T>(rhs.max.x > max.x ? rhs.max.x : max.x,
+                                  rhs.max.y > max.y ? rhs.max.y : max.y,
+                                  rhs.max.z > max.z ? rhs.max.z : max.z));
+    }
+
+    /**
+     * Set box containing box and point
+     */
+    inline constexpr aabb<T> &unite(const vector3<T> &rhs)
+    {
+        *this = get_union(rhs);
+        return *this;
+    }
+
+    /**
+     * Set box containing both boxes
+     */
+    inline constexpr aabb<T> &unite(const aabb<T> &rhs)
+    {
+        *this = get_union(rhs);
+        return *this;
+    }
+
+    /**
+     * @return common part of boxes, empty when they do not overlap
+     */
+    inline constexpr aabb<T> get_intersection(const aabb<T> &rhs) const
+    {
+        return aabb<T>(vector3<T>(rhs.min.x > min.x ? rhs.min.x : min.x,
+                                  rhs.min.y > min.y ? rhs.min.y : min.y,
+                                  rhs.min.z > min.z ? rhs.min.z : min.z),
+                       vector3<T>(rhs.max.x < max.x ? rhs.max.x : max.x,
+                                  rhs.max.y < max.y ? rhs.max.y : max.y,
+                                  rhs.max.z < max.z ? rhs.max.z : max.z));
+    }
+
+    /**
+     * Set common part of boxes
+     */
+    inline constexpr aabb<T> &intersect(const aabb<T> &rhs)
+    {
+        *this = get_intersection(rhs);
+        return *this;
+    }
+
+    /**
+     * @return true if point is inside box
+     */
+    inline constexpr bool contains(const vector3<T> &rhs) const
+    {
+        return rhs.x >= min.x && rhs.x <= max.x &&
+               rhs.y >= min.y && rhs.y <= max.y &&
+               rhs.z >= min.z && rhs.z <= max.z;
+    }
+
+    /**
+     * @return true if box is inside box
+     */
+    inline constexpr bool contains(const aabb<T> &rhs) const
+    {
+        return contains(rhs.min) && contains(rhs.max);
+    }
+
+    /**
+     * @return true if boxes overlap
+     */
+    inline constexpr bool overlaps(const aabb<T> &rhs) const
+    {
+        return min.x <= rhs.max.x && max.x >= rhs.min.x &&
+               min.y <= rhs.max.y && max.y >= rhs.min.y &&
+               min.z <= rhs.max.z && max.z >= rhs.min.z;
+    }
+
+    /**
+     * @return box containing box transformed by matrix for row vectors
+     *
+     * Arvo's method in center-extent form: center is transformed as point,
+     * extent by absolute values of upper 3x3 part.
+     */
+    inline aabb<T> get_transform(const matrix4<T> &m) const
+    {
+        if (is_empty())
+            return *this;
+        vector3<T> c = get_center(), e = get_extent(), nc, ne;
+        for (unsigned int j = 0; j < 3; j++)
+        {
+            nc[j] = m(3, j);
+            ne[j] = T(0);
+            for (unsigned int i = 0; i < 3; i++)
+            {
+                T a = m(i, j);
+                nc[j] += c[i] * a;
+                ne[j] += e[i] * (a < T(0) ? -a : a);
+            }
+        }
+        return aabb<T>(nc - ne, nc + ne);
+    }
+
+    /**
+     * Set box containing box transformed by matrix for row vectors
+     */
+    inline aabb<T> &transform(const matrix4<T> &m)
+    {
+        *this = get_transform(m);
+        return *this;
+    }
+
+    /**
+     * Operator ==
+     */
+    inline constexpr bool operator ==(const aabb<T> &rhs) const
+    {
+        return min == rhs.min && max == rhs.max;
+    }
+
+    /**
+     * Operator !=
+     */
+    inline constexpr bool operator !=(const aabb<T> &rhs) const
+    {
+        return !operator ==(rhs);
+    }
+
+    friend inline std::ostream &operator <<(std::ostream &lhs,
+                                            const aabb<T> &rhs)
+    {
+        return lhs << "(" << rhs.min << ", " << rhs.max << ")";
+    }
+};
+
+template<class T>
+const std::size_t aabb<T>::lanes;
+
+/**
+ * Bounding sphere class
+ *
+ * Empty sphere has negative radius.
+ */
+template<class T>
+class bsphere
+{
+    typedef T type;
+
+public:
+    vector3<T> center;
+    T radius;
+
+    /**
+     * Number of points reduced by one kernel block
+     */
+    static const std::size_t lanes = 8;
+
+    /**
+     * Construct empty sphere
+     */
+    constexpr bsphere() :
+        center(T(0)), radius(T(-1))
+    {
+    }
+
+    /**
+     * Construct sphere (center, radius)
+     */
+    constexpr bsphere(const vector3<T> &center, T radius) :
+        center(center), radius(radius)
+    {
+    }
+
+    /**
+     * Construct sphere containing box
+     */
+    explicit bsphere(const aabb<T> &b)
+    {
+        set(b);
+    }
+
+    /**
+     * Construct sphere of n points
+     */
+    bsphere(const vector3<T> *p, std::size_t n)
+    {
+        set(p, n);
+    }
+
+    /**
+     * Set empty sphere
+     */
+    inline constexpr bsphere<T> &set()
+    {
+        *this = bsphere<T>();
+        return *this;
+    }
+
+    /**
+     * Set sphere (center, radius)
+     */
+    inline constexpr bsphere<T> &set(const vector3<T> &center, T radius)
+    {
+        this->center = center;
+        this->radius = radius;
+        return *this;
+    }
+
+    /**
+     * Set sphere containing box
+     */
+    inline bsphere<T> &set(const aabb<T> &b)
+    {
+        if (b.is_empty())
+            return set();
+        return set(b.get_center(), b.get_extent().norm());
+    }
+
+    /**
+     * Set sphere of n points centered in their bounding box, radius is
+     * maximum distance reduced across lanes in second pass
+     */
+    inline bsphere<T> &set(const vector3<T> *p, std::size_t n)
+    {
+        if (!n)
+            return set();
+        center = aabb<T>(p, n).get_center();
+        radius = std::sqrt(max_distance2(center, p, n));
+        return *this;
+    }
+
+    /**
+     * Set sphere of n points reduced in chunks of at most chunk points on
+     * all cores
+     */
+    inline bsphere<T> &set_parallel(const vector3<T> *p, std::size_t n,
+                                    std::size_t chunk = 65536)
+    {
+        if (!n)
+            return set();
+        center = aabb<T>().set_parallel(p, n, chunk).get_center();
+        std::vector<T> part((n + chunk - 1) / chunk);
+        parallel_for(n, chunk, [&](std::size_t begin, std::size_t end)
+        {
+            part[begin / chunk] = max_distance2(center, p + begin,
+                                                end - begin);
+        });
+        T r = T(0);
+        for (std::size_t i = 0; i < part.size(); i++)
+            r = part[i] > r ? part[i] : r;
+        radius = std::sqrt(r);
+        return *this;
+    }
+
+    /**
+     * @return true for empty sphere
+     */
+    inline constexpr bool is_empty() const
+    {
+        return radius < T(0);
+    }
+
+    /**
+     * @return true if point is inside sphere
+     */
+    inline constexpr bool contains(const vector3<T> &rhs) const
+    {
+        vector3<T> d = rhs - center;
+        return dot(d, d) <= radius * radius && !is_empty();
+    }
+
+    /**
+     * @return true if sphere is inside sphere
+     */
+    inline bool contains(const bsphere<T> &rhs) const
+    {
+        return !rhs.is_empty() && !is_empty() &&
+               (rhs.center - center).norm() + rhs.radius <= radius;
+    }
+
+    /**
+     * @return true if spheres overlap
+     */
+    inline constexpr bool overlaps(const bsphere<T> &rhs) const
+    {
+        vector3<T> d = rhs.center - center;
+        T r = radius + rhs.radius;
+        return !is_empty() && !rhs.is_empty() && dot(d, d) <= r * r;
+    }
+
+    /**
+     * @return true if sphere overlaps box
+     */
+    inline bool overlaps(const aabb<T> &rhs) const
+    {
+        T d = T(0);
+        for (unsigned int i = 0; i < 3; i++)
+        {
+            T c = center[i] < rhs.min[i] ? center[i] - rhs.min[i] :
+                  center[i] > rhs.max[i] ? center[i] - rhs.max[i] : T(0);
+            d += c * c;
+        }
+        return !is_empty() && !rhs.is_empty() && d <= radius * radius;
+    }
+
+    /**
+     * @return smallest sphere containing both spheres
+     */
+    inline bsphere<T> get_union(const bsphere<T> &rhs) const
+    {
+        if (rhs.is_empty() || contains(rhs))
+            return *this;
+        if (is_empty() || rhs.contains(*this))
+            return rhs;
+        vector3<T> d = rhs.center - center;
+        T l = d.norm();
+        T r = (l + radius + rhs.radius) * T(0.5);
+        return bsphere<T>(center + d * ((r - radius) / l), r);
+    }
+
+    /**
+     * Set smallest sphere containing both spheres
+     */
+    inline bsphere<T> &unite(const bsphere<T> &rhs)
+    {
+        *this = get_union(rhs);
+        return *this;
+    }
+
+    /**
+     * @return smallest sphere containing common part of spheres, empty when
+     * they do not overlap
+     */
+    inline bsphere<T> get_intersection(const bsphere<T> &rhs) const
+    {
+        if (!overlaps(rhs))
+            return bsphere<T>();
+        if (contains(rhs))
+            return rhs;
+        if (rhs.contains(*this))
+            return *this;
+        vector3<T> d = rhs.center - center;
+        T l = d.norm();
+        T h = (l * l + radius * radius - rhs.radius * rhs.radius) / (T(2) * l);
+        if (h < T(0))
+            return *this;
+        if (h > l)
+            return rhs;
+        return bsphere<T>(center + d * (h / l),
+                          std::sqrt(radius * radius - h * h));
+    }
+
+    /**
+     * Set smallest sphere containing common part of spheres
+     */
+    inline bsphere<T> &intersect(const bsphere<T> &rhs)
+    {
+        *this = get_intersection(rhs);
+        return *this;
+    }
+
+    /**
+     * @return sphere containing sphere transformed by matrix for row
+     * vectors, radius is scaled by upper bound of spectral norm of upper 3x3
+     * part, smaller of Frobenius norm and square root of product of maximum
+     * absolute row and column sums. Bound is exact for axis scale, rotations
+     * may enlarge sphere up to sqrt(3) times.
+     */
+    inline bsphere<T> get_transform(const matrix4<T> &m) const
+    {
+        if (is_empty())
+            return *this;
+        vector3<T> c;
+        T f = T(0), r = T(0), k = T(0);
+        for (unsigned int j = 0; j < 3; j++)
+        {
+            c[j] = m(3, j);
+            T rs = T(0), ks = T(0);
+            for (unsigned int i = 0; i < 3; i++)
+            {
+                c[j] += center[i] * m(i, j);
+                f += m(i, j) * m(i, j);
+                rs += std::abs(m(j, i));
+                ks += std::abs(m(i, j));
+            }
+            r = rs > r ? rs : r;
+            k = ks > k ? ks : k;
+        }
+        T s = r * k < f ? r * k : f;
+        return bsphere<T>(c, radius * std::sqrt(s));
+    }
+
+    /**
+     * Set sphere transformed by matrix for row vectors
+     */
+    inline bsphere<T> &transform(const matrix4<T> &m)
+    {
+        *this = get_transform(m);
+        return *this;
+    }
+
+    /**
+     * Operator ==
+     */
+    inline constexpr bool operator ==(const bsphere<T> &rhs) const
+    {
+        return center == rhs.center && radius == rhs.radius;
+    }
+
+    /**
+     * Operator !=
+     */
+    inline constexpr bool operator !=(const bsphere<T> &rhs) const
+    {
+        return !operator ==(rhs);
+    }
+
+    friend inline std::ostream &operator <<(std::ostream &lhs,
+                                            const bsphere<T> &rhs)
+    {
+        return lhs << "(" << rhs.center << ", " << rhs.radius << ")";
+    }
+
+private:
+    /**
+     * @return maximum squared distance of n points from c
+     */
+    static inline T max_distance2(const vector3<T> &c, const vector3<T> *p,
+                                  std::size_t n)
+    {
+        T r[lanes];
+        for (std::size_t l = 0; l < lanes; l++)
+            r[l] = T(0);
+        for (std::size_t b = 0; b < n; b += lanes)
+        {
+            std::size_t count = n - b < lanes ? n - b : lanes;
+            T dx[lanes], dy[lanes], dz[lanes];
+            for (std::size_t l = 0; l < lanes; l++)
+            {
+                const vector3<T> &q = p[b + (l < count ? l : 0)];
+                dx[l] = q.x - c.x;
+                dy[l] = q.y - c.y;
+                dz[l] = q.z - c.z;
+            }
+            for (std::size_t l = 0; l < lanes; l++)
+            {
+                T d = dx[l] * dx[l] + dy[l] * dy[l] + dz[l] * dz[l];
+                r[l] = d > r[l] ? d : r[l];
+            }
+        }
+        T m = T(0);
+        for (std::size_t l = 0; l < lanes; l++)
+            m = r[l] > m ? r[l] : m;
+        return m;
+    }
+};
+
+template<class T>
+const std::size_t bsphere<T>::lanes;
+
+typedef aabb<float> aabbf;
+typedef aabb<double> aabbd;
+typedef aabb<long double> aabbld;
+
+typedef bsphere<float> bspheref;
+typedef bsphere<double> bsphered;
+typedef bsphere<long double> bsphereld;
+
+static_assert(std::is_trivially_copyable<aabb<double> >::value,
+              "aabb must be trivially copyable");
+static_assert(std::is_trivially_copyable<bsphere<double> >::value,
+              "bsphere must be trivially copyable");
+}
+
+#endif
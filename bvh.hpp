@@ -0,0 +1,594 @@
+#ifndef _MATH_BVH_
+#define _MATH_BVH_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "aligned.hpp"
+#include "vector.hpp"
+#include "bounds.hpp"
+#include "ray.hpp"
+#include "parallel.hpp"
+
+namespace math
+{
+/**
+ * Four-wide node of bounding volume hierarchy, two cache lines for float
+ * and four for double
+ *
+ * Child bounds are stored as structure of arrays so one ray is tested
+ * against all four boxes at once. Child i is inner node child[i] when
+ * count[i] is zero, leaf of count[i] triangles in packets of eight starting
+ * at packet child[i] otherwise, and unused when child[i] is invalid.
+ */
+template<class T>
+struct alignas(64) bvh_node
+{
+    static const std::uint32_t invalid = ~std::uint32_t(0);
+
+    T min_x[4], min_y[4], min_z[4];
+    T max_x[4], max_y[4], max_z[4];
+    std::uint32_t child[4];
+    std::uint32_t count[4];
+};
+
+template<class T>
+const std::uint32_t bvh_node<T>::invalid;
+
+static_assert(sizeof(bvh_node<float>) == 128 && sizeof(bvh_node<double>) == 256,
+              "bvh nodes must take whole cache lines");
+
+/**
+ * Bounding volume hierarchy over triangles
+ *
+ * Built top-down with binned surface area heuristic, every node takes up to
+ * four children by splitting its largest child again. Subtrees near the
+ * root are built in parallel, nodes are stored in depth-first order in one
+ * cache-line aligned array and triangles are copied in leaf order into
+ * packets of eight, so one ray is tested against whole leaf at once.
+ */
+template<class T>
+class bvh
+{
+    typedef T type;
+    typedef bvh_node<T> node;
+    typedef std::vector<node, aligned_allocator<node> > node_array;
+    typedef triangle_packet<T> packet;
+    typedef std::vector<packet, aligned_allocator<packet> > packet_array;
+
+public:
+    /**
+     * Maximum number of triangles in leaf
+     */
+    static const std::size_t leaf_size = 8;
+
+    /**
+     * Number of bins of surface area heuristic
+     */
+    static const std::size_t bins = 16;
+
+    /**
+     * Construct empty hierarchy
+     */
+    bvh()
+    {
+    }
+
+    /**
+     * Construct hierarchy of n triangles, triangle i is (v[3 i], v[3 i + 1],
+     * v[3 i + 2])
+     */
+    bvh(const vector3<T> *v, std::size_t n)
+    {
+        build(v, n);
+    }
+
+    /**
+     * Build hierarchy of n triangles, triangle i is (v[3 i], v[3 i + 1],
+     * v[3 i + 2])
+     */
+    inline bvh<T> &build(const vector3<T> *v, std::size_t n)
+    {
+        nodes.clear();
+        packets.clear();
+        ids.clear();
+        bounds.set();
+        if (!n)
+            return *this;
+        std::vector<aabb<T> > box(n);
+        std::vector<vector3<T> > center(n);
+        std::vector<std::uint32_t> order(n);
+        parallel_for(n, 65536, [&](std::size_t begin, std::size_t end)
+        {
+            for (std::size_t i = begin; i < end; i++)
+            {
+                box[i] = triangle_bounds(v + 3 * i);
+                center[i] = box[i].get_center();
+                order[i] = std::uint32_t(i);
+            }
+        });
+        builder b = {box.data(), center.data(), order.data(), 0};
+        for (std::size_t t = std::thread::hardware_concurrency(); t > 1; t /= 4)
+            b.parallel_depth++;
+        range r = {0, std::uint32_t(n), aabb<T>()};
+        for (std::size_t i = 0; i < n; i++)
+            r.bounds.unite(box[i]);
+        bounds = r.bounds;
+        b.build(r, 0, nodes);
+        for (std::size_t k = 0; k < nodes.size(); k++)
+            for (unsigned int i = 0; i < 4; i++)
+            {
+                node &m = nodes[k];
+                if (!m.count[i])
+                    continue;
+                std::uint32_t begin = m.child[i];
+                m.child[i] = std::uint32_t(packets.size());
+                for (std::uint32_t j = 0; j < m.count[i]; j += lanes)
+                {
+                    packet p;
+                    for (std::uint32_t l = 0; l < lanes; l++)
+                    {
+                        std::uint32_t id = j + l < m.count[i] ?
+                                           order[begin + j + l] :
+                                           node::invalid;
+                        if (id == node::invalid)
+                            p.set(l, vector3<T>(T(0)), vector3<T>(T(0)),
+                                  vector3<T>(T(0)));
+                        else
+                            p.set(l, v[3 * id], v[3 * id + 1], v[3 * id + 2]);
+                        ids.push_back(id);
+                    }
+                    packets.push_back(p);
+                }
+            }
+        return *this;
+    }
+
+    /**
+     * @return bounds of all triangles
+     */
+    inline const aabb<T> &get_bounds() const
+    {
+        return bounds;
+    }
+
+    /**
+     * @return number of nodes
+     */
+    inline std::size_t get_size() const
+    {
+        return nodes.size();
+    }
+
+    /**
+     * @return node array
+     */
+    inline const node *get_nodes() const
+    {
+        return nodes.data();
+    }
+
+    /**
+     * Closest hit
+     * @param t on input maximum distance, on output distance of hit
+     * @param u, v barycentric coordinates of hit, see ray::intersect()
+     * @param id index of hit triangle
+     * @return true if ray hits triangle closer than t
+     */
+    inline bool intersect(const ray<T> &r, T &t, T &u, T &v,
+                          std::uint32_t &id) const
+    {
+        if (nodes.empty())
+            return false;
+        traversal q(r);
+        bool hit = false;
+        std::uint32_t stack[stack_size];
+        std::size_t top = 0;
+        stack[top++] = 0;
+        while (top)
+        {
+            const node &m = nodes[stack[--top]];
+            T dist[4];
+            unsigned int mask = q.test(m, t, dist);
+            unsigned int order[4], k = 0;
+            for (unsigned int i = 0; i < 4; i++)
+                if (mask & (1 << i))
+                {
+                    unsigned int j = k++;
+                    for (; j > 0 && dist[order[j - 1]] < dist[i]; j--)
+                        order[j] = order[j - 1];
+                    order[j] = i;
+                }
+            // leaves nearest first so t shrinks early, then inner nodes
+            // pushed farthest first so nearest is popped next
+            for (unsigned int j = k; j-- > 0; )
+            {
+                unsigned int i = order[j];
+                if (!m.count[i] || dist[i] > t)
+                    continue;
+                for (std::uint32_t p = m.child[i]; p < end(m, i); p++)
+                {
+                    T pt[lanes], pu[lanes], pv[lanes];
+                    unsigned int bits = ray_kernel<T>::intersect(
+                        r, packets[p], t, pt, pu, pv);
+                    for (std::uint32_t l = 0; bits >> l; l++)
+                        if ((bits >> l) & 1 && pt[l] < t)
+                        {
+                            t = pt[l];
+                            u = pu[l];
+                            v = pv[l];
+                            id = ids[lanes * p + l];
+                            hit = true;
+                        }
+                }
+            }
+            for (unsigned int j = 0; j < k; j++)
+            {
+                unsigned int i = order[j];
+                if (!m.count[i] && dist[i] <= t)
+                    stack[top++] = m.child[i];
+            }
+        }
+        return hit;
+    }
+
+    /**
+     * Any hit
+     * @return true if ray hits any triangle closer than t
+     */
+    inline bool occluded(const ray<T> &r, T t) const
+    {
+        if (nodes.empty())
+            return false;
+        traversal q(r);
+        std::uint32_t stack[stack_size];
+        std::size_t top = 0;
+        stack[top++] = 0;
+        while (top)
+        {
+            const node &m = nodes[stack[--top]];
+            T dist[4];
+            unsigned int mask = q.test(m, t, dist);
+            for (unsigned int i = 0; i < 4; i++)
+            {
+                if (!(mask & (1 << i)))
+                    continue;
+                if (!m.count[i])
+                {
+                    stack[top++] = m.child[i];
+                    continue;
+                }
+                for (std::uint32_t p = m.child[i]; p < end(m, i); p++)
+                {
+                    T pt[lanes], pu[lanes], pv[lanes];
+                    if (ray_kernel<T>::intersect(r, packets[p], t, pt, pu, pv))
+                        return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Append indices of triangles whose bounds overlap box to out
+     * @return number of appended indices
+     */
+    inline std::size_t overlap(const aabb<T> &box,
+                               std::vector<std::uint32_t> &out) const
+    {
+        std::size_t size = out.size();
+        if (nodes.empty())
+            return 0;
+        std::uint32_t stack[stack_size];
+        std::size_t top = 0;
+        stack[top++] = 0;
+        while (top)
+        {
+            const node &m = nodes[stack[--top]];
+            for (unsigned int i = 0; i < 4; i++)
+            {
+                if (m.child[i] == node::invalid ||
+                    !aabb<T>(vector3<T>(m.min_x[i], m.min_y[i], m.min_z[i]),
+                             vector3<T>(m.max_x[i], m.max_y[i], m.max_z[i]))
+                         .overlaps(box))
+                    continue;
+                if (!m.count[i])
+                {
+                    stack[top++] = m.child[i];
+                    continue;
+                }
+                for (std::uint32_t p = m.child[i]; p < end(m, i); p++)
+                    for (std::uint32_t l = 0; l < lanes; l++)
+                    {
+                        vector3<T> tri[3];
+                        packets[p].get(l, tri[0], tri[1], tri[2]);
+                        if (ids[lanes * p + l] != node::invalid &&
+                            triangle_bounds(tri).overlaps(box))
+                            out.push_back(ids[lanes * p + l]);
+                    }
+            }
+        }
+        return out.size() - size;
+    }
+
+private:
+    /**
+     * Maximum depth, deeper ranges become leaves, and traversal stack size
+     */
+    static const int max_depth = 64;
+    static const std::size_t stack_size = 3 * max_depth + 4;
+
+    /**
+     * Triangles per packet
+     */
+    static const std::uint32_t lanes = std::uint32_t(packet::lanes);
+
+    node_array nodes;
+    packet_array packets;
+    std::vector<std::uint32_t> ids;
+    aabb<T> bounds;
+
+    /**
+     * @return index past last packet of leaf i of m
+     */
+    static inline std::uint32_t end(const node &m, unsigned int i)
+    {
+        return m.child[i] + (m.count[i] + lanes - 1) / lanes;
+    }
+
+    static inline aabb<T> triangle_bounds(const vector3<T> *v)
+    {
+        return aabb<T>(v[0], v[0]).unite(v[1]).unite(v[2]);
+    }
+
+    /**
+     * Range of triangles in build order with their bounds
+     */
+    struct range
+    {
+        std::uint32_t begin, end;
+        aabb<T> bounds;
+    };
+
+    struct builder
+    {
+        const aabb<T> *box;
+        const vector3<T> *center;
+        std::uint32_t *order;
+        int parallel_depth;
+
+        /**
+         * Split range by binned surface area heuristic, range that fits one
+         * packet is always leaf since whole packet is tested at once
+         * @return false if range should be leaf
+         */
+        inline bool split(const range &r, range &left, range &right) const
+        {
+            std::size_t n = r.end - r.begin;
+            if (n <= leaf_size)
+                return false;
+            aabb<T> cb;
+            for (std::uint32_t i = r.begin; i < r.end; i++)
+                cb.unite(center[order[i]]);
+            vector3<T> e = cb.max - cb.min;
+            unsigned int axis = e.x > e.y ? (e.x > e.z ? 0 : 2) :
+                                            (e.y > e.z ? 1 : 2);
+            if (!(e[axis] > T(0)))
+            {
+                std::uint32_t mid = r.begin + std::uint32_t(n / 2);
+                left.begin = r.begin;
+                left.end = right.begin = mid;
+                right.end = r.end;
+                left.bounds = bound(left);
+                right.bounds = bound(right);
+                return true;
+            }
+            T scale = T(bins) / e[axis];
+            T o = cb.min[axis];
+            std::size_t count[bins] = {};
+            aabb<T> bin[bins];
+            for (std::uint32_t i = r.begin; i < r.end; i++)
+            {
+                std::size_t k = index(center[order[i]][axis], o, scale);
+                count[k]++;
+                bin[k].unite(box[order[i]]);
+            }
+            T area[bins];
+            aabb<T> acc;
+            std::size_t right_count = 0;
+            for (std::size_t k = bins - 1; k > 0; k--)
+            {
+                acc.unite(bin[k]);
+                right_count += count[k];
+                area[k] = acc.get_area() * T(right_count);
+            }
+            acc.set();
+            std::size_t left_count = 0, best = 0;
+            T cost = T(0);
+            for (std::size_t k = 1; k < bins; k++)
+            {
+                acc.unite(bin[k - 1]);
+                left_count += count[k - 1];
+                T c = acc.get_area() * T(left_count) + area[k];
+                if (!best || c < cost)
+                {
+                    best = k;
+                    cost = c;
+                }
+            }
+            std::uint32_t *mid = std::partition(order + r.begin,
+                                                order + r.end,
+                [&](std::uint32_t i)
+                {
+                    return index(center[i][axis], o, scale) < best;
+                });
+            left.begin = r.begin;
+            left.end = right.begin = std::uint32_t(mid - order);
+            right.end = r.end;
+            left.bounds = bound(left);
+            right.bounds = bound(right);
+            return true;
+        }
+
+        static inline std::size_t index(T c, T o, T scale)
+        {
+            T k = (c - o) * scale;
+            return k < T(0) ? 0 : k >= T(bins) ? bins - 1 : std::size_t(k);
+        }
+
+        inline aabb<T> bound(const range &r) const
+        {
+            aabb<T> b;
+            for (std::uint32_t i = r.begin; i < r.end; i++)
+                b.unite(box[order[i]]);
+            return b;
+        }
+
+        /**
+         * Build node of range into nodes
+         * @return node index
+         */
+        inline std::uint32_t build(const range &r, int depth,
+                                   node_array &nodes) const
+        {
+            range slot[4];
+            bool leaf[4] = {true, true, true, true};
+            unsigned int slots = 1;
+            slot[0] = r;
+            leaf[0] = depth >= max_depth;
+            while (slots < 4)
+            {
+                unsigned int s = 4;
+                for (unsigned int i = 0; i < slots; i++)
+                    if (!leaf[i] && (s == 4 || slot[i].bounds.get_area() >
+                                               slot[s].bounds.get_area()))
+                        s = i;
+                if (s == 4)
+                    break;
+                range left, right;
+                if (!split(slot[s], left, right))
+                {
+                    leaf[s] = true;
+                    continue;
+                }
+                slot[s] = left;
+                slot[slots] = right;
+                leaf[slots++] = false;
+            }
+            for (unsigned int i = 0; i < slots; i++)
+                leaf[i] = leaf[i] || slot[i].end - slot[i].begin <= leaf_size;
+            std::uint32_t index = std::uint32_t(nodes.size());
+            nodes.push_back(node());
+            for (unsigned int i = 0; i < 4; i++)
+            {
+                node &m = nodes[index];
+                aabb<T> b = i < slots ? slot[i].bounds : aabb<T>();
+                m.min_x[i] = b.min.x;
+                m.min_y[i] = b.min.y;
+                m.min_z[i] = b.min.z;
+                m.max_x[i] = b.max.x;
+                m.max_y[i] = b.max.y;
+                m.max_z[i] = b.max.z;
+                m.child[i] = i < slots ? slot[i].begin : node::invalid;
+                m.count[i] = i < slots && leaf[i] ?
+                             slot[i].end - slot[i].begin : 0;
+            }
+            std::size_t inner = 0;
+            for (unsigned int i = 0; i < slots; i++)
+                inner += !leaf[i];
+            if (depth < parallel_depth && inner > 1)
+            {
+                node_array sub[4];
+                parallel_for(slots, 1, [&](std::size_t begin, std::size_t end)
+                {
+                    for (std::size_t i = begin; i < end; i++)
+                        if (!leaf[i])
+                            build(slot[i], depth + 1, sub[i]);
+                });
+                for (unsigned int i = 0; i < slots; i++)
+                    if (!leaf[i])
+                    {
+                        std::uint32_t offset = std::uint32_t(nodes.size());
+                        for (std::size_t k = 0; k < sub[i].size(); k++)
+                            for (unsigned int j = 0; j < 4; j++)
+                                if (!sub[i][k].count[j] &&
+                                    sub[i][k].child[j] != node::invalid)
+                                    sub[i][k].child[j] += offset;
+                        nodes.insert(nodes.end(), sub[i].begin(),
+                                     sub[i].end());
+                        nodes[index].child[i] = offset;
+                    }
+            }
+            else
+                for (unsigned int i = 0; i < slots; i++)
+                    if (!leaf[i])
+                    {
+                        std::uint32_t c = build(slot[i], depth + 1, nodes);
+                        nodes[index].child[i] = c;
+                    }
+            return index;
+        }
+    };
+
+    /**
+     * Precomputed ray for slab tests, near and far planes of every axis are
+     * picked by sign of inverse direction once per ray, so -0 picks planes
+     * of -inf slope
+     */
+    struct traversal
+    {
+        T ox, oy, oz, ix, iy, iz;
+        bool sx, sy, sz;
+
+        explicit traversal(const ray<T> &r) :
+            ox(r.origin.x), oy(r.origin.y), oz(r.origin.z),
+            ix(T(1) / r.direction.x), iy(T(1) / r.direction.y),
+            iz(T(1) / r.direction.z),
+            sx(ix < T(0)), sy(iy < T(0)), sz(iz < T(0))
+        {
+        }
+
+        /**
+         * @return bit mask of children hit closer than t, entry distances
+         * into dist
+         */
+        inline unsigned int test(const node &m, T t, T *dist) const
+        {
+            const T *nx = sx ? m.max_x : m.min_x, *fx = sx ? m.min_x : m.max_x;
+            const T *ny = sy ? m.max_y : m.min_y, *fy = sy ? m.min_y : m.max_y;
+            const T *nz = sz ? m.max_z : m.min_z, *fz = sz ? m.min_z : m.max_z;
+            unsigned int mask = 0;
+            for (unsigned int i = 0; i < 4; i++)
+            {
+                T t0 = (nx[i] - ox) * ix, t1 = (fx[i] - ox) * ix;
+                T t2 = (ny[i] - oy) * iy, t3 = (fy[i] - oy) * iy;
+                T t4 = (nz[i] - oz) * iz, t5 = (fz[i] - oz) * iz;
+                T n = t0 > t2 ? t0 : t2;
+                n = t4 > n ? t4 : n;
+                n = n > T(0) ? n : T(0);
+                T f = t1 < t3 ? t1 : t3;
+                f = t5 < f ? t5 : f;
+                f = f < t ? f : t;
+                dist[i] = n;
+                mask |= unsigned(n <= f) << i;
+            }
+            return mask;
+        }
+    };
+};
+
+template<class T>
+const std::size_t bvh<T>::leaf_size;
+
+template<class T>
+const std::size_t bvh<T>::bins;
+
+typedef bvh<float> bvhf;
+typedef bvh<double> bvhd;
+typedef bvh<long double> bvhld;
+}
+
+#endif
@@ -0,0 +1,452 @@
+#ifndef _MATH_DISPATCH_
+#define _MATH_DISPATCH_
+
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+#include "simd.hpp"
+#include "vector.hpp"
+#include "matrix.hpp"
+
+/**
+ * Runtime dispatch of batch kernels on x86. Kernels of every level are
+ * compiled into one binary with per-function target attributes, so they
+ * need no -m flags. Define MATH_NO_SIMD to keep scalar kernels only.
+ */
+#if !defined(MATH_NO_SIMD) && (defined(__x86_64__) || defined(__i386__) || \
+                               defined(_M_X64) || defined(_M_IX86))
+#define MATH_DISPATCH_X86 1
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define MATH_TARGET(isa)
+#else
+#include <cpuid.h>
+#define MATH_TARGET(isa) __attribute__((target(isa)))
+#endif
+#include <immintrin.h>
+#endif
+
+namespace math
+{
+/**
+ * Instruction set levels of batch kernels, every level includes previous
+ * ones, avx2 also requires FMA and avx512 AVX-512F
+ */
+enum isa
+{
+    isa_scalar, isa_sse2, isa_avx2, isa_avx512
+};
+
+/**
+ * @return name of level, also accepted by MATH_ISA environment variable
+ */
+inline const char *get_isa_name(isa level)
+{
+    static const char *const names[] = {"scalar", "sse2", "avx2", "avx512"};
+    return names[level];
+}
+
+/**
+ * @return highest level supported by cpu and operating system
+ */
+inline isa get_cpu_isa()
+{
+#ifdef MATH_DISPATCH_X86
+    auto cpuid = [](unsigned int leaf, unsigned int *r)
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        int v[4];
+        __cpuidex(v, int(leaf), 0);
+        for (unsigned int i = 0; i < 4; i++)
+            r[i] = unsigned(v[i]);
+#else
+        __cpuid_count(leaf, 0, r[0], r[1], r[2], r[3]);
+#endif
+    };
+    auto xgetbv = []()
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        return (unsigned long long)(_xgetbv(0));
+#else
+        unsigned int lo, hi;
+        __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+        return (unsigned long long)(hi) << 32 | lo;
+#endif
+    };
+    unsigned int r[4];
+    cpuid(0, r);
+    unsigned int leaves = r[0];
+    if (leaves < 1)
+        return isa_scalar;
+    cpuid(1, r);
+    if (!(r[3] & (1u << 26)))
+        return isa_scalar;
+    bool fma = r[2] & (1u << 12), osxsave = r[2] & (1u << 27);
+    bool avx = r[2] & (1u << 28);
+    if (leaves < 7 || !fma || !osxsave || !avx)
+        return isa_sse2;
+    unsigned long long xcr0 = xgetbv();
+    cpuid(7, r);
+    if ((xcr0 & 0x6) != 0x6 || !(r[1] & (1u << 5)))
+        return isa_sse2;
+    if ((xcr0 & 0xe6) != 0xe6 || !(r[1] & (1u << 16)))
+        return isa_avx2;
+    return isa_avx512;
+#else
+    return isa_scalar;
+#endif
+}
+
+/**
+ * @return level named name, see get_isa_name(), clamped to get_cpu_isa(),
+ * or get_cpu_isa() if name is null or unknown
+ */
+inline isa select_isa(const char *name)
+{
+    isa cpu = get_cpu_isa();
+    for (int l = isa_scalar; name && l <= isa_avx512; l++)
+        if (!std::strcmp(name, get_isa_name(isa(l))))
+            return l < cpu ? isa(l) : cpu;
+    return cpu;
+}
+
+/**
+ * @return level of get_batch_kernels(), selected on first call from
+ * MATH_ISA environment variable, e.g. MATH_ISA=sse2, or get_cpu_isa()
+ */
+inline isa get_isa()
+{
+    static const isa level = select_isa(std::getenv("MATH_ISA"));
+    return level;
+}
+
+/**
+ * Batch kernels of one instruction set level, called through function
+ * pointers set by constructor
+ *
+ * Every level gives the same results up to rounding, except for
+ * normalize_fast() whose reciprocal square root refined by one Newton step
+ * has relative error below 5e-7 on every level. sse2 level runs the SSE code
+ * of matrix4<float> and rsqrt_kernel<float>, avx2 and avx512 levels
+ * deinterleave 8 and 16 vectors into x, y and z registers and finish
+ * remainders on lower level. Arrays need no alignment, in and out may be
+ * equal.
+ */
+class batch_kernels
+{
+public:
+    /**
+     * Construct kernels of level, clamped to get_cpu_isa()
+     */
+    explicit batch_kernels(isa level = get_isa())
+    {
+        isa cpu = get_cpu_isa();
+        this->level = level < cpu ? level : cpu;
+        transform = &transform_scalar;
+        normalize = &normalize_scalar;
+#ifdef MATH_DISPATCH_X86
+        if (this->level >= isa_sse2)
+        {
+            transform = &transform_sse2;
+            normalize = &normalize_sse2;
+        }
+        if (this->level >= isa_avx2)
+        {
+            transform = &transform_avx2;
+            normalize = &normalize_avx2;
+        }
+        if (this->level >= isa_avx512)
+        {
+            transform = &transform_avx512;
+            normalize = &normalize_avx512;
+        }
+#endif
+    }
+
+    inline isa get_level() const
+    {
+        return level;
+    }
+
+    /**
+     * Transform n points (x, y, z, 1) dropping w
+     */
+    inline void transform_points(const matrix4<float> &m,
+                                 const vector3<float> *in,
+                                 vector3<float> *out, std::size_t n) const
+    {
+        transform(m, reinterpret_cast<const float *>(in),
+                  reinterpret_cast<float *>(out), n, true);
+    }
+
+    /**
+     * Transform n directions (x, y, z, 0)
+     */
+    inline void transform_directions(const matrix4<float> &m,
+                                     const vector3<float> *in,
+                                     vector3<float> *out, std::size_t n) const
+    {
+        transform(m, reinterpret_cast<const float *>(in),
+                  reinterpret_cast<float *>(out), n, false);
+    }
+
+    /**
+     * Normalize n vectors, zero and infinite vectors give NaN
+     */
+    inline void normalize_fast(const vector3<float> *in, vector3<float> *out,
+                               std::size_t n) const
+    {
+        normalize(reinterpret_cast<const float *>(in),
+                  reinterpret_cast<float *>(out), n);
+    }
+
+private:
+    isa level;
+    void (*transform)(const matrix4<float> &, const float *, float *,
+                      std::size_t, bool);
+    void (*normalize)(const float *, float *, std::size_t);
+
+    static void transform_scalar(const matrix4<float> &m, const float *in,
+                                 float *out, std::size_t n, bool points)
+    {
+        float w = points ? 1.0f : 0.0f;
+        const float m00 = m(0, 0), m01 = m(0, 1), m02 = m(0, 2);
+        const float m10 = m(1, 0), m11 = m(1, 1), m12 = m(1, 2);
+        const float m20 = m(2, 0), m21 = m(2, 1), m22 = m(2, 2);
+        const float m30 = m(3, 0) * w, m31 = m(3, 1) * w, m32 = m(3, 2) * w;
+        for (std::size_t i = 0; i < n; i++)
+        {
+            const float *p = in + 3 * i;
+            float *q = out + 3 * i;
+            float x = p[0], y = p[1], z = p[2];
+            q[0] = x * m00 + y * m10 + z * m20 + m30;
+            q[1] = x * m01 + y * m11 + z * m21 + m31;
+            q[2] = x * m02 + y * m12 + z * m22 + m32;
+        }
+    }
+
+    static void normalize_scalar(const float *in, float *out, std::size_t n)
+    {
+        for (std::size_t i = 0; i < n; i++)
+        {
+            const float *p = in + 3 * i;
+            float *q = out + 3 * i;
+            float x = p[0], y = p[1], z = p[2];
+            float r = 1.0f / std::sqrt(x * x + y * y + z * z);
+            q[0] = x * r;
+            q[1] = y * r;
+            q[2] = z * r;
+        }
+    }
+
+#ifdef MATH_DISPATCH_X86
+    static void transform_sse2(const matrix4<float> &m, const float *in,
+                               float *out, std::size_t n, bool points)
+    {
+        std::size_t stride = 3 * sizeof(float);
+        if (points)
+            m.transform_points(in, stride, out, stride, n);
+        else
+            m.transform_directions(in, stride, out, stride, n);
+    }
+
+    static void normalize_sse2(const float *in, float *out, std::size_t n)
+    {
+        rsqrt_kernel<float>::template normalize<3>(in, out, n);
+    }
+
+    /**
+     * Load 8 vectors (x, y, z) as x, y and z registers, lanes of element k
+     * of each register are blended from 3 * k + c mod 8 of 3 loads and
+     * permuted back in order
+     */
+    MATH_TARGET("avx2,fma")
+    static inline void load3(const float *p, __m256 &x, __m256 &y, __m256 &z)
+    {
+        __m256 a = _mm256_loadu_ps(p), b = _mm256_loadu_ps(p + 8);
+        __m256 c = _mm256_loadu_ps(p + 16);
+        x = _mm256_permutevar8x32_ps(
+            _mm256_blend_ps(_mm256_blend_ps(a, b, 0x92), c, 0x24),
+            _mm256_setr_epi32(0, 3, 6, 1, 4, 7, 2, 5));
+        y = _mm256_permutevar8x32_ps(
+            _mm256_blend_ps(_mm256_blend_ps(a, b, 0x24), c, 0x49),
+            _mm256_setr_epi32(1, 4, 7, 2, 5, 0, 3, 6));
+        z = _mm256_permutevar8x32_ps(
+            _mm256_blend_ps(_mm256_blend_ps(a, b, 0x49), c, 0x92),
+            _mm256_setr_epi32(2, 5, 0, 3, 6, 1, 4, 7));
+    }
+
+    /**
+     * Store x, y and z registers as 8 vectors (x, y, z), inverse of load3()
+     */
+    MATH_TARGET("avx2,fma")
+    static inline void store3(float *p, __m256 x, __m256 y, __m256 z)
+    {
+        x = _mm256_permutevar8x32_ps(x, _mm256_setr_epi32(0, 3, 6, 1, 4, 7, 2, 5));
+        y = _mm256_permutevar8x32_ps(y, _mm256_setr_epi32(5, 0, 3, 6, 1, 4, 7, 2));
+        z = _mm256_permutevar8x32_ps(z, _mm256_setr_epi32(2, 5, 0, 3, 6, 1, 4, 7));
+        _mm256_storeu_ps(p, _mm256_blend_ps(_mm256_blend_ps(x, y, 0x92), z, 0x24));
+        _mm256_storeu_ps(p + 8, _mm256_blend_ps(_mm256_blend_ps(x, y, 0x24), z, 0x49));
+        _mm256_storeu_ps(p + 16, _mm256_blend_ps(_mm256_blend_ps(x, y, 0x49), z, 0x92));
+    }
+
+    MATH_TARGET("avx2,fma")
+    static void transform_avx2(const matrix4<float> &m, const float *in,
+                               float *out, std::size_t n, bool points)
+    {
+        __m256 m00 = _mm256_set1_ps(m(0, 0)), m01 = _mm256_set1_ps(m(0, 1));
+        __m256 m02 = _mm256_set1_ps(m(0, 2)), m10 = _mm256_set1_ps(m(1, 0));
+        __m256 m11 = _mm256_set1_ps(m(1, 1)), m12 = _mm256_set1_ps(m(1, 2));
+        __m256 m20 = _mm256_set1_ps(m(2, 0)), m21 = _mm256_set1_ps(m(2, 1));
+        __m256 m22 = _mm256_set1_ps(m(2, 2));
+        float w = points ? 1.0f : 0.0f;
+        __m256 m30 = _mm256_set1_ps(m(3, 0) * w);
+        __m256 m31 = _mm256_set1_ps(m(3, 1) * w);
+        __m256 m32 = _mm256_set1_ps(m(3, 2) * w);
+        std::size_t i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256 x, y, z;
+            load3(in + 3 * i, x, y, z);
+            __m256 rx = _mm256_fmadd_ps(z, m20, _mm256_fmadd_ps(y, m10,
+                            _mm256_fmadd_ps(x, m00, m30)));
+            __m256 ry = _mm256_fmadd_ps(z, m21, _mm256_fmadd_ps(y, m11,
+                            _mm256_fmadd_ps(x, m01, m31)));
+            __m256 rz = _mm256_fmadd_ps(z, m22, _mm256_fmadd_ps(y, m12,
+                            _mm256_fmadd_ps(x, m02, m32)));
+            store3(out + 3 * i, rx, ry, rz);
+        }
+        transform_sse2(m, in + 3 * i, out + 3 * i, n - i, points);
+    }
+
+    MATH_TARGET("avx2,fma")
+    static void normalize_avx2(const float *in, float *out, std::size_t n)
+    {
+        std::size_t i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256 x, y, z;
+            load3(in + 3 * i, x, y, z);
+            __m256 d = _mm256_fmadd_ps(x, x, _mm256_fmadd_ps(y, y,
+                           _mm256_mul_ps(z, z)));
+            __m256 r = _mm256_rsqrt_ps(d);
+            __m256 h = _mm256_mul_ps(_mm256_mul_ps(d, _mm256_set1_ps(0.5f)), r);
+            r = _mm256_mul_ps(r, _mm256_fnmadd_ps(h, r, _mm256_set1_ps(1.5f)));
+            store3(out + 3 * i, _mm256_mul_ps(x, r), _mm256_mul_ps(y, r),
+                   _mm256_mul_ps(z, r));
+        }
+        normalize_sse2(in + 3 * i, out + 3 * i, n - i);
+    }
+
+    /**
+     * Load 16 vectors (x, y, z) as x, y and z registers, same as
+     * load3() of 8 vectors with lanes 3 * k + c mod 16. AVX-512 kernels use
+     * full masks instead of unmasked intrinsics, which warn of uninitialized
+     * values on GCC 12.
+     */
+    MATH_TARGET("avx512f,avx2,fma")
+    static inline void load3(const float *p, __m512 &x, __m512 &y, __m512 &z)
+    {
+        __m512 a = _mm512_loadu_ps(p), b = _mm512_loadu_ps(p + 16);
+        __m512 c = _mm512_loadu_ps(p + 32);
+        x = _mm512_mask_permutexvar_ps(a, 0xffff,
+            _mm512_setr_epi32(0, 3, 6, 9, 12, 15, 2, 5,
+                              8, 11, 14, 1, 4, 7, 10, 13),
+            _mm512_mask_blend_ps(0x2492, _mm512_mask_blend_ps(0x4924, a, b), c));
+        y = _mm512_mask_permutexvar_ps(a, 0xffff,
+            _mm512_setr_epi32(1, 4, 7, 10, 13, 0, 3, 6,
+                              9, 12, 15, 2, 5, 8, 11, 14),
+            _mm512_mask_blend_ps(0x4924, _mm512_mask_blend_ps(0x9249, a, b), c));
+        z = _mm512_mask_permutexvar_ps(a, 0xffff,
+            _mm512_setr_epi32(2, 5, 8, 11, 14, 1, 4, 7,
+                              10, 13, 0, 3, 6, 9, 12, 15),
+            _mm512_mask_blend_ps(0x9249, _mm512_mask_blend_ps(0x2492, a, b), c));
+    }
+
+    /**
+     * Store x, y and z registers as 16 vectors (x, y, z), inverse of
+     * load3()
+     */
+    MATH_TARGET("avx512f,avx2,fma")
+    static inline void store3(float *p, __m512 x, __m512 y, __m512 z)
+    {
+        x = _mm512_mask_permutexvar_ps(x, 0xffff,
+            _mm512_setr_epi32(0, 11, 6, 1, 12, 7, 2, 13,
+                              8, 3, 14, 9, 4, 15, 10, 5), x);
+        y = _mm512_mask_permutexvar_ps(y, 0xffff,
+            _mm512_setr_epi32(5, 0, 11, 6, 1, 12, 7, 2,
+                              13, 8, 3, 14, 9, 4, 15, 10), y);
+        z = _mm512_mask_permutexvar_ps(z, 0xffff,
+            _mm512_setr_epi32(10, 5, 0, 11, 6, 1, 12, 7,
+                              2, 13, 8, 3, 14, 9, 4, 15), z);
+        _mm512_storeu_ps(p, _mm512_mask_blend_ps(0x4924,
+            _mm512_mask_blend_ps(0x2492, x, y), z));
+        _mm512_storeu_ps(p + 16, _mm512_mask_blend_ps(0x2492,
+            _mm512_mask_blend_ps(0x9249, x, y), z));
+        _mm512_storeu_ps(p + 32, _mm512_mask_blend_ps(0x9249,
+            _mm512_mask_blend_ps(0x4924, x, y), z));
+    }
+
+    MATH_TARGET("avx512f,avx2,fma")
+    static void transform_avx512(const matrix4<float> &m, const float *in,
+                                 float *out, std::size_t n, bool points)
+    {
+        __m512 m00 = _mm512_set1_ps(m(0, 0)), m01 = _mm512_set1_ps(m(0, 1));
+        __m512 m02 = _mm512_set1_ps(m(0, 2)), m10 = _mm512_set1_ps(m(1, 0));
+        __m512 m11 = _mm512_set1_ps(m(1, 1)), m12 = _mm512_set1_ps(m(1, 2));
+        __m512 m20 = _mm512_set1_ps(m(2, 0)), m21 = _mm512_set1_ps(m(2, 1));
+        __m512 m22 = _mm512_set1_ps(m(2, 2));
+        float w = points ? 1.0f : 0.0f;
+        __m512 m30 = _mm512_set1_ps(m(3, 0) * w);
+        __m512 m31 = _mm512_set1_ps(m(3, 1) * w);
+        __m512 m32 = _mm512_set1_ps(m(3, 2) * w);
+        std::size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            __m512 x, y, z;
+            load3(in + 3 * i, x, y, z);
+            __m512 rx = _mm512_fmadd_ps(z, m20, _mm512_fmadd_ps(y, m10,
+                            _mm512_fmadd_ps(x, m00, m30)));
+            __m512 ry = _mm512_fmadd_ps(z, m21, _mm512_fmadd_ps(y, m11,
+                            _mm512_fmadd_ps(x, m01, m31)));
+            __m512 rz = _mm512_fmadd_ps(z, m22, _mm512_fmadd_ps(y, m12,
+                            _mm512_fmadd_ps(x, m02, m32)));
+            store3(out + 3 * i, rx, ry, rz);
+        }
+        transform_avx2(m, in + 3 * i, out + 3 * i, n - i, points);
+    }
+
+    MATH_TARGET("avx512f,avx2,fma")
+    static void normalize_avx512(const float *in, float *out, std::size_t n)
+    {
+        std::size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            __m512 x, y, z;
+            load3(in + 3 * i, x, y, z);
+            __m512 d = _mm512_fmadd_ps(x, x, _mm512_fmadd_ps(y, y,
+                           _mm512_mul_ps(z, z)));
+            __m512 r = _mm512_mask_rsqrt14_ps(d, 0xffff, d);
+            __m512 h = _mm512_mul_ps(_mm512_mul_ps(d, _mm512_set1_ps(0.5f)), r);
+            r = _mm512_mul_ps(r, _mm512_fnmadd_ps(h, r, _mm512_set1_ps(1.5f)));
+            store3(out + 3 * i, _mm512_mul_ps(x, r), _mm512_mul_ps(y, r),
+                   _mm512_mul_ps(z, r));
+        }
+        normalize_avx2(in + 3 * i, out + 3 * i, n - i);
+    }
+#endif
+};
+
+/**
+ * @return batch kernels of get_isa(), constructed on first call
+ */
+inline const batch_kernels &get_batch_kernels()
+{
+    static const batch_kernels kernels;
+    return kernels;
+}
+}
+
+#endif
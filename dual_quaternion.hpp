@@ -0,0 +1,421 @@
+#ifndef _MATH_DUAL_QUATERNION_
+#define _MATH_DUAL_QUATERNION_
+
+#include <iostream>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "vector.hpp"
+#include "matrix.hpp"
+#include "quaternion.hpp"
+
+namespace math
+{
+/**
+ * Dual quaternion class, r + e d
+ *
+ * Unit dual quaternions represent rigid transforms: rotation by r followed by
+ * translation t, where d = t r / 2. Composition follows quaternion product,
+ * (a * b).transform(p) == a.transform(b.transform(p)), so
+ * (a * b).to_matrix4() == b.to_matrix4() * a.to_matrix4() for row vectors.
+ */
+template<class T>
+class dual_quaternion
+{
+    typedef T type;
+
+public:
+    /**
+     * Real part
+     */
+    quaternion<T> r;
+
+    /**
+     * Dual part
+     */
+    quaternion<T> d;
+
+    /**
+     * Construct identity transform
+     */
+    constexpr dual_quaternion() :
+        r(T(1)), d(T(0))
+    {
+    }
+
+    /**
+     * Construct dual quaternion (r, d)
+     */
+    constexpr dual_quaternion(const quaternion<T> &r, const quaternion<T> &d) :
+        r(r), d(d)
+    {
+    }
+
+    /**
+     * Construct rigid transform, rotation by unit quaternion r followed by
+     * translation t
+     */
+    constexpr dual_quaternion(const quaternion<T> &r, const vector3<T> &t) :
+        r(r), d(quaternion<T>(t * T(0.5), T(0)) * r)
+    {
+    }
+
+    /**
+     * Construct rigid transform from matrix without scale
+     */
+    explicit dual_quaternion(const matrix4<T> &m) :
+        dual_quaternion(quaternion<T>::from_matrix(m),
+                        vector3<T>(m(3, 0), m(3, 1), m(3, 2)))
+    {
+    }
+
+    /**
+     * Set dual quaternion (r, d)
+     */
+    inline constexpr dual_quaternion<T> &set(const quaternion<T> &r,
+                                             const quaternion<T> &d)
+    {
+        this->r = r;
+        this->d = d;
+        return *this;
+    }
+
+    /**
+     * Set rigid transform, rotation by unit quaternion r followed by
+     * translation t
+     */
+    inline constexpr dual_quaternion<T> &set(const quaternion<T> &r,
+                                             const vector3<T> &t)
+    {
+        *this = dual_quaternion<T>(r, t);
+        return *this;
+    }
+
+    /**
+     * Operator +=
+     */
+    inline constexpr dual_quaternion<T> &operator +=(const dual_quaternion<T> &rhs)
+    {
+        r += rhs.r;
+        d += rhs.d;
+        return *this;
+    }
+
+    /**
+     * Operator +
+     */
+    inline constexpr dual_quaternion<T> operator +(const dual_quaternion<T> &rhs) const
+    {
+        return dual_quaternion<T>(r + rhs.r, d + rhs.d);
+    }
+
+    /**
+     * Operator -=
+     */
+    inline constexpr dual_quaternion<T> &operator -=(const dual_quaternion<T> &rhs)
+    {
+        r -= rhs.r;
+        d -= rhs.d;
+        return *this;
+    }
+
+    /**
+     * Operator -
+     */
+    inline constexpr dual_quaternion<T> operator -(const dual_quaternion<T> &rhs) const
+    {
+        return dual_quaternion<T>(r - rhs.r, d - rhs.d);
+    }
+
+    /**
+     * Operator *=
+     */
+    inline constexpr dual_quaternion<T> &operator *=(T rhs)
+    {
+        r *= rhs;
+        d *= rhs;
+        return *this;
+    }
+
+    /**
+     * Operator *
+     */
+    inline constexpr dual_quaternion<T> operator *(T rhs) const
+    {
+        return dual_quaternion<T>(r * rhs, d * rhs);
+    }
+
+    /**
+     * Operator *
+     */
+    friend inline constexpr dual_quaternion<T> operator *(T lhs, const dual_quaternion<T> &rhs)
+    {
+        return dual_quaternion<T>(lhs * rhs.r, lhs * rhs.d);
+    }
+
+    /**
+     * Operator *=, composition
+     */
+    inline constexpr dual_quaternion<T> &operator *=(const dual_quaternion<T> &rhs)
+    {
+        *this = *this * rhs;
+        return *this;
+    }
+
+    /**
+     * Operator *, composition, rhs is applied first
+     */
+    inline constexpr dual_quaternion<T> operator *(const dual_quaternion<T> &rhs) const
+    {
+        return dual_quaternion<T>(r * rhs.r, r * rhs.d + d * rhs.r);
+    }
+
+    /**
+     * Operator ==
+     */
+    inline constexpr bool operator ==(const dual_quaternion<T> &rhs) const
+    {
+        return r == rhs.r && d == rhs.d;
+    }
+
+    /**
+     * Operator !=
+     */
+    inline constexpr bool operator !=(const dual_quaternion<T> &rhs) const
+    {
+        return !operator ==(rhs);
+    }
+
+    /**
+     * @return translation of unit dual quaternion
+     */
+    inline constexpr vector3<T> get_translation() const
+    {
+        return (d * r.get_conjugate()).v * T(2);
+    }
+
+    /**
+     * @return normalized dual quaternion, real part is unit and dual part
+     * orthogonal to it
+     */
+    inline dual_quaternion<T> get_normalize() const
+    {
+        T m = T(1) / std::sqrt(r.get_norm());
+        quaternion<T> nr = r * m, nd = d * m;
+        return dual_quaternion<T>(nr, nd - nr * dot(nr, nd));
+    }
+
+    /**
+     * Set normalized dual quaternion
+     */
+    inline dual_quaternion<T> &normalize()
+    {
+        *this = get_normalize();
+        return *this;
+    }
+
+    /**
+     * @return conjugated dual quaternion (r*, d*)
+     */
+    inline constexpr dual_quaternion<T> get_conjugate() const
+    {
+        return dual_quaternion<T>(r.get_conjugate(), d.get_conjugate());
+    }
+
+    /**
+     * Set conjugated dual quaternion
+     */
+    inline constexpr dual_quaternion<T> &conjugate()
+    {
+        *this = get_conjugate();
+        return *this;
+    }
+
+    /**
+     * @return inversed dual quaternion
+     */
+    inline constexpr dual_quaternion<T> get_inverse() const
+    {
+        quaternion<T> ir = r.get_inverse();
+        return dual_quaternion<T>(ir, (ir * d * ir) * T(-1));
+    }
+
+    /**
+     * Set inversed dual quaternion
+     */
+    inline constexpr dual_quaternion<T> &inverse()
+    {
+        *this = get_inverse();
+        return *this;
+    }
+
+    /**
+     * @return inversed unit dual quaternion, same as conjugate
+     */
+    inline constexpr dual_quaternion<T> get_inverse_rigid() const
+    {
+        return get_conjugate();
+    }
+
+    /**
+     * Set inversed unit dual quaternion
+     */
+    inline constexpr dual_quaternion<T> &inverse_rigid()
+    {
+        *this = get_inverse_rigid();
+        return *this;
+    }
+
+    /**
+     * @return point transformed by unit dual quaternion
+     */
+    inline constexpr vector3<T> transform(const vector3<T> &rhs) const
+    {
+        return r.rotate(rhs) + get_translation();
+    }
+
+    /**
+     * @return direction transformed by unit dual quaternion
+     */
+    inline constexpr vector3<T> transform_direction(const vector3<T> &rhs) const
+    {
+        return r.rotate(rhs);
+    }
+
+    /**
+     * @return rigid transform matrix for row vectors
+     */
+    inline constexpr matrix4<T> to_matrix4() const
+    {
+        matrix3<T> m = r.to_matrix3();
+        vector3<T> t = get_translation();
+        return matrix4<T>(m(0, 0), m(0, 1), m(0, 2), T(0),
+                          m(1, 0), m(1, 1), m(1, 2), T(0),
+                          m(2, 0), m(2, 1), m(2, 2), T(0),
+                          t.x, t.y, t.z, T(1));
+    }
+
+    /**
+     * @return unit dual quaternion of rigid transform matrix
+     */
+    static inline dual_quaternion<T> from_matrix(const matrix4<T> &m)
+    {
+        return dual_quaternion<T>(m);
+    }
+
+    friend inline std::ostream &operator <<(std::ostream &lhs,
+                                            const dual_quaternion<T> &rhs)
+    {
+        return lhs << "(" << rhs.r << ", " << rhs.d << ")";
+    }
+};
+
+/**
+ * Dual quaternion linear blend skinning of n vertices
+ *
+ * Every vertex has four influences, bones[4 * i + k] indexes palette of unit
+ * dual quaternions and weights[4 * i + k] is its weight, unused influences
+ * have zero weight. Influences are flipped into hemisphere of first one,
+ * blended, normalized and applied to positions and, when not null, normals.
+ * Vertices are processed in blocks laid out across lanes, outputs may be
+ * equal to inputs.
+ */
+template<class T>
+inline void skin(const dual_quaternion<T> *palette,
+                 const std::uint16_t *bones, const T *weights,
+                 const vector3<T> *positions, const vector3<T> *normals,
+                 vector3<T> *out_positions, vector3<T> *out_normals,
+                 std::size_t n)
+{
+    const std::size_t lanes = 8;
+    for (std::size_t b = 0; b < n; b += lanes)
+    {
+        std::size_t count = n - b < lanes ? n - b : lanes;
+        T rx[lanes], ry[lanes], rz[lanes], rw[lanes];
+        T dx[lanes], dy[lanes], dz[lanes], dw[lanes];
+        for (std::size_t l = 0; l < lanes; l++)
+        {
+            std::size_t i = b + (l < count ? l : 0);
+            const quaternion<T> &pivot = palette[bones[4 * i]].r;
+            rx[l] = ry[l] = rz[l] = rw[l] = T(0);
+            dx[l] = dy[l] = dz[l] = dw[l] = T(0);
+            for (std::size_t k = 0; k < 4; k++)
+            {
+                const dual_quaternion<T> &q = palette[bones[4 * i + k]];
+                T w = weights[4 * i + k];
+                if (dot(pivot, q.r) < T(0))
+                    w = -w;
+                rx[l] += q.r.v.x * w;
+                ry[l] += q.r.v.y * w;
+                rz[l] += q.r.v.z * w;
+                rw[l] += q.r.w * w;
+                dx[l] += q.d.v.x * w;
+                dy[l] += q.d.v.y * w;
+                dz[l] += q.d.v.z * w;
+                dw[l] += q.d.w * w;
+            }
+        }
+        T tx[lanes], ty[lanes], tz[lanes];
+        for (std::size_t l = 0; l < lanes; l++)
+        {
+            T m = T(1) / std::sqrt(rx[l] * rx[l] + ry[l] * ry[l] +
+                                   rz[l] * rz[l] + rw[l] * rw[l]);
+            rx[l] *= m;
+            ry[l] *= m;
+            rz[l] *= m;
+            rw[l] *= m;
+            dx[l] *= m;
+            dy[l] *= m;
+            dz[l] *= m;
+            dw[l] *= m;
+            tx[l] = T(2) * (rw[l] * dx[l] - dw[l] * rx[l] +
+                            ry[l] * dz[l] - rz[l] * dy[l]);
+            ty[l] = T(2) * (rw[l] * dy[l] - dw[l] * ry[l] +
+                            rz[l] * dx[l] - rx[l] * dz[l]);
+            tz[l] = T(2) * (rw[l] * dz[l] - dw[l] * rz[l] +
+                            rx[l] * dy[l] - ry[l] * dx[l]);
+        }
+        for (int pass = 0; pass < 2; pass++)
+        {
+            const vector3<T> *in = pass ? normals : positions;
+            vector3<T> *out = pass ? out_normals : out_positions;
+            if (!in)
+                break;
+            T px[lanes], py[lanes], pz[lanes];
+            for (std::size_t l = 0; l < lanes; l++)
+            {
+                const vector3<T> &p = in[b + (l < count ? l : 0)];
+                px[l] = p.x;
+                py[l] = p.y;
+                pz[l] = p.z;
+            }
+            T s = pass ? T(0) : T(1);
+            for (std::size_t l = 0; l < lanes; l++)
+            {
+                T ux = T(2) * (ry[l] * pz[l] - rz[l] * py[l]);
+                T uy = T(2) * (rz[l] * px[l] - rx[l] * pz[l]);
+                T uz = T(2) * (rx[l] * py[l] - ry[l] * px[l]);
+                T qx = px[l] + rw[l] * ux + ry[l] * uz - rz[l] * uy;
+                T qy = py[l] + rw[l] * uy + rz[l] * ux - rx[l] * uz;
+                T qz = pz[l] + rw[l] * uz + rx[l] * uy - ry[l] * ux;
+                px[l] = qx + s * tx[l];
+                py[l] = qy + s * ty[l];
+                pz[l] = qz + s * tz[l];
+            }
+            for (std::size_t l = 0; l < count; l++)
+                out[b + l].set(px[l], py[l], pz[l]);
+        }
+    }
+}
+
+typedef dual_quaternion<float> dual_quaternionf;
+typedef dual_quaternion<double> dual_quaterniond;
+typedef dual_quaternion<long double> dual_quaternionld;
+
+static_assert(std::is_trivially_copyable<dual_quaternion<double> >::value,
+              "dual_quaternion must be trivially copyable");
+}
+
+#endif
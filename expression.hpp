@@ -0,0 +1,362 @@
+#ifndef _MATH_EXPRESSION_
+#define _MATH_EXPRESSION_
+
+#include <cstddef>
+#include <cassert>
+
+#include "vector.hpp"
+#include "quaternion.hpp"
+#include "vector_soa.hpp"
+
+namespace math
+{
+/**
+ * Opt-in expression templates
+ *
+ * Operands wrapped with lazy() build an expression tree instead of
+ * temporaries, the whole chain is then evaluated component by component in
+ * a single pass by assign():
+ *
+ *     math::assign(r, math::lazy(a) + math::lazy(b) * s - math::lazy(c));
+ *
+ * Only element-wise operations are fused: +, - and multiplication or
+ * division by scalar. Fixed-size vectors mixed with vector3_soa operands
+ * are broadcast to every element of the batch, all vector3_soa operands
+ * must have the same size.
+ */
+template<class E>
+struct expression
+{
+    inline const E &self() const
+    {
+        return static_cast<const E &>(*this);
+    }
+};
+
+/**
+ * Component access of fixed-size types
+ */
+template<class V>
+struct expression_traits;
+
+template<std::size_t N, class T>
+struct expression_traits<vector<N, T> >
+{
+    typedef T type;
+    static const unsigned int components = N;
+
+    static inline T get(const vector<N, T> &v, unsigned int c)
+    {
+        return v[c];
+    }
+
+    static inline void set(vector<N, T> &v, unsigned int c, T n)
+    {
+        v[c] = n;
+    }
+};
+
+template<class T>
+struct expression_traits<quaternion<T> >
+{
+    typedef T type;
+    static const unsigned int components = 4;
+
+    static inline T get(const quaternion<T> &q, unsigned int c)
+    {
+        return c < 3 ? q.v[c] : q.w;
+    }
+
+    static inline void set(quaternion<T> &q, unsigned int c, T n)
+    {
+        if (c < 3)
+            q.v[c] = n;
+        else
+            q.w = n;
+    }
+};
+
+/**
+ * Fixed-size operand, broadcast over batch elements
+ */
+template<class V>
+class expression_value : public expression<expression_value<V> >
+{
+    const V &v;
+
+public:
+    typedef typename expression_traits<V>::type type;
+    static const unsigned int components = expression_traits<V>::components;
+
+    explicit expression_value(const V &v) :
+        v(v)
+    {
+    }
+
+    /**
+     * @return number of batch elements, 0 when broadcast
+     */
+    inline std::size_t get_size() const
+    {
+        return 0;
+    }
+
+    inline type get(unsigned int c, std::size_t) const
+    {
+        return expression_traits<V>::get(v, c);
+    }
+};
+
+/**
+ * Batch operand
+ */
+template<class T>
+class expression_soa : public expression<expression_soa<T> >
+{
+    const T *a[3];
+    std::size_t size;
+
+public:
+    typedef T type;
+    static const unsigned int components = 3;
+
+    explicit expression_soa(const vector3_soa<T> &v) :
+        size(v.get_size())
+    {
+        a[0] = v.get_x();
+        a[1] = v.get_y();
+        a[2] = v.get_z();
+    }
+
+    inline std::size_t get_size() const
+    {
+        return size;
+    }
+
+    inline T get(unsigned int c, std::size_t i) const
+    {
+        return a[c][i];
+    }
+};
+
+struct expression_add
+{
+    template<class T>
+    static inline T apply(T lhs, T rhs)
+    {
+        return lhs + rhs;
+    }
+};
+
+struct expression_sub
+{
+    template<class T>
+    static inline T apply(T lhs, T rhs)
+    {
+        return lhs - rhs;
+    }
+};
+
+/**
+ * Element-wise binary operation
+ */
+template<class L, class R, class Op>
+class expression_binary : public expression<expression_binary<L, R, Op> >
+{
+    L lhs;
+    R rhs;
+
+public:
+    typedef typename L::type type;
+    static const unsigned int components = L::components;
+
+    expression_binary(const L &lhs, const R &rhs) :
+        lhs(lhs), rhs(rhs)
+    {
+    }
+
+    /**
+     * @return number of batch elements, 0 when both operands are broadcast
+     *
+     * Batch operands must have equal sizes, without assertions the smaller
+     * size is used so no operand is read past its end.
+     */
+    inline std::size_t get_size() const
+    {
+        std::size_t l = lhs.get_size(), r = rhs.get_size();
+        assert(!l || !r || l == r);
+        return !l || (r && r < l) ? r : l;
+    }
+
+    inline type get(unsigned int c, std::size_t i) const
+    {
+        return Op::apply(lhs.get(c, i), rhs.get(c, i));
+    }
+};
+
+/**
+ * Multiplication by scalar
+ */
+template<class E>
+class expression_scale : public expression<expression_scale<E> >
+{
+public:
+    typedef typename E::type type;
+    static const unsigned int components = E::components;
+
+private:
+    E e;
+    type s;
+
+public:
+    expression_scale(const E &e, type s) :
+        e(e), s(s)
+    {
+    }
+
+    inline std::size_t get_size() const
+    {
+        return e.get_size();
+    }
+
+    inline type get(unsigned int c, std::size_t i) const
+    {
+        return e.get(c, i) * s;
+    }
+};
+
+/**
+ * @return expression operand referencing v, v must outlive expression
+ */
+template<std::size_t N, class T>
+inline expression_value<vector<N, T> > lazy(const vector<N, T> &v)
+{
+    return expression_value<vector<N, T> >(v);
+}
+
+template<class T>
+inline expression_value<quaternion<T> > lazy(const quaternion<T> &q)
+{
+    return expression_value<quaternion<T> >(q);
+}
+
+template<class T>
+inline expression_soa<T> lazy(const vector3_soa<T> &v)
+{
+    return expression_soa<T>(v);
+}
+
+/**
+ * Operator +
+ */
+template<class L, class R>
+inline expression_binary<L, R, expression_add>
+operator +(const expression<L> &lhs, const expression<R> &rhs)
+{
+    static_assert(L::components == R::components,
+                  "operands have different number of components");
+    return expression_binary<L, R, expression_add>(lhs.self(), rhs.self());
+}
+
+/**
+ * Operator -
+ */
+template<class L, class R>
+inline expression_binary<L, R, expression_sub>
+operator -(const expression<L> &lhs, const expression<R> &rhs)
+{
+    static_assert(L::components == R::components,
+                  "operands have different number of components");
+    return expression_binary<L, R, expression_sub>(lhs.self(), rhs.self());
+}
+
+/**
+ * Operator -
+ */
+template<class E>
+inline expression_scale<E> operator -(const expression<E> &e)
+{
+    return expression_scale<E>(e.self(), typename E::type(-1));
+}
+
+/**
+ * Operator *
+ */
+template<class E>
+inline expression_scale<E> operator *(const expression<E> &lhs,
+                                      typename E::type rhs)
+{
+    return expression_scale<E>(lhs.self(), rhs);
+}
+
+/**
+ * Operator *
+ */
+template<class E>
+inline expression_scale<E> operator *(typename E::type lhs,
+                                      const expression<E> &rhs)
+{
+    return expression_scale<E>(rhs.self(), lhs);
+}
+
+/**
+ * Operator /
+ */
+template<class E>
+inline expression_scale<E> operator /(const expression<E> &lhs,
+                                      typename E::type rhs)
+{
+    return expression_scale<E>(lhs.self(), typename E::type(1) / rhs);
+}
+
+/**
+ * Evaluate expression into fixed-size value
+ */
+template<class V, class E>
+inline V &assign(V &dst, const expression<E> &e)
+{
+    typedef typename expression_traits<V>::type T;
+    static_assert(expression_traits<V>::components == E::components,
+                  "destination has different number of components");
+    T r[E::components];
+    for (unsigned int c = 0; c < E::components; c++)
+        r[c] = e.self().get(c, 0);
+    for (unsigned int c = 0; c < E::components; c++)
+        expression_traits<V>::set(dst, c, r[c]);
+    return dst;
+}
+
+/**
+ * Evaluate expression into batch in one pass per component, dst is resized
+ * to the batch size of expression and may be one of its operands. Operands
+ * have the size of expression, so dst is never reallocated while it is
+ * read. Padding of dst is left zero.
+ */
+template<class T, class E>
+inline vector3_soa<T> &assign(vector3_soa<T> &dst, const expression<E> &e)
+{
+    static_assert(E::components == 3,
+                  "destination has different number of components");
+    const std::size_t lanes = vector3_soa<T>::lanes;
+    std::size_t size = e.self().get_size();
+    if (size && size != dst.get_size())
+        dst.resize(size);
+    T *d[3] = {dst.get_x(), dst.get_y(), dst.get_z()};
+    for (unsigned int c = 0; c < 3; c++)
+        for (std::size_t b = 0; b < dst.get_size(); b += lanes)
+        {
+            T r[lanes];
+            for (std::size_t l = 0; l < lanes; l++)
+                r[l] = e.self().get(c, b + l);
+            if (dst.get_size() - b >= lanes)
+                for (std::size_t l = 0; l < lanes; l++)
+                    d[c][b + l] = r[l];
+            else
+                for (std::size_t l = 0; b + l < dst.get_size(); l++)
+                    d[c][b + l] = r[l];
+        }
+    return dst;
+}
+}
+
+#endif
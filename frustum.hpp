@@ -0,0 +1,409 @@
+#ifndef _MATH_FRUSTUM_
+#define _MATH_FRUSTUM_
+
+#include <iostream>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "vector.hpp"
+#include "matrix.hpp"
+#include "bounds.hpp"
+
+namespace math
+{
+/**
+ * View frustum class
+ *
+ * Six planes a x + b y + c z + d >= 0 bound the inside, normals point
+ * inwards. Planes are stored as structure of arrays, batch tests lay objects
+ * out across lanes and run every plane over the whole block.
+ */
+template<class T>
+class frustum
+{
+    typedef T type;
+
+public:
+    /**
+     * Plane indices
+     */
+    enum
+    {
+        plane_left, plane_right, plane_bottom, plane_top, plane_near,
+        plane_far, planes
+    };
+
+    /**
+     * Result of classify()
+     */
+    enum
+    {
+        outside, intersecting, inside
+    };
+
+    /**
+     * Number of objects tested by one kernel block
+     */
+    static const std::size_t lanes = 8;
+
+    /**
+     * Plane coefficients
+     */
+    T a[planes], b[planes], c[planes], d[planes];
+
+    /**
+     * Construct frustum containing everything
+     */
+    constexpr frustum() :
+        a(), b(), c(), d{T(1), T(1), T(1), T(1), T(1), T(1)}
+    {
+    }
+
+    /**
+     * Construct frustum of view-projection matrix for row vectors
+     * @param zero_to_one clip depth range is [0, w] instead of [-w, w]
+     */
+    explicit frustum(const matrix4<T> &m, bool zero_to_one = false)
+    {
+        set(m, zero_to_one);
+    }
+
+    /**
+     * Set frustum of view-projection matrix for row vectors, planes are
+     * combinations of clip space columns (Gribb, Hartmann). Degenerate
+     * planes, like far plane of infinite projection, are kept unnormalized
+     * and accept everything.
+     * @param zero_to_one clip depth range is [0, w] instead of [-w, w]
+     */
+    inline frustum<T> &set(const matrix4<T> &m, bool zero_to_one = false)
+    {
+        for (unsigned int i = 0; i < 3; i++)
+        {
+            T s = T(i == 2 && zero_to_one ? 0 : 1);
+            set_plane(2 * i, m(0, 3) * s + m(0, i), m(1, 3) * s + m(1, i),
+                      m(2, 3) * s + m(2, i), m(3, 3) * s + m(3, i));
+            set_plane(2 * i + 1, m(0, 3) - m(0, i), m(1, 3) - m(1, i),
+                      m(2, 3) - m(2, i), m(3, 3) - m(3, i));
+        }
+        return *this;
+    }
+
+    /**
+     * Set i plane, normalized unless degenerate
+     */
+    inline frustum<T> &set_plane(unsigned int i, T pa, T pb, T pc, T pd)
+    {
+        T n = std::sqrt(pa * pa + pb * pb + pc * pc);
+        T m = n > T(0) ? T(1) / n : T(1);
+        a[i] = pa * m;
+        b[i] = pb * m;
+        c[i] = pc * m;
+        d[i] = pd * m;
+        return *this;
+    }
+
+    /**
+     * Explicit getter
+     * @return i plane (a, b, c, d)
+     */
+    inline constexpr vector4<T> get_plane(unsigned int i) const
+    {
+        return vector4<T>(a[i], b[i], c[i], d[i]);
+    }
+
+    /**
+     * @return true if point is inside frustum
+     */
+    inline constexpr bool contains(const vector3<T> &p) const
+    {
+        bool r = true;
+        for (unsigned int i = 0; i < planes; i++)
+            r = r && a[i] * p.x + b[i] * p.y + c[i] * p.z + d[i] >= T(0);
+        return r;
+    }
+
+    /**
+     * @return true if box is not completely outside
+     */
+    inline constexpr bool overlaps(const aabb<T> &box) const
+    {
+        return classify(box) != outside;
+    }
+
+    /**
+     * @return true if sphere is not completely outside
+     */
+    inline constexpr bool overlaps(const bsphere<T> &s) const
+    {
+        return classify(s) != outside;
+    }
+
+    /**
+     * @return outside, intersecting or inside for box
+     */
+    inline constexpr int classify(const aabb<T> &box) const
+    {
+        unsigned int mask = (1 << planes) - 1;
+        return classify(box, mask);
+    }
+
+    /**
+     * @return outside, intersecting or inside for sphere
+     */
+    inline constexpr int classify(const bsphere<T> &s) const
+    {
+        if (s.is_empty())
+            return outside;
+        int r = inside;
+        for (unsigned int i = 0; i < planes; i++)
+        {
+            T t = a[i] * s.center.x + b[i] * s.center.y + c[i] * s.center.z +
+                  d[i];
+            if (t < -s.radius)
+                return outside;
+            if (t < s.radius)
+                r = intersecting;
+        }
+        return r;
+    }
+
+    /**
+     * @return outside, intersecting or inside for box tested only against
+     * planes in mask, mask is reduced to planes box intersects
+     */
+    inline constexpr int classify(const aabb<T> &box, unsigned int &mask) const
+    {
+        if (box.is_empty())
+            return outside;
+        vector3<T> m = box.get_center(), e = box.get_extent();
+        unsigned int straddle = 0;
+        for (unsigned int i = 0; i < planes; i++)
+        {
+            if (!(mask & (1 << i)))
+                continue;
+            T t = a[i] * m.x + b[i] * m.y + c[i] * m.z + d[i];
+            T r = abs(a[i]) * e.x + abs(b[i]) * e.y + abs(c[i]) * e.z;
+            if (t + r < T(0))
+                return outside;
+            if (t - r < T(0))
+                straddle |= 1 << i;
+        }
+        mask = straddle;
+        return straddle ? intersecting : inside;
+    }
+
+    /**
+     * Test n boxes, bit i % 32 of mask[i / 32] is set for visible box i,
+     * all (n + 31) / 32 words are written
+     */
+    inline void test(const aabb<T> *box, std::size_t n,
+                     std::uint32_t *mask) const
+    {
+        for (std::size_t i = 0; i < n; i += lanes)
+        {
+            std::uint32_t bits = test_block(box, i, n);
+            if (i % 32 == 0)
+                mask[i / 32] = 0;
+            mask[i / 32] |= bits << (i % 32);
+        }
+    }
+
+    /**
+     * Test n spheres, bit i % 32 of mask[i / 32] is set for visible sphere
+     * i, all (n + 31) / 32 words are written
+     */
+    inline void test(const bsphere<T> *s, std::size_t n,
+                     std::uint32_t *mask) const
+    {
+        for (std::size_t i = 0; i < n; i += lanes)
+        {
+            std::uint32_t bits = test_block(s, i, n);
+            if (i % 32 == 0)
+                mask[i / 32] = 0;
+            mask[i / 32] |= bits << (i % 32);
+        }
+    }
+
+    /**
+     * Write indices of visible boxes out of n into indices
+     * @return number of visible boxes
+     */
+    inline std::size_t select(const aabb<T> *box, std::size_t n,
+                              std::uint32_t *indices) const
+    {
+        std::size_t count = 0;
+        for (std::size_t i = 0; i < n; i += lanes)
+            count = append(test_block(box, i, n), i, indices, count);
+        return count;
+    }
+
+    /**
+     * Write indices of visible spheres out of n into indices
+     * @return number of visible spheres
+     */
+    inline std::size_t select(const bsphere<T> *s, std::size_t n,
+                              std::uint32_t *indices) const
+    {
+        std::size_t count = 0;
+        for (std::size_t i = 0; i < n; i += lanes)
+            count = append(test_block(s, i, n), i, indices, count);
+        return count;
+    }
+
+    /**
+     * Write indices of visible boxes of hierarchy into indices
+     *
+     * Boxes are in depth-first order, size[i] is number of boxes in subtree
+     * of box i including itself, and every box contains its subtree.
+     * Subtree of box outside is skipped, subtree of box inside is accepted
+     * without tests, children of intersecting box are tested only against
+     * planes their parent intersects.
+     * @return number of visible boxes
+     */
+    inline std::size_t select(const aabb<T> *box, const std::uint32_t *size,
+                              std::size_t n, std::uint32_t *indices) const
+    {
+        std::vector<std::pair<std::size_t, unsigned int> > stack;
+        std::size_t count = 0;
+        for (std::size_t i = 0; i < n; )
+        {
+            while (!stack.empty() && stack.back().first <= i)
+                stack.pop_back();
+            unsigned int mask = stack.empty() ? (1 << planes) - 1 :
+                                                stack.back().second;
+            std::size_t end = i + size[i];
+            int r = mask ? classify(box[i], mask) : inside;
+            if (r == outside)
+                i = end;
+            else if (r == inside)
+                for (; i < end; i++)
+                    indices[count++] = std::uint32_t(i);
+            else
+            {
+                indices[count++] = std::uint32_t(i);
+                stack.push_back(std::make_pair(end, mask));
+                i++;
+            }
+        }
+        return count;
+    }
+
+    friend inline std::ostream &operator <<(std::ostream &lhs,
+                                            const frustum<T> &rhs)
+    {
+        lhs << "(";
+        for (unsigned int i = 0; i < planes; i++)
+            lhs << (i ? ", " : "") << rhs.get_plane(i);
+        return lhs << ")";
+    }
+
+private:
+    static inline constexpr T abs(T n)
+    {
+        return n < T(0) ? -n : n;
+    }
+
+    /**
+     * @return visibility bits of block of boxes starting at i
+     */
+    inline std::uint32_t test_block(const aabb<T> *box, std::size_t i,
+                                    std::size_t n) const
+    {
+        std::size_t count = n - i < lanes ? n - i : lanes;
+        T mx[lanes], my[lanes], mz[lanes], ex[lanes], ey[lanes], ez[lanes];
+        for (std::size_t l = 0; l < lanes; l++)
+        {
+            const aabb<T> &q = box[i + (l < count ? l : 0)];
+            mx[l] = (q.min.x + q.max.x) * T(0.5);
+            my[l] = (q.min.y + q.max.y) * T(0.5);
+            mz[l] = (q.min.z + q.max.z) * T(0.5);
+            ex[l] = (q.max.x - q.min.x) * T(0.5);
+            ey[l] = (q.max.y - q.min.y) * T(0.5);
+            ez[l] = (q.max.z - q.min.z) * T(0.5);
+        }
+        std::uint32_t v[lanes];
+        for (std::size_t l = 0; l < lanes; l++)
+            v[l] = ex[l] >= T(0) && ey[l] >= T(0) && ez[l] >= T(0);
+        for (unsigned int p = 0; p < planes; p++)
+        {
+            const T pa = a[p], pb = b[p], pc = c[p], pd = d[p];
+            const T aa = abs(pa), ab = abs(pb), ac = abs(pc);
+            for (std::size_t l = 0; l < lanes; l++)
+            {
+                T t = pa * mx[l] + pb * my[l] + pc * mz[l] + pd +
+                      aa * ex[l] + ab * ey[l] + ac * ez[l];
+                v[l] &= t >= T(0);
+            }
+        }
+        return bits(v, count);
+    }
+
+    /**
+     * @return visibility bits of block of spheres starting at i
+     */
+    inline std::uint32_t test_block(const bsphere<T> *s, std::size_t i,
+                                    std::size_t n) const
+    {
+        std::size_t count = n - i < lanes ? n - i : lanes;
+        T mx[lanes], my[lanes], mz[lanes], r[lanes];
+        for (std::size_t l = 0; l < lanes; l++)
+        {
+            const bsphere<T> &q = s[i + (l < count ? l : 0)];
+            mx[l] = q.center.x;
+            my[l] = q.center.y;
+            mz[l] = q.center.z;
+            r[l] = q.radius;
+        }
+        std::uint32_t v[lanes];
+        for (std::size_t l = 0; l < lanes; l++)
+            v[l] = r[l] >= T(0);
+        for (unsigned int p = 0; p < planes; p++)
+        {
+            const T pa = a[p], pb = b[p], pc = c[p], pd = d[p];
+            for (std::size_t l = 0; l < lanes; l++)
+            {
+                T t = pa * mx[l] + pb * my[l] + pc * mz[l] + pd + r[l];
+                v[l] &= t >= T(0);
+            }
+        }
+        return bits(v, count);
+    }
+
+    static inline std::uint32_t bits(const std::uint32_t *v,
+                                     std::size_t count)
+    {
+        std::uint32_t r = 0;
+        for (std::size_t l = 0; l < lanes; l++)
+            r |= v[l] << l;
+        return r & ((1u << count) - 1);
+    }
+
+    /**
+     * Append indices of set bits, store is unconditional and count grows
+     * only for set bits
+     */
+    static inline std::size_t append(std::uint32_t bits, std::size_t i,
+                                     std::uint32_t *indices,
+                                     std::size_t count)
+    {
+        for (std::size_t l = 0; bits >> l; l++)
+        {
+            indices[count] = std::uint32_t(i + l);
+            count += (bits >> l) & 1;
+        }
+        return count;
+    }
+};
+
+template<class T>
+const std::size_t frustum<T>::lanes;
+
+typedef frustum<float> frustumf;
+typedef frustum<double> frustumd;
+typedef frustum<long double> frustumld;
+}
+
+#endif
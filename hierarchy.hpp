@@ -0,0 +1,374 @@
+#ifndef _MATH_HIERARCHY_
+#define _MATH_HIERARCHY_
+
+#include <cstddef>
+#include <cstdint>
+#include <cassert>
+#include <atomic>
+#include <vector>
+
+#include "aligned.hpp"
+#include "vector.hpp"
+#include "matrix.hpp"
+#include "quaternion.hpp"
+#include "thread_pool.hpp"
+
+namespace math
+{
+/**
+ * Transform hierarchy
+ *
+ * Every node has local translation, rotation and scale relative to its
+ * parent, local matrix is scale, then rotation, then translation for row
+ * vectors and world matrix is local * parent world. Nodes are appended after
+ * their parent, so index order is topological and every attribute lives in
+ * its own array. Setters mark nodes dirty, update() sweeps arrays once from
+ * the first dirty node and recomputes world matrices only of dirty nodes and
+ * their descendants. Large hierarchies are updated level by level on thread
+ * pool, nodes of one level are independent and split across threads.
+ */
+template<class T>
+class hierarchy
+{
+    typedef T type;
+    typedef std::vector<matrix4<T>, aligned_allocator<matrix4<T> > >
+        matrix_array;
+
+public:
+    /**
+     * Parent of root nodes
+     */
+    static const std::uint32_t invalid = ~std::uint32_t(0);
+
+    /**
+     * Construct empty hierarchy
+     */
+    hierarchy() :
+        first(0), sorted(true)
+    {
+    }
+
+    /**
+     * @return number of nodes
+     */
+    inline std::size_t get_size() const
+    {
+        return parent.size();
+    }
+
+    /**
+     * Reserve space for n nodes
+     */
+    inline void reserve(std::size_t n)
+    {
+        parent.reserve(n);
+        translation.reserve(n);
+        rotation.reserve(n);
+        scale.reserve(n);
+        world.reserve(n);
+        flags.reserve(n);
+    }
+
+    /**
+     * Remove all nodes
+     */
+    inline void clear()
+    {
+        parent.clear();
+        translation.clear();
+        rotation.clear();
+        scale.clear();
+        world.clear();
+        flags.clear();
+        first = 0;
+        sorted = false;
+    }
+
+    /**
+     * Append node, p is invalid for root or index of existing node, which
+     * keeps index order topological
+     * @return index of new node
+     */
+    inline std::uint32_t add(std::uint32_t p,
+                             const vector3<T> &t = vector3<T>(T(0)),
+                             const quaternion<T> &r = quaternion<T>(T(1)),
+                             const vector3<T> &s = vector3<T>(T(1)))
+    {
+        std::uint32_t i = std::uint32_t(parent.size());
+        assert(p == invalid || p < i);
+        parent.push_back(p);
+        translation.push_back(t);
+        rotation.push_back(r);
+        scale.push_back(s);
+        world.push_back(matrix4<T>());
+        flags.push_back(dirty);
+        if (i < first)
+            first = i;
+        sorted = false;
+        return i;
+    }
+
+    /**
+     * @return parent of i node, invalid for root
+     */
+    inline std::uint32_t get_parent(std::uint32_t i) const
+    {
+        return parent[i];
+    }
+
+    /**
+     * @return local translation of i node
+     */
+    inline const vector3<T> &get_translation(std::uint32_t i) const
+    {
+        return translation[i];
+    }
+
+    /**
+     * @return local rotation of i node
+     */
+    inline const quaternion<T> &get_rotation(std::uint32_t i) const
+    {
+        return rotation[i];
+    }
+
+    /**
+     * @return local scale of i node
+     */
+    inline const vector3<T> &get_scale(std::uint32_t i) const
+    {
+        return scale[i];
+    }
+
+    /**
+     * Set local translation of i node
+     */
+    inline hierarchy<T> &set_translation(std::uint32_t i, const vector3<T> &t)
+    {
+        translation[i] = t;
+        return invalidate(i);
+    }
+
+    /**
+     * Set local rotation of i node, r must be unit quaternion
+     */
+    inline hierarchy<T> &set_rotation(std::uint32_t i, const quaternion<T> &r)
+    {
+        rotation[i] = r;
+        return invalidate(i);
+    }
+
+    /**
+     * Set local scale of i node
+     */
+    inline hierarchy<T> &set_scale(std::uint32_t i, const vector3<T> &s)
+    {
+        scale[i] = s;
+        return invalidate(i);
+    }
+
+    /**
+     * Set local transform of i node
+     */
+    inline hierarchy<T> &set_local(std::uint32_t i, const vector3<T> &t,
+                                   const quaternion<T> &r,
+                                   const vector3<T> &s)
+    {
+        translation[i] = t;
+        rotation[i] = r;
+        scale[i] = s;
+        return invalidate(i);
+    }
+
+    /**
+     * @return local matrix of i node for row vectors
+     */
+    inline matrix4<T> get_local(std::uint32_t i) const
+    {
+        matrix3<T> m = rotation[i].to_matrix3();
+        const vector3<T> &s = scale[i], &t = translation[i];
+        return matrix4<T>(m(0, 0) * s.x, m(0, 1) * s.x, m(0, 2) * s.x, T(0),
+                          m(1, 0) * s.y, m(1, 1) * s.y, m(1, 2) * s.y, T(0),
+                          m(2, 0) * s.z, m(2, 1) * s.z, m(2, 2) * s.z, T(0),
+                          t.x, t.y, t.z, T(1));
+    }
+
+    /**
+     * @return world matrix of i node as of last update()
+     */
+    inline const matrix4<T> &get_world(std::uint32_t i) const
+    {
+        return world[i];
+    }
+
+    /**
+     * @return world matrices as of last update()
+     */
+    inline const matrix4<T> *get_worlds() const
+    {
+        return world.data();
+    }
+
+    /**
+     * @return true if world matrix of i node was recomputed by last update()
+     */
+    inline bool is_changed(std::uint32_t i) const
+    {
+        return (flags[i] & changed) != 0;
+    }
+
+    /**
+     * @return true if any node is dirty
+     */
+    inline bool is_dirty() const
+    {
+        for (std::size_t i = first; i < flags.size(); i++)
+            if (flags[i] & dirty)
+                return true;
+        return false;
+    }
+
+    /**
+     * Recompute world matrices of dirty nodes and their descendants
+     * @return number of recomputed nodes
+     */
+    inline std::size_t update()
+    {
+        std::size_t n = parent.size(), count = 0, next = n;
+        for (std::size_t i = first; i < n; i++)
+        {
+            std::uint32_t p = parent[i];
+            bool d = (flags[i] & dirty) ||
+                     (p != invalid && (flags[p] & changed));
+            flags[i] = d ? changed : 0;
+            if (!d)
+                continue;
+            world[i] = p == invalid ? get_local(std::uint32_t(i)) :
+                                      get_local(std::uint32_t(i)) * world[p];
+            next = next < i ? next : i;
+            count++;
+        }
+        first = next;
+        return count;
+    }
+
+    /**
+     * Recompute world matrices of dirty nodes and their descendants on pool,
+     * levels of at most grain nodes are processed by calling thread. Result
+     * is identical to update().
+     * @return number of recomputed nodes
+     */
+    inline std::size_t update(thread_pool &pool, std::size_t grain = 4096)
+    {
+        std::size_t n = parent.size();
+        if (pool.get_size() <= 1 || first >= n)
+            return update();
+        if (!sorted)
+            sort();
+        std::atomic<std::size_t> count(0), next(n);
+        for (std::size_t l = 0; l + 1 < level.size(); l++)
+        {
+            const std::uint32_t *nodes = order.data() + level[l];
+            auto sweep = [&](std::size_t begin, std::size_t end)
+            {
+                std::size_t c = 0, m = n;
+                for (std::size_t k = begin; k < end; k++)
+                {
+                    std::uint32_t i = nodes[k], p = parent[i];
+                    bool d = (flags[i] & dirty) ||
+                             (p != invalid && (flags[p] & changed));
+                    flags[i] = d ? changed : 0;
+                    if (!d)
+                        continue;
+                    world[i] = p == invalid ? get_local(i) :
+                                              get_local(i) * world[p];
+                    m = m < i ? m : i;
+                    c++;
+                }
+                count.fetch_add(c);
+                for (std::size_t o = next.load(); m < o &&
+                     !next.compare_exchange_weak(o, m); )
+                    ;
+            };
+            std::size_t size = level[l + 1] - level[l];
+            if (size <= grain)
+                sweep(0, size);
+            else
+                pool.parallel_for(size, grain, sweep);
+        }
+        first = next.load();
+        return count.load();
+    }
+
+private:
+    /**
+     * Node flags, dirty local transform and world matrix changed by last
+     * update
+     */
+    enum
+    {
+        dirty = 1, changed = 2
+    };
+
+    std::vector<std::uint32_t> parent;
+    std::vector<vector3<T> > translation;
+    std::vector<quaternion<T> > rotation;
+    std::vector<vector3<T> > scale;
+    matrix_array world;
+    std::vector<std::uint8_t> flags;
+
+    /**
+     * First node with nonzero flags, sweep starts here
+     */
+    std::size_t first;
+
+    /**
+     * Nodes sorted by depth, nodes of level l are order[level[l]] up to
+     * order[level[l + 1]], valid when sorted is true
+     */
+    std::vector<std::uint32_t> order;
+    std::vector<std::size_t> level;
+    bool sorted;
+
+    /**
+     * Sort nodes by depth keeping index order within level
+     */
+    inline void sort()
+    {
+        std::size_t n = parent.size();
+        std::vector<std::uint32_t> depth(n);
+        level.assign(1, 0);
+        for (std::size_t i = 0; i < n; i++)
+        {
+            depth[i] = parent[i] == invalid ? 0 : depth[parent[i]] + 1;
+            if (depth[i] + 1 >= level.size())
+                level.resize(depth[i] + 2, 0);
+            level[depth[i] + 1]++;
+        }
+        for (std::size_t l = 1; l < level.size(); l++)
+            level[l] += level[l - 1];
+        order.resize(n);
+        std::vector<std::size_t> fill(level.begin(), level.end() - 1);
+        for (std::size_t i = 0; i < n; i++)
+            order[fill[depth[i]]++] = std::uint32_t(i);
+        sorted = true;
+    }
+
+    inline hierarchy<T> &invalidate(std::uint32_t i)
+    {
+        flags[i] |= dirty;
+        if (i < first)
+            first = i;
+        return *this;
+    }
+};
+
+template<class T>
+const std::uint32_t hierarchy<T>::invalid;
+
+typedef hierarchy<float> hierarchyf;
+typedef hierarchy<double> hierarchyd;
+typedef hierarchy<long double> hierarchyld;
+}
+
+#endif
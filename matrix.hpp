@@ -3,82 +3,137 @@
 
 #include <iostream>
 #include <cmath>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
 
 #include "vector.hpp"
 
 namespace math
 {
-template<class T> class matrix4;
-
-template<class T>
-class matrix3
+template<std::size_t R, std::size_t C, class T> class matrix;
+
+template<class T> using matrix2 = matrix<2, 2, T>;
+template<class T> using matrix3 = matrix<3, 3, T>;
+template<class T> using matrix4 = matrix<4, 4, T>;
+template<class T> using matrix3x4 = matrix<3, 4, T>;
+template<class T> using matrix4x3 = matrix<4, 3, T>;
+
+/**
+ * R x C matrix class, elements are stored by rows
+ *
+ * Row vectors multiply from the left, vector<R> * matrix<R, C> is vector<C>
+ * and matrix<R, C> * matrix<C, K> is matrix<R, K>, so 3x4 and 4x3 products
+ * need no padding. Element-wise operations and products are expanded over
+ * index sequences and unrolled at compile time for every size. Determinant
+ * and inverse exist for 2x2, 3x3 and 4x4 matrices, batch transforms for
+ * matrix3 and matrix4, affine and rigid inverses for matrix4.
+ */
+template<std::size_t R, std::size_t C, class T>
+class matrix
 {
+    template<std::size_t, std::size_t, class> friend class matrix;
+
     typedef T type;
+    typedef std::make_index_sequence<R * C> indices;
+
+    T a[R * C];
+
+    struct identity_tag
+    {
+    };
+
+    struct fill_tag
+    {
+    };
+
+    struct array_tag
+    {
+    };
 
-    T a[9];
+    struct elements_tag
+    {
+    };
 
 public:
-    inline unsigned int get_size() const
+    /**
+     * @return number of rows of square matrix
+     */
+    inline constexpr unsigned int get_size() const
     {
-        return 3;
+        static_assert(R == C, "matrix must be square");
+        return R;
     }
 
-    inline unsigned int get_size_square() const
+    /**
+     * @return number of elements
+     */
+    inline constexpr unsigned int get_size_square() const
     {
-        return 9;
+        return R * C;
     }
 
-    matrix3()
+    inline constexpr unsigned int get_rows() const
     {
-        set_identity();
+        return R;
     }
 
-    explicit matrix3(T n)
+    inline constexpr unsigned int get_columns() const
     {
-        set(n);
+        return C;
     }
 
-    matrix3(T a11, T a12, T a13,
-            T a21, T a22, T a23,
-            T a31, T a32, T a33)
+    /**
+     * Construct identity matrix, ones on main diagonal if not square
+     */
+    constexpr matrix() :
+        matrix(identity_tag(), indices())
     {
-        set(a11, a12, a13,
-            a21, a22, a23,
-            a31, a32, a33);
     }
 
-    explicit matrix3(T *a)
+    explicit constexpr matrix(T n) :
+        matrix(fill_tag(), n, indices())
     {
-        set(a);
     }
 
-    ~matrix3()
+    /**
+     * Construct matrix of R * C elements given by rows
+     */
+    template<class... A, class = typename std::enable_if<
+                             (R * C > 1) && sizeof...(A) == R * C>::type>
+    constexpr matrix(A... e) :
+        a{T(e)...}
     {
     }
 
-    inline T &operator [](unsigned int i)
+    explicit constexpr matrix(const T *p) :
+        matrix(array_tag(), p, indices())
+    {
+    }
+
+    inline constexpr T &operator [](unsigned int i)
     {
         return a[i];
     }
 
-    inline const T &operator [](unsigned int i) const
+    inline constexpr const T &operator [](unsigned int i) const
     {
         return a[i];
     }
 
-    inline vector3<T> operator ()(unsigned int i) const
+    inline constexpr vector<C, T> operator ()(unsigned int i) const
     {
-        return vector3<T>(a + i * get_size());
+        return vector<C, T>(a + i * C);
     }
 
-    inline T &operator ()(unsigned int i, unsigned int k)
+    inline constexpr T &operator ()(unsigned int i, unsigned int k)
     {
-        return a[i * get_size() + k];
+        return a[i * C + k];
     }
 
-    inline const T &operator ()(unsigned int i, unsigned int k) const
+    inline constexpr const T &operator ()(unsigned int i, unsigned int k) const
     {
-        return a[i * get_size() + k];
+        return a[i * C + k];
     }
 
     inline operator T *()
@@ -91,445 +146,660 @@ public:
         return a;
     }
 
-    inline T &get(unsigned int i)
+    inline constexpr T &get(unsigned int i)
     {
         return a[i];
     }
 
-    inline const T &get(unsigned int i) const
+    inline constexpr const T &get(unsigned int i) const
     {
         return a[i];
     }
 
-    inline T &get(unsigned int i, unsigned int k)
+    inline constexpr T &get(unsigned int i, unsigned int k)
     {
-        return a[i * get_size() + k];
+        return a[i * C + k];
     }
 
-    inline const T &get(unsigned int i, unsigned int k) const
+    inline constexpr const T &get(unsigned int i, unsigned int k) const
     {
-        return a[i * get_size() + k];
+        return a[i * C + k];
     }
 
-    inline matrix3<T> &set(T *a)
+    inline constexpr matrix<R, C, T> &set(const T *p)
     {
-        for (unsigned int i = 0; i < get_size_square(); i++)
-            this->a[i] = a[i];
+        *this = matrix<R, C, T>(p);
         return *this;
     }
 
-    inline matrix3<T> &set(T a11, T a12, T a13,
-                           T a21, T a22, T a23,
-                           T a31, T a32, T a33)
+    template<class... A>
+    inline constexpr typename std::enable_if<
+        (R * C > 1) && sizeof...(A) == R * C, matrix<R, C, T> &>::type
+    set(A... e)
     {
-        get(0, 0) = a11;
-        get(0, 1) = a12;
-        get(0, 2) = a13;
-        get(1, 0) = a21;
-        get(1, 1) = a22;
-        get(1, 2) = a23;
-        get(2, 0) = a31;
-        get(2, 1) = a32;
-        get(2, 2) = a33;
+        *this = matrix<R, C, T>(e...);
+        return *this;
     }
 
-    inline matrix3<T> &set(T n)
+    inline constexpr matrix<R, C, T> &set(T n)
     {
-        for (unsigned int i = 0; i < get_size_square(); i++)
-            a[i] = n;
+        *this = matrix<R, C, T>(n);
+        return *this;
     }
 
-    inline matrix3<T> &set_identity()
+    inline constexpr matrix<R, C, T> &set_identity()
     {
-        for (unsigned int i = 0; i < get_size(); i++)
-            for (unsigned int k = 0; k < get_size(); k++)
-                if (i == k)
-                    get(i, k) = T(1);
-                else
-                    get(i, k) = T(0);
+        *this = matrix<R, C, T>();
+        return *this;
     }
 
-    inline matrix3<T> &operator +=(const matrix3<T> &m)
+    inline constexpr matrix<R, C, T> &operator +=(const matrix<R, C, T> &m)
     {
-        for (unsigned int i = 0; i < get_size_square(); i++)
-            a[i] += m[i];
+        *this = *this + m;
         return *this;
     }
 
-    inline matrix3<T> operator +(const matrix3<T> &m) const
+    inline constexpr matrix<R, C, T> operator +(const matrix<R, C, T> &m) const
     {
-        matrix3<T> nm;
-        for (unsigned int i = 0; i < get_size_square(); i++)
-            nm[i] = a[i] + m[i];
-        return nm;
+        return add(m, indices());
     }
 
-    inline matrix3<T> &operator *=(T n)
+    inline constexpr matrix<R, C, T> &operator *=(T n)
     {
-        for (unsigned int i = 0; i < get_size_square(); i++)
-            a[i] *= n;
+        *this = scale(n, indices());
         return *this;
     }
 
-    inline matrix3<T> &operator *=(const matrix3<T> &m)
+    inline constexpr matrix<R, C, T> &operator *=(const matrix<C, C, T> &m)
     {
-        matrix3<T> temp(*this);
-        for (unsigned int i = 0; i < get_size(); i++)
-            for (unsigned int k = 0; i < get_size(); i++)
-                for (unsigned int r = 0; r < get_size(); r++)
-                    get(i, k) = temp(i, r) * m(r, k);
+        *this = *this * m;
         return *this;
     }
 
-    inline matrix3<T> &operator *=(const vector3<T> &v)
+    /**
+     * Set every element of row i to v[i] times sum of row i
+     */
+    inline constexpr matrix<R, C, T> &operator *=(const vector<R, T> &v)
     {
-        matrix3<T> temp(*this);
-        set(T(0));
-        for (unsigned int i = 0; i < get_size(); i++)
-            for (unsigned int k = 0; k < get_size(); k++)
-                for (unsigned int r = 0; r < get_size(); r++)
-                    get(i, k) += temp(i, r) * v[i];
+        *this = *this * v;
         return *this;
     }
 
-    friend inline vector3<T> &operator *=(const vector3<T> &v,
-            const matrix3<T> &m)
+    friend inline constexpr vector<R, T> &operator *=(vector<R, T> &v,
+            const matrix<R, C, T> &m)
     {
-        vector3<T> temp(v);
-        v.set(T(0));
-        for (unsigned int i = 0; i < get_size(); i++)
-            for (unsigned int r = 0; r < get_size(); r++)
-                v[i] += temp[r] * m(r, i);
+        static_assert(R == C, "matrix must be square");
+        v = v * m;
         return v;
     }
 
-    inline matrix3<T> operator *(const matrix3<T> &m) const
+    /**
+     * @return product of R x C and C x K matrices
+     */
+    template<std::size_t K>
+    inline constexpr matrix<R, K, T> operator *(const matrix<C, K, T> &m) const
     {
-        matrix3<T> nm;
-        for (unsigned int i = 0; i < get_size(); i++)
-            for (unsigned int k = 0; i < get_size(); i++)
-                for (unsigned int r = 0; r < get_size(); r++)
-                    nm(i, k) += get(i, r) * m(r, k);
-        return nm;
+        return multiply(m, std::make_index_sequence<R * K>());
     }
 
-    inline matrix3<T> operator *(const vector3<T> &v) const
+    /**
+     * @return matrix with every element of row i set to v[i] times sum of
+     * row i
+     */
+    inline constexpr matrix<R, C, T> operator *(const vector<R, T> &v) const
     {
-        matrix3<T> nm;
-        for (unsigned int i = 0; i < get_size(); i++)
-            for (unsigned int k = 0; k < get_size(); k++)
-                for (unsigned int r = 0; r < get_size(); r++)
-                    nm(i, k) += get(i, r) * v[i];
-        return nm;
+        return scale_rows(v, indices());
     }
 
-    friend inline vector3<T> operator *(const vector3<T> &v,
-            const matrix3<T> &m)
+    /**
+     * @return product of row vector and matrix
+     */
+    friend inline constexpr vector<C, T> operator *(const vector<R, T> &v,
+            const matrix<R, C, T> &m)
     {
-        vector3<T> nv;
-        for (unsigned int i = 0; i < get_size(); i++)
-            for (unsigned int r = 0; r < get_size(); r++)
-                nv[i] += v[r] * m(r, i);
-        return nv;
+        return m.transform(v, std::make_index_sequence<C>());
     }
 
-    inline bool operator ==(const matrix3<T> &m) const
+    inline constexpr bool operator ==(const matrix<R, C, T> &m) const
     {
-        for (unsigned int i = 0; i < get_size_square(); i++)
-            if (a[i] != m[i])
+        for (std::size_t i = 0; i < R * C; i++)
+            if (a[i] != m.a[i])
                 return false;
         return true;
     }
 
-    inline bool operator !=(const matrix3<T> &m) const
+    inline constexpr bool operator !=(const matrix<R, C, T> &m) const
     {
         return !operator ==(m);
     }
 
-    inline matrix3<T> get_transpose() const
+    inline constexpr matrix<C, R, T> get_transpose() const
     {
-        matrix3<T> m(*this);
-        for (unsigned int i = 0; i < get_size(); i++)
-            for (unsigned int k = i; k < get_size(); k++)
-            {
-                T temp = m(i, k);
-                m(i, k) = m(k, i);
-                m(k, i) = temp;
-            }
-        return m;        
+        return swap(indices());
     }
 
-    inline void transpose()
+    /**
+     * Set transposed matrix of square matrix other than matrix4
+     */
+    template<std::size_t N = R>
+    inline constexpr typename std::enable_if<
+        N == C && N != 4, matrix<R, C, T> &>::type
+    transpose()
     {
         *this = get_transpose();
+        return *this;
     }
 
-    friend inline std::ostream &operator <<(std::ostream &lhs,
-                                            const matrix3<T> &rhs)
+    /**
+     * @return transposed matrix4, same as get_transpose(), matrix4 kept its
+     * const transpose()
+     */
+    template<std::size_t N = R>
+    inline constexpr typename std::enable_if<
+        N == 4 && C == 4, matrix<R, C, T> >::type
+    transpose() const
     {
-        lhs << "(";
-        for (unsigned int i = 0; i < rhs.get_size_square() - 1; i++)
-	    lhs << rhs[i] << ", ";
-        return lhs << rhs[rhs.get_size_square() - 1] << ")";
+        return get_transpose();
     }
-};
-
-template<class T>
-class matrix4
-{
-    typedef T type;
 
-    T a[16];
-
-public:
-    inline unsigned int get_size()
+    /**
+     * @return determinant
+     */
+    inline constexpr T get_determinant() const
     {
-        return 4;
+        static_assert(R == C && R >= 2 && R <= 4,
+                      "determinant needs 2x2, 3x3 or 4x4 matrix");
+        return determinant(std::integral_constant<std::size_t, R>());
     }
 
-    matrix4()
+    /**
+     * @return inversed matrix, computed from adjugate of 2x2 and 3x3 matrix
+     * and from 2x2 minors of upper and lower halves of 4x4 matrix, undefined
+     * for singular matrix
+     */
+    inline constexpr matrix<R, C, T> get_inverse() const
     {
-        set_identity();
+        static_assert(R == C && R >= 2 && R <= 4,
+                      "inverse needs 2x2, 3x3 or 4x4 matrix");
+        return inversed(std::integral_constant<std::size_t, R>());
     }
 
-    explicit matrix4(T n)
+    /**
+     * Set inversed matrix
+     */
+    inline constexpr matrix<R, C, T> &inverse()
     {
-        set(n);
+        *this = get_inverse();
+        return *this;
     }
 
-    matrix4(T a11, T a12, T a13, T a14,
-            T a21, T a22, T a23, T a24,
-            T a31, T a32, T a33, T a34,
-            T a41, T a42, T a43, T a44)
-    {
-        set(a11, a12, a13, a14,
-            a21, a22, a23, a24,
-            a31, a32, a33, a34,
-            a41, a42, a43, a44);
+    /**
+     * @return inversed affine matrix, last column must be (0, 0, 0, 1)
+     */
+    inline constexpr matrix<R, C, T> get_inverse_affine() const
+    {
+        static_assert(R == 4 && C == 4, "affine inverse needs 4x4 matrix");
+        T c00 = a[5] * a[10] - a[6] * a[9];
+        T c01 = a[2] * a[9] - a[1] * a[10];
+        T c02 = a[1] * a[6] - a[2] * a[5];
+        T c10 = a[6] * a[8] - a[4] * a[10];
+        T c11 = a[0] * a[10] - a[2] * a[8];
+        T c12 = a[2] * a[4] - a[0] * a[6];
+        T c20 = a[4] * a[9] - a[5] * a[8];
+        T c21 = a[1] * a[8] - a[0] * a[9];
+        T c22 = a[0] * a[5] - a[1] * a[4];
+        T m = T(1) / (a[0] * c00 + a[1] * c10 + a[2] * c20);
+        matrix<R, C, T> nm(c00 * m, c01 * m, c02 * m, T(0),
+                           c10 * m, c11 * m, c12 * m, T(0),
+                           c20 * m, c21 * m, c22 * m, T(0),
+                           T(0), T(0), T(0), T(1));
+        for (unsigned int k = 0; k < 3; k++)
+            nm(3, k) = -(a[12] * nm(0, k) + a[13] * nm(1, k) +
+                         a[14] * nm(2, k));
+        return nm;
     }
 
-    explicit matrix4(T *a)
+    /**
+     * Set inversed affine matrix
+     */
+    inline constexpr matrix<R, C, T> &inverse_affine()
     {
-        set(a);
+        *this = get_inverse_affine();
+        return *this;
     }
 
-    ~matrix4()
+    /**
+     * @return inversed rigid matrix, upper 3x3 part must be orthonormal and
+     * last column must be (0, 0, 0, 1)
+     */
+    inline constexpr matrix<R, C, T> get_inverse_rigid() const
     {
+        static_assert(R == 4 && C == 4, "rigid inverse needs 4x4 matrix");
+        return matrix<R, C, T>(a[0], a[4], a[8], T(0),
+                               a[1], a[5], a[9], T(0),
+                               a[2], a[6], a[10], T(0),
+                               -(a[12] * a[0] + a[13] * a[1] + a[14] * a[2]),
+                               -(a[12] * a[4] + a[13] * a[5] + a[14] * a[6]),
+                               -(a[12] * a[8] + a[13] * a[9] + a[14] * a[10]),
+                               T(1));
     }
 
-    inline T &operator [](unsigned int i)
+    /**
+     * Set inversed rigid matrix
+     */
+    inline constexpr matrix<R, C, T> &inverse_rigid()
     {
-        return a[i];
+        *this = get_inverse_rigid();
+        return *this;
     }
 
-    inline const T &operator [](unsigned int i) const
+    /**
+     * Transform n points, (x, y, z, 1) dropping w for 4x4 matrix,
+     * in and out may be equal
+     */
+    inline void transform_points(const vector3<T> *in, vector3<T> *out,
+                                 std::size_t n) const
     {
-        return a[i];
+        transform_points(reinterpret_cast<const T *>(in), sizeof(vector3<T>),
+                         reinterpret_cast<T *>(out), sizeof(vector3<T>), n);
     }
 
-    inline vector4<T> operator ()(unsigned int i) const
+    /**
+     * Transform n points (x, y, z) placed stride bytes apart, e.g.
+     * positions of interleaved vertex buffer, in and out may be equal
+     */
+    inline void transform_points(const T *in, std::size_t in_stride,
+                                 T *out, std::size_t out_stride,
+                                 std::size_t n) const
     {
-        return vector4<T> (a + i * get_size());
+        transform3(in, in_stride, out, out_stride, n, T(1));
     }
 
-    inline T &operator ()(unsigned int i, unsigned int k)
+    /**
+     * Transform n homogeneous points by 4x4 matrix, in and out may be equal
+     */
+    inline void transform_points(const vector4<T> *in, vector4<T> *out,
+                                 std::size_t n) const
     {
-        return a[i * get_size() + k];
+        static_assert(R == 4 && C == 4, "transform needs 4x4 matrix");
+        for (std::size_t i = 0; i < n; i++)
+            out[i] = in[i] * *this;
     }
 
-    inline const T &operator ()(unsigned int i, unsigned int k) const
+    /**
+     * Transform n directions, (x, y, z, 0) for 4x4 matrix, same as
+     * transform_points() for 3x3 matrix, in and out may be equal
+     */
+    inline void transform_directions(const vector3<T> *in, vector3<T> *out,
+                                     std::size_t n) const
     {
-        return a[i * get_size() + k];
+        transform_directions(reinterpret_cast<const T *>(in),
+                             sizeof(vector3<T>), reinterpret_cast<T *>(out),
+                             sizeof(vector3<T>), n);
     }
 
-    inline operator T *()
+    /**
+     * Transform n directions (x, y, z) placed stride bytes apart,
+     * in and out may be equal
+     */
+    inline void transform_directions(const T *in, std::size_t in_stride,
+                                     T *out, std::size_t out_stride,
+                                     std::size_t n) const
     {
-        return a;
+        transform3(in, in_stride, out, out_stride, n, T(0));
     }
 
-    inline operator const T *() const
+    /**
+     * Transform n directions by 4x4 matrix ignoring w, in and out may be
+     * equal
+     */
+    inline void transform_directions(const vector4<T> *in, vector4<T> *out,
+                                     std::size_t n) const
     {
-        return a;
+        static_assert(R == 4 && C == 4, "transform needs 4x4 matrix");
+        for (std::size_t i = 0; i < n; i++)
+            out[i] = vector4<T>(in[i].x, in[i].y, in[i].z, T(0)) * *this;
     }
 
-    inline T &get(unsigned int i)
+    friend inline std::ostream &operator <<(std::ostream &lhs,
+                                            const matrix<R, C, T> &rhs)
     {
-        return a[i];
+        lhs << "(";
+        for (unsigned int i = 0; i < R * C - 1; i++)
+            lhs << rhs[i] << ", ";
+        return lhs << rhs[R * C - 1] << ")";
     }
 
-    inline const T &get(unsigned int i) const
+private:
+    template<std::size_t... I>
+    constexpr matrix(identity_tag, std::index_sequence<I...>) :
+        a{(I / C == I % C ? T(1) : T(0))...}
     {
-        return a[i];
     }
 
-    inline T &get(unsigned int i, unsigned int k)
+    template<std::size_t... I>
+    constexpr matrix(fill_tag, T n, std::index_sequence<I...>) :
+        a{((void)I, n)...}
     {
-        return a[i * get_size() + k];
     }
 
-    inline const T &get(unsigned int i, unsigned int k) const
+    template<std::size_t... I>
+    constexpr matrix(array_tag, const T *p, std::index_sequence<I...>) :
+        a{p[I]...}
     {
-        return a[i * get_size() + k];
     }
 
-    inline matrix4<T> &set(T *a)
+    template<class... A>
+    constexpr matrix(elements_tag, A... e) :
+        a{e...}
     {
-        for (int i = 0; i < get_size() * get_size(); i++)
-            this->a[i] = a[i];
-        return *this;
     }
 
-    inline matrix4<T> &set(T a11, T a12, T a13, T a14,
-                           T a21, T a22, T a23, T a24,
-                           T a31, T a32, T a33, T a34,
-                           T a41, T a42, T a43, T a44)
+    template<std::size_t... I>
+    inline constexpr matrix<R, C, T> add(const matrix<R, C, T> &m,
+                                         std::index_sequence<I...>) const
     {
-        get(0, 0) = a11;
-        get(0, 1) = a12;
-        get(0, 2) = a13;
-        get(0, 3) = a14;
-        get(1, 0) = a21;
-        get(1, 1) = a22;
-        get(1, 2) = a23;
-        get(1, 3) = a24;
-        get(2, 0) = a31;
-        get(2, 1) = a32;
-        get(2, 2) = a33;
-        get(2, 3) = a34;
-        get(3, 0) = a41;
-        get(3, 1) = a42;
-        get(3, 2) = a43;
-        get(3, 3) = a44;
+        return matrix<R, C, T>(elements_tag(), T(a[I] + m.a[I])...);
     }
 
-    inline matrix4<T> &set(T n)
+    template<std::size_t... I>
+    inline constexpr matrix<R, C, T> scale(T n,
+                                           std::index_sequence<I...>) const
     {
-        for (int i = 0; i < get_size() * get_size(); i++)
-            a[i] = n;
+        return matrix<R, C, T>(elements_tag(), T(a[I] * n)...);
     }
 
-    inline matrix4<T> &set_identity()
+    template<std::size_t... I>
+    inline constexpr matrix<C, R, T> swap(std::index_sequence<I...>) const
     {
-        for (int i = 0; i < get_size(); i++)
-            for (int k = 0; k < get_size(); k++)
-                if (i == k)
-                    get(i, k) = T(1);
-                else
-                    get(i, k) = T(0);
+        return matrix<C, R, T>(typename matrix<C, R, T>::elements_tag(),
+                               a[I % R * C + I / R]...);
     }
 
-    inline matrix4<T> &operator +=(const matrix4<T> &m)
+    template<std::size_t K, std::size_t... I>
+    inline constexpr matrix<R, K, T> multiply(const matrix<C, K, T> &m,
+                                              std::index_sequence<I...>) const
     {
-        for (int i = 0; i < get_size() * get_size(); i++)
-            a[i] += m[i];
-        return *this;
+        return matrix<R, K, T>(
+            product<I / K, I % K>(m, std::make_index_sequence<C>())...);
     }
 
-    inline matrix4<T> operator +(const matrix4<T> &m) const
+    template<std::size_t I, std::size_t K, class M, std::size_t... J>
+    inline constexpr T product(const M &m, std::index_sequence<J...>) const
     {
-        matrix4<T> nm;
-        for (int i = 0; i < get_size() * get_size(); i++)
-            nm[i] = a[i] + m[i];
-        return nm;
+        return unrolled_sum(T(a[I * C + J] * m(J, K))...);
     }
 
-    inline matrix4<T> &operator *=(T n)
+    template<std::size_t... K>
+    inline constexpr vector<C, T> transform(const vector<R, T> &v,
+                                            std::index_sequence<K...>) const
     {
-        for (int i = 0; i < get_size() * get_size(); i++)
-            a[i] *= n;
-        return *this;
+        return vector<C, T>(column<K>(v, std::make_index_sequence<R>())...);
     }
 
-    inline matrix4<T> &operator *=(const matrix4<T> &m)
+    template<std::size_t K, std::size_t... J>
+    inline constexpr T column(const vector<R, T> &v,
+                              std::index_sequence<J...>) const
     {
-        matrix4<T> temp(*this);
-        for (int i = 0; i < get_size(); i++)
-            for (int k = 0; i < get_size(); i++)
-                for (int r = 0; r < get_size(); r++)
-                    get(i, k) = temp(i, r) * m(r, k);
-        return *this;
+        return unrolled_sum(T(math::get<J>(v) * a[J * C + K])...);
     }
 
-    inline matrix4<T> &operator *=(const vector4<T> &v)
+    template<std::size_t... I>
+    inline constexpr matrix<R, C, T> scale_rows(
+        const vector<R, T> &v, std::index_sequence<I...>) const
     {
-        matrix4<T> temp(*this);
-        set(T(0));
-        for (int i = 0; i < get_size(); i++)
-            for (int k = 0; k < get_size(); k++)
-                for (int r = 0; r < get_size(); r++)
-                    get(i, k) += temp(i, r) * v[i];
-        return *this;
+        return matrix<R, C, T>(elements_tag(),
+                               row_sum<I / C>(v, std::make_index_sequence<C>())...);
     }
 
-    friend inline vector4<T> &operator *=(const vector4<T> &v,
-            const matrix4<T> &m)
+    template<std::size_t I, std::size_t... K>
+    inline constexpr T row_sum(const vector<R, T> &v,
+                               std::index_sequence<K...>) const
     {
-        vector4<T> temp(v);
-        v.set(T(0));
-        for (int i = 0; i < get_size(); i++)
-            for (int r = 0; r < get_size(); r++)
-                v[i] += temp[r] * m(r, i);
-        return v;
+        return unrolled_sum(T(a[I * C + K] * math::get<I>(v))...);
     }
 
-    inline matrix4<T> operator *(const matrix4<T> &m) const
+    inline constexpr T determinant(std::integral_constant<std::size_t, 2>) const
     {
-        matrix4<T> nm;
-        for (int i = 0; i < get_size(); i++)
-            for (int k = 0; i < get_size(); i++)
-                for (int r = 0; r < get_size(); r++)
-                    nm(i, k) += get(i, r) * m(r, k);
-        return nm;
+        return a[0] * a[3] - a[1] * a[2];
     }
 
-    inline matrix4<T> operator *(const vector4<T> &v) const
+    inline constexpr T determinant(std::integral_constant<std::size_t, 3>) const
     {
-        matrix4<T> nm;
-        for (int i = 0; i < get_size(); i++)
-            for (int k = 0; k < get_size(); k++)
-                for (int r = 0; r < get_size(); r++)
-                    nm(i, k) += get(i, r) * v[i];
-        return nm;
+        return a[0] * (a[4] * a[8] - a[5] * a[7]) -
+               a[1] * (a[3] * a[8] - a[5] * a[6]) +
+               a[2] * (a[3] * a[7] - a[4] * a[6]);
     }
 
-    friend inline vector4<T> operator *(const vector4<T> &v,
-            const matrix4<T> &m)
+    inline constexpr T determinant(std::integral_constant<std::size_t, 4>) const
     {
-        vector4<T> nv;
-        for (int i = 0; i < get_size(); i++)
-            for (int r = 0; r < get_size(); r++)
-                nv[i] += v[r] * m(r, i);
-        return nv;
+        T s0 = a[0] * a[5] - a[4] * a[1];
+        T s1 = a[0] * a[6] - a[4] * a[2];
+        T s2 = a[0] * a[7] - a[4] * a[3];
+        T s3 = a[1] * a[6] - a[5] * a[2];
+        T s4 = a[1] * a[7] - a[5] * a[3];
+        T s5 = a[2] * a[7] - a[6] * a[3];
+        T c5 = a[10] * a[15] - a[14] * a[11];
+        T c4 = a[9] * a[15] - a[13] * a[11];
+        T c3 = a[9] * a[14] - a[13] * a[10];
+        T c2 = a[8] * a[15] - a[12] * a[11];
+        T c1 = a[8] * a[14] - a[12] * a[10];
+        T c0 = a[8] * a[13] - a[12] * a[9];
+        return s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
     }
 
-    inline bool operator ==(const matrix4<T> &m) const
+    inline constexpr matrix<R, C, T> inversed(
+        std::integral_constant<std::size_t, 2>) const
     {
-        for (int i = 0; i < get_size() * get_size(); i++)
-            if (a[i] != m[i])
-                return false;
-        return true;
+        T m = T(1) / (a[0] * a[3] - a[1] * a[2]);
+        return matrix<R, C, T>(a[3] * m, -a[1] * m, -a[2] * m, a[0] * m);
     }
 
-    inline bool operator !=(const matrix4<T> &m) const
+    inline constexpr matrix<R, C, T> inversed(
+        std::integral_constant<std::size_t, 3>) const
     {
-        return !operator ==(m);
+        T c00 = a[4] * a[8] - a[5] * a[7];
+        T c10 = a[5] * a[6] - a[3] * a[8];
+        T c20 = a[3] * a[7] - a[4] * a[6];
+        T m = T(1) / (a[0] * c00 + a[1] * c10 + a[2] * c20);
+        return matrix<R, C, T>(c00 * m, (a[2] * a[7] - a[1] * a[8]) * m,
+                               (a[1] * a[5] - a[2] * a[4]) * m,
+                               c10 * m, (a[0] * a[8] - a[2] * a[6]) * m,
+                               (a[2] * a[3] - a[0] * a[5]) * m,
+                               c20 * m, (a[1] * a[6] - a[0] * a[7]) * m,
+                               (a[0] * a[4] - a[1] * a[3]) * m);
     }
 
-    inline matrix4<T> transpose() const
+    inline constexpr matrix<R, C, T> inversed(
+        std::integral_constant<std::size_t, 4>) const
     {
-        matrix4<T> m(*this);
-        for (int i = 0; i < get_size(); i++)
-            for (int k = 0; k < get_size(); k++)
+        T s0 = a[0] * a[5] - a[4] * a[1];
+        T s1 = a[0] * a[6] - a[4] * a[2];
+        T s2 = a[0] * a[7] - a[4] * a[3];
+        T s3 = a[1] * a[6] - a[5] * a[2];
+        T s4 = a[1] * a[7] - a[5] * a[3];
+        T s5 = a[2] * a[7] - a[6] * a[3];
+        T c5 = a[10] * a[15] - a[14] * a[11];
+        T c4 = a[9] * a[15] - a[13] * a[11];
+        T c3 = a[9] * a[14] - a[13] * a[10];
+        T c2 = a[8] * a[15] - a[12] * a[11];
+        T c1 = a[8] * a[14] - a[12] * a[10];
+        T c0 = a[8] * a[13] - a[12] * a[9];
+        T m = T(1) / (s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 +
+                      s5 * c0);
+        return matrix<R, C, T>(
+            ( a[5] * c5 - a[6] * c4 + a[7] * c3) * m,
+            (-a[1] * c5 + a[2] * c4 - a[3] * c3) * m,
+            ( a[13] * s5 - a[14] * s4 + a[15] * s3) * m,
+            (-a[9] * s5 + a[10] * s4 - a[11] * s3) * m,
+            (-a[4] * c5 + a[6] * c2 - a[7] * c1) * m,
+            ( a[0] * c5 - a[2] * c2 + a[3] * c1) * m,
+            (-a[12] * s5 + a[14] * s2 - a[15] * s1) * m,
+            ( a[8] * s5 - a[10] * s2 + a[11] * s1) * m,
+            ( a[4] * c4 - a[5] * c2 + a[7] * c0) * m,
+            (-a[0] * c4 + a[1] * c2 - a[3] * c0) * m,
+            ( a[12] * s4 - a[13] * s2 + a[15] * s0) * m,
+            (-a[8] * s4 + a[9] * s2 - a[11] * s0) * m,
+            (-a[4] * c3 + a[5] * c1 - a[6] * c0) * m,
+            ( a[0] * c3 - a[1] * c1 + a[2] * c0) * m,
+            (-a[12] * s3 + a[13] * s1 - a[14] * s0) * m,
+            ( a[8] * s3 - a[9] * s1 + a[10] * s0) * m);
+    }
+
+    /**
+     * Transform (x, y, z) by upper 3x3 part, plus w times last row of 4x4
+     * matrix
+     */
+    inline void transform3(const T *in, std::size_t in_stride,
+                           T *out, std::size_t out_stride,
+                           std::size_t n, T w) const
+    {
+        static_assert(R == C && (R == 3 || R == 4),
+                      "transform needs 3x3 or 4x4 matrix");
+        const T m00 = a[0], m01 = a[1], m02 = a[2];
+        const T m10 = a[C], m11 = a[C + 1], m12 = a[C + 2];
+        const T m20 = a[2 * C], m21 = a[2 * C + 1], m22 = a[2 * C + 2];
+        const T *t = a + (R - 1) * C;
+        const T m30 = t[0] * w, m31 = t[1] * w, m32 = t[2] * w;
+        const char *src = reinterpret_cast<const char *>(in);
+        char *dst = reinterpret_cast<char *>(out);
+        for (std::size_t i = 0; i < n; i++)
+        {
+            const T *p = reinterpret_cast<const T *>(src + i * in_stride);
+            T *q = reinterpret_cast<T *>(dst + i * out_stride);
+            T x = p[0], y = p[1], z = p[2];
+            if (R == 4)
+            {
+                q[0] = x * m00 + y * m10 + z * m20 + m30;
+                q[1] = x * m01 + y * m11 + z * m21 + m31;
+                q[2] = x * m02 + y * m12 + z * m22 + m32;
+            }
+            else
             {
-                T temp = m(i, k);
-                m(i, k) = m(k, i);
-                m(k, i) = temp;
+                q[0] = x * m00 + y * m10 + z * m20;
+                q[1] = x * m01 + y * m11 + z * m21;
+                q[2] = x * m02 + y * m12 + z * m22;
             }
-        return m;
+        }
     }
-
 };
 
+/**
+ * Solve n systems x * m[i] = b[i] for row vector x by Cramer's rule, so
+ * solve(m, x * m) gives back x. Systems are processed in blocks laid out
+ * across lanes so that the arithmetic vectorizes over systems, out may be
+ * equal to b.
+ */
+template<class T>
+inline void solve(const matrix3<T> *m, const vector3<T> *b, vector3<T> *out,
+                  std::size_t n)
+{
+    const std::size_t lanes = 8;
+    for (std::size_t s = 0; s < n; s += lanes)
+    {
+        std::size_t count = n - s < lanes ? n - s : lanes;
+        T a[9][lanes], v[3][lanes], r[3][lanes];
+        for (std::size_t l = 0; l < lanes; l++)
+        {
+            const matrix3<T> &ml = m[s + (l < count ? l : 0)];
+            const vector3<T> &bl = b[s + (l < count ? l : 0)];
+            // x * m = b is transpose(m) * x = b for column vector x
+            for (unsigned int i = 0; i < 9; i++)
+                a[i][l] = ml[i % 3 * 3 + i / 3];
+            for (unsigned int i = 0; i < 3; i++)
+                v[i][l] = bl[i];
+        }
+        for (std::size_t l = 0; l < lanes; l++)
+        {
+            T c00 = a[4][l] * a[8][l] - a[5][l] * a[7][l];
+            T c10 = a[5][l] * a[6][l] - a[3][l] * a[8][l];
+            T c20 = a[3][l] * a[7][l] - a[4][l] * a[6][l];
+            T c01 = a[2][l] * a[7][l] - a[1][l] * a[8][l];
+            T c11 = a[0][l] * a[8][l] - a[2][l] * a[6][l];
+            T c21 = a[1][l] * a[6][l] - a[0][l] * a[7][l];
+            T c02 = a[1][l] * a[5][l] - a[2][l] * a[4][l];
+            T c12 = a[2][l] * a[3][l] - a[0][l] * a[5][l];
+            T c22 = a[0][l] * a[4][l] - a[1][l] * a[3][l];
+            T d = T(1) / (a[0][l] * c00 + a[1][l] * c10 + a[2][l] * c20);
+            r[0][l] = (c00 * v[0][l] + c01 * v[1][l] + c02 * v[2][l]) * d;
+            r[1][l] = (c10 * v[0][l] + c11 * v[1][l] + c12 * v[2][l]) * d;
+            r[2][l] = (c20 * v[0][l] + c21 * v[1][l] + c22 * v[2][l]) * d;
+        }
+        for (std::size_t l = 0; l < count; l++)
+            out[s + l].set(r[0][l], r[1][l], r[2][l]);
+    }
 }
 
+/**
+ * Solve n systems x * m[i] = b[i] for row vector x by LU decomposition of
+ * transposed m[i] with partial pivoting. Pivot rows are exchanged by
+ * branch-free selects, so systems are processed in vectorizable blocks
+ * the same way as the 3x3 solve, out may be equal to b.
+ */
+template<class T>
+inline void solve(const matrix4<T> *m, const vector4<T> *b, vector4<T> *out,
+                  std::size_t n)
+{
+    const std::size_t lanes = 8;
+    for (std::size_t s = 0; s < n; s += lanes)
+    {
+        std::size_t count = n - s < lanes ? n - s : lanes;
+        T a[4][4][lanes], v[4][lanes];
+        for (std::size_t l = 0; l < lanes; l++)
+        {
+            const matrix4<T> &ml = m[s + (l < count ? l : 0)];
+            const vector4<T> &bl = b[s + (l < count ? l : 0)];
+            for (unsigned int i = 0; i < 4; i++)
+            {
+                for (unsigned int k = 0; k < 4; k++)
+                    a[i][k][l] = ml(k, i);
+                v[i][l] = bl[i];
+            }
+        }
+        for (unsigned int k = 0; k < 4; k++)
+        {
+            for (unsigned int i = k + 1; i < 4; i++)
+                for (std::size_t l = 0; l < lanes; l++)
+                {
+                    T p = a[k][k][l], q = a[i][k][l];
+                    bool swap = (q < T(0) ? -q : q) > (p < T(0) ? -p : p);
+                    for (unsigned int c = k; c < 4; c++)
+                    {
+                        T x = a[k][c][l], y = a[i][c][l];
+                        a[k][c][l] = swap ? y : x;
+                        a[i][c][l] = swap ? x : y;
+                    }
+                    T x = v[k][l], y = v[i][l];
+                    v[k][l] = swap ? y : x;
+                    v[i][l] = swap ? x : y;
+                }
+            for (unsigned int i = k + 1; i < 4; i++)
+                for (std::size_t l = 0; l < lanes; l++)
+                {
+                    T f = a[i][k][l] / a[k][k][l];
+                    for (unsigned int c = k + 1; c < 4; c++)
+                        a[i][c][l] -= f * a[k][c][l];
+                    v[i][l] -= f * v[k][l];
+                }
+        }
+        for (int i = 3; i >= 0; i--)
+            for (std::size_t l = 0; l < lanes; l++)
+            {
+                T x = v[i][l];
+                for (unsigned int c = i + 1; c < 4; c++)
+                    x -= a[i][c][l] * v[c][l];
+                v[i][l] = x / a[i][i][l];
+            }
+        for (std::size_t l = 0; l < count; l++)
+            out[s + l].set(v[0][l], v[1][l], v[2][l], v[3][l]);
+    }
+}
+
+static_assert(std::is_trivially_copyable<matrix3<double> >::value &&
+              std::is_trivially_copyable<matrix4<double> >::value,
+              "matrices must be trivially copyable");
+}
+
+#include "matrix_sse.hpp"
+
 #endif
@@ -0,0 +1,681 @@
+#ifndef _MATH_MATRIX_SSE_
+#define _MATH_MATRIX_SSE_
+
+#include <iostream>
+#include <cstddef>
+
+#include "simd.hpp"
+#include "matrix.hpp"
+
+#ifdef MATH_SSE2
+
+namespace math
+{
+/**
+ * 4x4 matrix class, SSE specialization
+ *
+ * Rows are kept 16-byte aligned so that every row is a single register load.
+ * Construction and element access are constexpr, arithmetic runs on
+ * registers at run time.
+ */
+template<>
+class alignas(16) matrix<4, 4, float>
+{
+    typedef float type;
+
+    float a[16];
+
+public:
+    inline constexpr unsigned int get_size() const
+    {
+        return 4;
+    }
+
+    inline constexpr unsigned int get_size_square() const
+    {
+        return 16;
+    }
+
+    inline constexpr unsigned int get_rows() const
+    {
+        return 4;
+    }
+
+    inline constexpr unsigned int get_columns() const
+    {
+        return 4;
+    }
+
+    constexpr matrix() :
+        a{1.0f, 0.0f, 0.0f, 0.0f,
+          0.0f, 1.0f, 0.0f, 0.0f,
+          0.0f, 0.0f, 1.0f, 0.0f,
+          0.0f, 0.0f, 0.0f, 1.0f}
+    {
+    }
+
+    explicit constexpr matrix(float n) :
+        a{n, n, n, n,
+          n, n, n, n,
+          n, n, n, n,
+          n, n, n, n}
+    {
+    }
+
+    constexpr matrix(float a11, float a12, float a13, float a14,
+                      float a21, float a22, float a23, float a24,
+                      float a31, float a32, float a33, float a34,
+                      float a41, float a42, float a43, float a44) :
+        a{a11, a12, a13, a14,
+          a21, a22, a23, a24,
+          a31, a32, a33, a34,
+          a41, a42, a43, a44}
+    {
+    }
+
+    explicit matrix(const float *p)
+    {
+        set(p);
+    }
+
+    inline constexpr float &operator [](unsigned int i)
+    {
+        return a[i];
+    }
+
+    inline constexpr const float &operator [](unsigned int i) const
+    {
+        return a[i];
+    }
+
+    inline vector4<float> operator ()(unsigned int i) const
+    {
+        return vector4<float>(get_row(i));
+    }
+
+    inline constexpr float &operator ()(unsigned int i, unsigned int k)
+    {
+        return a[i * 4 + k];
+    }
+
+    inline constexpr const float &operator ()(unsigned int i, unsigned int k) const
+    {
+        return a[i * 4 + k];
+    }
+
+    inline operator float *()
+    {
+        return a;
+    }
+
+    inline operator const float *() const
+    {
+        return a;
+    }
+
+    inline constexpr float &get(unsigned int i)
+    {
+        return a[i];
+    }
+
+    inline constexpr const float &get(unsigned int i) const
+    {
+        return a[i];
+    }
+
+    inline constexpr float &get(unsigned int i, unsigned int k)
+    {
+        return a[i * 4 + k];
+    }
+
+    inline constexpr const float &get(unsigned int i, unsigned int k) const
+    {
+        return a[i * 4 + k];
+    }
+
+    /**
+     * @return i row loaded into register
+     */
+    inline __m128 get_row(unsigned int i) const
+    {
+        return _mm_load_ps(a + i * 4);
+    }
+
+    /**
+     * Set i row from register
+     */
+    inline matrix4<float> &set_row(unsigned int i, __m128 m)
+    {
+        _mm_store_ps(a + i * 4, m);
+        return *this;
+    }
+
+    inline matrix4<float> &set(const float *p)
+    {
+        for (unsigned int i = 0; i < 4; i++)
+            set_row(i, _mm_loadu_ps(p + i * 4));
+        return *this;
+    }
+
+    inline matrix4<float> &set(float a11, float a12, float a13, float a14,
+                               float a21, float a22, float a23, float a24,
+                               float a31, float a32, float a33, float a34,
+                               float a41, float a42, float a43, float a44)
+    {
+        set_row(0, _mm_setr_ps(a11, a12, a13, a14));
+        set_row(1, _mm_setr_ps(a21, a22, a23, a24));
+        set_row(2, _mm_setr_ps(a31, a32, a33, a34));
+        set_row(3, _mm_setr_ps(a41, a42, a43, a44));
+        return *this;
+    }
+
+    inline matrix4<float> &set(float n)
+    {
+        __m128 m = _mm_set1_ps(n);
+        for (unsigned int i = 0; i < 4; i++)
+            set_row(i, m);
+        return *this;
+    }
+
+    inline matrix4<float> &set_identity()
+    {
+        set_row(0, _mm_setr_ps(1.0f, 0.0f, 0.0f, 0.0f));
+        set_row(1, _mm_setr_ps(0.0f, 1.0f, 0.0f, 0.0f));
+        set_row(2, _mm_setr_ps(0.0f, 0.0f, 1.0f, 0.0f));
+        set_row(3, _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f));
+        return *this;
+    }
+
+    inline matrix4<float> &operator +=(const matrix4<float> &m)
+    {
+        for (unsigned int i = 0; i < 4; i++)
+            set_row(i, _mm_add_ps(get_row(i), m.get_row(i)));
+        return *this;
+    }
+
+    inline matrix4<float> operator +(const matrix4<float> &m) const
+    {
+        matrix4<float> nm(*this);
+        return nm += m;
+    }
+
+    inline matrix4<float> &operator *=(float n)
+    {
+        __m128 s = _mm_set1_ps(n);
+        for (unsigned int i = 0; i < 4; i++)
+            set_row(i, _mm_mul_ps(get_row(i), s));
+        return *this;
+    }
+
+    inline matrix4<float> &operator *=(const matrix4<float> &m)
+    {
+        multiply(*this, m, *this);
+        return *this;
+    }
+
+    inline matrix4<float> &operator *=(const vector4<float> &v)
+    {
+        *this = operator *(v);
+        return *this;
+    }
+
+    friend inline vector4<float> &operator *=(vector4<float> &v,
+            const matrix4<float> &m)
+    {
+        return v.set_simd(m.transform(v.get_simd()));
+    }
+
+    inline matrix4<float> operator *(const matrix4<float> &m) const
+    {
+        matrix4<float> nm(0.0f);
+        multiply(*this, m, nm);
+        return nm;
+    }
+
+    /**
+     * @return product of 4x4 and 4 x K matrices
+     */
+    template<std::size_t K>
+    inline matrix<4, K, float> operator *(const matrix<4, K, float> &m) const
+    {
+        matrix<4, K, float> nm(0.0f);
+        for (unsigned int i = 0; i < 4; i++)
+            for (unsigned int k = 0; k < K; k++)
+                for (unsigned int r = 0; r < 4; r++)
+                    nm(i, k) += get(i, r) * m(r, k);
+        return nm;
+    }
+
+    inline matrix4<float> operator *(const vector4<float> &v) const
+    {
+        matrix4<float> nm(0.0f);
+        for (unsigned int i = 0; i < 4; i++)
+        {
+            __m128 s = vector4<float>::dot_simd(get_row(i), _mm_set1_ps(1.0f));
+            nm.set_row(i, _mm_mul_ps(s, _mm_set1_ps(v[i])));
+        }
+        return nm;
+    }
+
+    friend inline vector4<float> operator *(const vector4<float> &v,
+            const matrix4<float> &m)
+    {
+        return vector4<float>(m.transform(v.get_simd()));
+    }
+
+    inline bool operator ==(const matrix4<float> &m) const
+    {
+        __m128 r = _mm_cmpeq_ps(get_row(0), m.get_row(0));
+        for (unsigned int i = 1; i < 4; i++)
+            r = _mm_and_ps(r, _mm_cmpeq_ps(get_row(i), m.get_row(i)));
+        return _mm_movemask_ps(r) == 0xf;
+    }
+
+    inline bool operator !=(const matrix4<float> &m) const
+    {
+        return !operator ==(m);
+    }
+
+    inline matrix4<float> get_transpose() const
+    {
+        __m128 r0 = get_row(0), r1 = get_row(1);
+        __m128 r2 = get_row(2), r3 = get_row(3);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        matrix4<float> m;
+        m.set_row(0, r0);
+        m.set_row(1, r1);
+        m.set_row(2, r2);
+        m.set_row(3, r3);
+        return m;
+    }
+
+    /**
+     * @return transposed matrix, same as get_transpose()
+     */
+    inline matrix4<float> transpose() const
+    {
+        return get_transpose();
+    }
+
+    /**
+     * @return determinant
+     */
+    inline float get_determinant() const
+    {
+        __m128 det_sub, ab, dc;
+        return _mm_cvtss_f32(determinant(det_sub, ab, dc));
+    }
+
+    /**
+     * @return inversed matrix, computed blockwise from 2x2 submatrices,
+     * undefined for singular matrix
+     */
+    inline matrix4<float> get_inverse() const
+    {
+        __m128 r0 = get_row(0), r1 = get_row(1);
+        __m128 r2 = get_row(2), r3 = get_row(3);
+        __m128 ma = _mm_movelh_ps(r0, r1);
+        __m128 mb = _mm_movehl_ps(r1, r0);
+        __m128 mc = _mm_movelh_ps(r2, r3);
+        __m128 md = _mm_movehl_ps(r3, r2);
+        __m128 det_sub, ab, dc;
+        __m128 det = determinant(det_sub, ab, dc);
+        __m128 det_a = swizzle<0, 0, 0, 0>(det_sub);
+        __m128 det_b = swizzle<1, 1, 1, 1>(det_sub);
+        __m128 det_c = swizzle<2, 2, 2, 2>(det_sub);
+        __m128 det_d = swizzle<3, 3, 3, 3>(det_sub);
+
+        __m128 x = _mm_sub_ps(_mm_mul_ps(det_d, ma), mul2(mb, dc));
+        __m128 w = _mm_sub_ps(_mm_mul_ps(det_a, md), mul2(mc, ab));
+        __m128 y = _mm_sub_ps(_mm_mul_ps(det_b, mc), mul2_adj(md, ab));
+        __m128 z = _mm_sub_ps(_mm_mul_ps(det_c, mb), mul2_adj(ma, dc));
+
+        __m128 m = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), det);
+        x = _mm_mul_ps(x, m);
+        y = _mm_mul_ps(y, m);
+        z = _mm_mul_ps(z, m);
+        w = _mm_mul_ps(w, m);
+
+        matrix4<float> nm;
+        nm.set_row(0, _mm_shuffle_ps(x, y, _MM_SHUFFLE(1, 3, 1, 3)));
+        nm.set_row(1, _mm_shuffle_ps(x, y, _MM_SHUFFLE(0, 2, 0, 2)));
+        nm.set_row(2, _mm_shuffle_ps(z, w, _MM_SHUFFLE(1, 3, 1, 3)));
+        nm.set_row(3, _mm_shuffle_ps(z, w, _MM_SHUFFLE(0, 2, 0, 2)));
+        return nm;
+    }
+
+    /**
+     * Set inversed matrix
+     */
+    inline matrix4<float> &inverse()
+    {
+        *this = get_inverse();
+        return *this;
+    }
+
+    /**
+     * @return inversed affine matrix, last column must be (0, 0, 0, 1)
+     */
+    inline matrix4<float> get_inverse_affine() const
+    {
+        __m128 r0 = get_row(0), r1 = get_row(1), r2 = get_row(2);
+        __m128 c0 = cross3(r1, r2);
+        __m128 c1 = cross3(r2, r0);
+        __m128 c2 = cross3(r0, r1);
+        __m128 m = _mm_div_ps(_mm_set1_ps(1.0f), vector4<float>::dot_simd(
+            _mm_and_ps(r0, xyz_mask()), c0));
+        c0 = _mm_mul_ps(c0, m);
+        c1 = _mm_mul_ps(c1, m);
+        c2 = _mm_mul_ps(c2, m);
+        __m128 c3 = _mm_setzero_ps();
+        _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+        return affine(c0, c1, c2);
+    }
+
+    /**
+     * Set inversed affine matrix
+     */
+    inline matrix4<float> &inverse_affine()
+    {
+        *this = get_inverse_affine();
+        return *this;
+    }
+
+    /**
+     * @return inversed rigid matrix, upper 3x3 part must be orthonormal and
+     * last column must be (0, 0, 0, 1)
+     */
+    inline matrix4<float> get_inverse_rigid() const
+    {
+        __m128 mask = xyz_mask();
+        __m128 c0 = _mm_and_ps(get_row(0), mask);
+        __m128 c1 = _mm_and_ps(get_row(1), mask);
+        __m128 c2 = _mm_and_ps(get_row(2), mask);
+        __m128 c3 = _mm_setzero_ps();
+        _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+        return affine(c0, c1, c2);
+    }
+
+    /**
+     * Set inversed rigid matrix
+     */
+    inline matrix4<float> &inverse_rigid()
+    {
+        *this = get_inverse_rigid();
+        return *this;
+    }
+
+    /**
+     * Transform n points (x, y, z, 1) dropping w, in and out may be equal
+     */
+    inline void transform_points(const vector3<float> *in,
+                                 vector3<float> *out, std::size_t n) const
+    {
+        transform_points(reinterpret_cast<const float *>(in),
+                         sizeof(vector3<float>),
+                         reinterpret_cast<float *>(out),
+                         sizeof(vector3<float>), n);
+    }
+
+    /**
+     * Transform n points (x, y, z, 1) placed stride bytes apart, e.g.
+     * positions of interleaved vertex buffer, in and out may be equal
+     */
+    inline void transform_points(const float *in, std::size_t in_stride,
+                                 float *out, std::size_t out_stride,
+                                 std::size_t n) const
+    {
+        transform3(in, in_stride, out, out_stride, n, get_row(3));
+    }
+
+    /**
+     * Transform n homogeneous points, in and out may be equal
+     */
+    inline void transform_points(const vector4<float> *in,
+                                 vector4<float> *out, std::size_t n) const
+    {
+        __m128 r0 = get_row(0), r1 = get_row(1);
+        __m128 r2 = get_row(2), r3 = get_row(3);
+        for (std::size_t i = 0; i < n; i++)
+        {
+            __m128 v = in[i].get_simd();
+            __m128 r = _mm_add_ps(
+                _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)), r0),
+                _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)), r1));
+            r = _mm_add_ps(r, _mm_add_ps(
+                _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2)), r2),
+                _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)), r3)));
+            out[i].set_simd(r);
+        }
+    }
+
+    /**
+     * Transform n directions (x, y, z, 0), in and out may be equal
+     */
+    inline void transform_directions(const vector3<float> *in,
+                                     vector3<float> *out, std::size_t n) const
+    {
+        transform_directions(reinterpret_cast<const float *>(in),
+                             sizeof(vector3<float>),
+                             reinterpret_cast<float *>(out),
+                             sizeof(vector3<float>), n);
+    }
+
+    /**
+     * Transform n directions (x, y, z, 0) placed stride bytes apart,
+     * in and out may be equal
+     */
+    inline void transform_directions(const float *in, std::size_t in_stride,
+                                     float *out, std::size_t out_stride,
+                                     std::size_t n) const
+    {
+        transform3(in, in_stride, out, out_stride, n, _mm_setzero_ps());
+    }
+
+    /**
+     * Transform n directions ignoring w, in and out may be equal
+     */
+    inline void transform_directions(const vector4<float> *in,
+                                     vector4<float> *out, std::size_t n) const
+    {
+        __m128 r0 = get_row(0), r1 = get_row(1), r2 = get_row(2);
+        for (std::size_t i = 0; i < n; i++)
+        {
+            __m128 v = in[i].get_simd();
+            __m128 r = _mm_add_ps(
+                _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)), r0),
+                _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)), r1));
+            r = _mm_add_ps(r,
+                _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2)), r2));
+            out[i].set_simd(r);
+        }
+    }
+
+    /**
+     * @return row vector v multiplied by matrix
+     */
+    inline __m128 transform(__m128 v) const
+    {
+        __m128 r = _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)),
+                              get_row(0));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)),
+                                     get_row(1)));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2)),
+                                     get_row(2)));
+        return _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)),
+                                        get_row(3)));
+    }
+
+    /**
+     * Compute lhs * rhs into result, which may alias either operand
+     */
+    static inline void multiply(const matrix4<float> &lhs,
+                                const matrix4<float> &rhs,
+                                matrix4<float> &result)
+    {
+#ifdef MATH_AVX
+        __m256 b0 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(rhs.a));
+        __m256 b1 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(rhs.a + 4));
+        __m256 b2 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(rhs.a + 8));
+        __m256 b3 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(rhs.a + 12));
+        __m256 l01 = _mm256_loadu_ps(lhs.a);
+        __m256 l23 = _mm256_loadu_ps(lhs.a + 8);
+
+        __m256 r01 = _mm256_mul_ps(_mm256_shuffle_ps(l01, l01, 0x00), b0);
+        r01 = _mm256_add_ps(r01, _mm256_mul_ps(_mm256_shuffle_ps(l01, l01, 0x55), b1));
+        r01 = _mm256_add_ps(r01, _mm256_mul_ps(_mm256_shuffle_ps(l01, l01, 0xaa), b2));
+        r01 = _mm256_add_ps(r01, _mm256_mul_ps(_mm256_shuffle_ps(l01, l01, 0xff), b3));
+
+        __m256 r23 = _mm256_mul_ps(_mm256_shuffle_ps(l23, l23, 0x00), b0);
+        r23 = _mm256_add_ps(r23, _mm256_mul_ps(_mm256_shuffle_ps(l23, l23, 0x55), b1));
+        r23 = _mm256_add_ps(r23, _mm256_mul_ps(_mm256_shuffle_ps(l23, l23, 0xaa), b2));
+        r23 = _mm256_add_ps(r23, _mm256_mul_ps(_mm256_shuffle_ps(l23, l23, 0xff), b3));
+
+        _mm256_storeu_ps(result.a, r01);
+        _mm256_storeu_ps(result.a + 8, r23);
+#else
+        __m128 r0 = rhs.transform(lhs.get_row(0));
+        __m128 r1 = rhs.transform(lhs.get_row(1));
+        __m128 r2 = rhs.transform(lhs.get_row(2));
+        __m128 r3 = rhs.transform(lhs.get_row(3));
+        result.set_row(0, r0);
+        result.set_row(1, r1);
+        result.set_row(2, r2);
+        result.set_row(3, r3);
+#endif
+    }
+
+    friend inline std::ostream &operator <<(std::ostream &lhs,
+                                            const matrix<4, 4, float> &rhs)
+    {
+        lhs << "(";
+        for (unsigned int i = 0; i < 15; i++)
+            lhs << rhs.a[i] << ", ";
+        return lhs << rhs.a[15] << ")";
+    }
+
+private:
+    template<int X, int Y, int Z, int W>
+    static inline __m128 swizzle(__m128 v)
+    {
+        return _mm_shuffle_ps(v, v, _MM_SHUFFLE(W, Z, Y, X));
+    }
+
+    static inline __m128 xyz_mask()
+    {
+        return _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+    }
+
+    /**
+     * @return (y * z - z * y, z * x - x * z, x * y - y * x, 0)
+     */
+    static inline __m128 cross3(__m128 lhs, __m128 rhs)
+    {
+        __m128 r = _mm_sub_ps(
+            _mm_mul_ps(lhs, swizzle<1, 2, 0, 3>(rhs)),
+            _mm_mul_ps(swizzle<1, 2, 0, 3>(lhs), rhs));
+        return _mm_and_ps(swizzle<1, 2, 0, 3>(r), xyz_mask());
+    }
+
+    /**
+     * 2x2 row-major product lhs * rhs
+     */
+    static inline __m128 mul2(__m128 lhs, __m128 rhs)
+    {
+        return _mm_add_ps(_mm_mul_ps(lhs, swizzle<0, 3, 0, 3>(rhs)),
+                          _mm_mul_ps(swizzle<1, 0, 3, 2>(lhs),
+                                     swizzle<2, 1, 2, 1>(rhs)));
+    }
+
+    /**
+     * 2x2 row-major product adjugate(lhs) * rhs
+     */
+    static inline __m128 adj_mul2(__m128 lhs, __m128 rhs)
+    {
+        return _mm_sub_ps(_mm_mul_ps(swizzle<3, 3, 0, 0>(lhs), rhs),
+                          _mm_mul_ps(swizzle<1, 1, 2, 2>(lhs),
+                                     swizzle<2, 3, 0, 1>(rhs)));
+    }
+
+    /**
+     * 2x2 row-major product lhs * adjugate(rhs)
+     */
+    static inline __m128 mul2_adj(__m128 lhs, __m128 rhs)
+    {
+        return _mm_sub_ps(_mm_mul_ps(lhs, swizzle<3, 0, 3, 0>(rhs)),
+                          _mm_mul_ps(swizzle<1, 0, 3, 2>(lhs),
+                                     swizzle<2, 1, 2, 1>(rhs)));
+    }
+
+    /**
+     * @return determinant broadcast to all lanes, det_sub receives
+     * (|A|, |B|, |C|, |D|), ab and dc receive adjugate(A) * B and
+     * adjugate(D) * C of 2x2 blocks | A B ; C D |
+     */
+    inline __m128 determinant(__m128 &det_sub, __m128 &ab, __m128 &dc) const
+    {
+        __m128 r0 = get_row(0), r1 = get_row(1);
+        __m128 r2 = get_row(2), r3 = get_row(3);
+        det_sub = _mm_sub_ps(
+            _mm_mul_ps(_mm_shuffle_ps(r0, r2, _MM_SHUFFLE(2, 0, 2, 0)),
+                       _mm_shuffle_ps(r1, r3, _MM_SHUFFLE(3, 1, 3, 1))),
+            _mm_mul_ps(_mm_shuffle_ps(r0, r2, _MM_SHUFFLE(3, 1, 3, 1)),
+                       _mm_shuffle_ps(r1, r3, _MM_SHUFFLE(2, 0, 2, 0))));
+        ab = adj_mul2(_mm_movelh_ps(r0, r1), _mm_movehl_ps(r1, r0));
+        dc = adj_mul2(_mm_movehl_ps(r3, r2), _mm_movelh_ps(r2, r3));
+        __m128 det = _mm_add_ps(
+            _mm_mul_ps(swizzle<0, 0, 0, 0>(det_sub), swizzle<3, 3, 3, 3>(det_sub)),
+            _mm_mul_ps(swizzle<1, 1, 1, 1>(det_sub), swizzle<2, 2, 2, 2>(det_sub)));
+        __m128 tr = _mm_mul_ps(ab, swizzle<0, 2, 1, 3>(dc));
+        tr = _mm_add_ps(tr, swizzle<1, 0, 3, 2>(tr));
+        tr = _mm_add_ps(tr, swizzle<2, 3, 0, 1>(tr));
+        return _mm_sub_ps(det, tr);
+    }
+
+    /**
+     * @return affine matrix with inversed linear part rows l0, l1, l2
+     * (w lanes zero) and translation -t * l
+     */
+    inline matrix4<float> affine(__m128 l0, __m128 l1, __m128 l2) const
+    {
+        __m128 t = get_row(3);
+        __m128 r = _mm_add_ps(
+            _mm_mul_ps(swizzle<0, 0, 0, 0>(t), l0),
+            _mm_mul_ps(swizzle<1, 1, 1, 1>(t), l1));
+        r = _mm_add_ps(r, _mm_mul_ps(swizzle<2, 2, 2, 2>(t), l2));
+        r = _mm_sub_ps(_mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f), r);
+        matrix4<float> nm;
+        nm.set_row(0, l0);
+        nm.set_row(1, l1);
+        nm.set_row(2, l2);
+        nm.set_row(3, r);
+        return nm;
+    }
+
+    /**
+     * Transform n vectors (x, y, z) by upper 3x3 part and add t
+     */
+    inline void transform3(const float *in, std::size_t in_stride,
+                           float *out, std::size_t out_stride,
+                           std::size_t n, __m128 t) const
+    {
+        __m128 r0 = get_row(0), r1 = get_row(1), r2 = get_row(2);
+        const char *src = reinterpret_cast<const char *>(in);
+        char *dst = reinterpret_cast<char *>(out);
+        for (std::size_t i = 0; i < n; i++)
+        {
+            const float *p = reinterpret_cast<const float *>(src + i * in_stride);
+            float *q = reinterpret_cast<float *>(dst + i * out_stride);
+            __m128 r = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p[0]), r0),
+                                  _mm_mul_ps(_mm_set1_ps(p[1]), r1));
+            r = _mm_add_ps(r, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p[2]), r2), t));
+            _mm_storel_pi(reinterpret_cast<__m64 *>(q), r);
+            _mm_store_ss(q + 2, _mm_movehl_ps(r, r));
+        }
+    }
+};
+}
+
+#endif
+
+#endif
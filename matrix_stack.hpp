@@ -0,0 +1,223 @@
+#ifndef _MATH_MATRIX_STACK_
+#define _MATH_MATRIX_STACK_
+
+#include <iostream>
+#include <cstddef>
+#include <vector>
+
+#include "aligned.hpp"
+#include "vector.hpp"
+#include "matrix.hpp"
+#include "quaternion.hpp"
+
+namespace math
+{
+/**
+ * Matrix stack of fixed-function OpenGL
+ *
+ * Matrices live in one buffer allocated for the whole depth up front, so
+ * push() and pop() only copy a matrix and move the top. multiply() composes
+ * in place with matrix4 product, SIMD for float. Like glMultMatrix, the
+ * multiplied matrix is applied to vertices first, for row vectors it is
+ * top = m * top.
+ *
+ * Row-major matrix for row vectors has the same memory layout as
+ * column-major matrix for column vectors, translation included in elements
+ * 12, 13 and 14. get_data() can be passed to glLoadMatrixf() or
+ * glUniformMatrix4fv() with transpose false as is.
+ */
+template<class T>
+class matrix_stack
+{
+    typedef T type;
+    typedef std::vector<matrix4<T>, aligned_allocator<matrix4<T> > >
+        matrix_array;
+
+    static_assert(sizeof(matrix4<T>) == 16 * sizeof(T),
+                  "matrix4 must be 16 packed values");
+
+public:
+    /**
+     * Construct stack holding identity with room for depth matrices, 32 is
+     * minimum modelview depth of OpenGL
+     */
+    explicit matrix_stack(std::size_t depth = 32) :
+        buffer(depth ? depth : 1), top(0)
+    {
+    }
+
+    /**
+     * @return number of matrices on stack, at least 1
+     */
+    inline std::size_t get_depth() const
+    {
+        return top + 1;
+    }
+
+    /**
+     * @return maximum number of matrices on stack
+     */
+    inline std::size_t get_capacity() const
+    {
+        return buffer.size();
+    }
+
+    /**
+     * Grow buffer to depth matrices, the only call that allocates
+     */
+    inline void reserve(std::size_t depth)
+    {
+        if (depth > buffer.size())
+            buffer.resize(depth);
+    }
+
+    /**
+     * @return top matrix
+     */
+    inline const matrix4<T> &get_top() const
+    {
+        return buffer[top];
+    }
+
+    /**
+     * @return 16 values of top matrix in OpenGL column-major order
+     */
+    inline const T *get_data() const
+    {
+        return &buffer[top][0];
+    }
+
+    /**
+     * Push copy of top matrix
+     * @return false and stack unchanged if stack is full
+     */
+    inline bool push()
+    {
+        if (top + 1 >= buffer.size())
+            return false;
+        buffer[top + 1] = buffer[top];
+        top++;
+        return true;
+    }
+
+    /**
+     * Push product of m and top matrix, m applied first
+     * @return false and stack unchanged if stack is full
+     */
+    inline bool push(const matrix4<T> &m)
+    {
+        if (top + 1 >= buffer.size())
+            return false;
+        buffer[top + 1] = m * buffer[top];
+        top++;
+        return true;
+    }
+
+    /**
+     * Pop top matrix
+     * @return false and stack unchanged if only one matrix is left
+     */
+    inline bool pop()
+    {
+        if (!top)
+            return false;
+        top--;
+        return true;
+    }
+
+    /**
+     * Pop all but bottom matrix and set it to identity
+     */
+    inline matrix_stack<T> &clear()
+    {
+        top = 0;
+        return load_identity();
+    }
+
+    /**
+     * Replace top matrix
+     */
+    inline matrix_stack<T> &load(const matrix4<T> &m)
+    {
+        buffer[top] = m;
+        return *this;
+    }
+
+    /**
+     * Replace top matrix with identity
+     */
+    inline matrix_stack<T> &load_identity()
+    {
+        buffer[top] = matrix4<T>();
+        return *this;
+    }
+
+    /**
+     * Multiply top matrix by m applied first, top = m * top
+     */
+    inline matrix_stack<T> &multiply(const matrix4<T> &m)
+    {
+        buffer[top] = m * buffer[top];
+        return *this;
+    }
+
+    /**
+     * Multiply top matrix by translation applied first, only last row
+     * changes
+     */
+    inline matrix_stack<T> &translate(const vector3<T> &t)
+    {
+        matrix4<T> &m = buffer[top];
+        for (unsigned int k = 0; k < 4; k++)
+            m(3, k) += t.x * m(0, k) + t.y * m(1, k) + t.z * m(2, k);
+        return *this;
+    }
+
+    /**
+     * Multiply top matrix by scale applied first, first three rows are
+     * scaled
+     */
+    inline matrix_stack<T> &scale(const vector3<T> &s)
+    {
+        matrix4<T> &m = buffer[top];
+        for (unsigned int k = 0; k < 4; k++)
+        {
+            m(0, k) *= s.x;
+            m(1, k) *= s.y;
+            m(2, k) *= s.z;
+        }
+        return *this;
+    }
+
+    /**
+     * Multiply top matrix by rotation of unit quaternion applied first
+     */
+    inline matrix_stack<T> &rotate(const quaternion<T> &r)
+    {
+        return multiply(r.to_matrix4());
+    }
+
+    friend inline std::ostream &operator <<(std::ostream &lhs,
+                                            const matrix_stack<T> &rhs)
+    {
+        lhs << "(";
+        for (std::size_t i = 0; i < rhs.top; i++)
+            lhs << rhs.buffer[i] << ", ";
+        return lhs << rhs.buffer[rhs.top] << ")";
+    }
+
+private:
+    matrix_array buffer;
+
+    /**
+     * Index of top matrix
+     */
+    std::size_t top;
+};
+
+typedef matrix_stack<float> matrix_stackf;
+typedef matrix_stack<double> matrix_stackd;
+typedef matrix_stack<long double> matrix_stackld;
+}
+
+#endif
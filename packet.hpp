@@ -0,0 +1,1271 @@
+#ifndef _MATH_PACKET_
+#define _MATH_PACKET_
+
+#include <iostream>
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#include "simd.hpp"
+#include "vector.hpp"
+#include "quaternion.hpp"
+
+namespace math
+{
+template<class T> class scalarx8;
+
+/**
+ * Eight lane comparison result, generic version keeps one bool per lane
+ */
+template<class T>
+class maskx8
+{
+    friend class scalarx8<T>;
+
+    bool m[8];
+
+public:
+    static const std::size_t lanes = 8;
+
+    /**
+     * Construct mask of all lanes set to b
+     */
+    explicit maskx8(bool b = false)
+    {
+        for (std::size_t i = 0; i < lanes; i++)
+            m[i] = b;
+    }
+
+    inline bool operator [](std::size_t i) const
+    {
+        return m[i];
+    }
+
+    /**
+     * @return bit i set for lane i
+     */
+    inline unsigned int get_bits() const
+    {
+        unsigned int bits = 0;
+        for (std::size_t i = 0; i < lanes; i++)
+            bits |= unsigned(m[i]) << i;
+        return bits;
+    }
+
+    inline bool any() const
+    {
+        return get_bits() != 0;
+    }
+
+    inline bool all() const
+    {
+        return get_bits() == 0xff;
+    }
+
+    friend inline maskx8<T> operator &(const maskx8<T> &lhs,
+                                       const maskx8<T> &rhs)
+    {
+        maskx8<T> r;
+        for (std::size_t i = 0; i < lanes; i++)
+            r.m[i] = lhs.m[i] && rhs.m[i];
+        return r;
+    }
+
+    friend inline maskx8<T> operator |(const maskx8<T> &lhs,
+                                       const maskx8<T> &rhs)
+    {
+        maskx8<T> r;
+        for (std::size_t i = 0; i < lanes; i++)
+            r.m[i] = lhs.m[i] || rhs.m[i];
+        return r;
+    }
+
+    friend inline maskx8<T> operator ^(const maskx8<T> &lhs,
+                                       const maskx8<T> &rhs)
+    {
+        maskx8<T> r;
+        for (std::size_t i = 0; i < lanes; i++)
+            r.m[i] = lhs.m[i] != rhs.m[i];
+        return r;
+    }
+
+    inline maskx8<T> operator !() const
+    {
+        maskx8<T> r;
+        for (std::size_t i = 0; i < lanes; i++)
+            r.m[i] = !m[i];
+        return r;
+    }
+};
+
+/**
+ * Eight lanes of T computed together, generic version keeps lanes in array
+ *
+ * Behaves like T in expressions: scalars convert implicitly and are
+ * broadcast to every lane, comparisons give maskx8 and select() replaces
+ * branches. vector3x8 and quaternionx8 are built of it, so kernels written
+ * once for them run eight lanes per operation with the AVX specialization.
+ * Generic version is portable fallback, compiler vectorizes scalar loops
+ * over arrays of vector3 and quaternion as well as it.
+ */
+template<class T>
+class scalarx8
+{
+    typedef T type;
+
+    T a[8];
+
+public:
+    static const std::size_t lanes = 8;
+
+    /**
+     * Construct lanes of value n
+     */
+    scalarx8(T n = T(0))
+    {
+        for (std::size_t i = 0; i < lanes; i++)
+            a[i] = n;
+    }
+
+    /**
+     * Construct lanes from array of 8 values
+     */
+    explicit scalarx8(const T *p)
+    {
+        for (std::size_t i = 0; i < lanes; i++)
+            a[i] = p[i];
+    }
+
+    /**
+     * @return value of i lane
+     */
+    inline T operator [](std::size_t i) const
+    {
+        return a[i];
+    }
+
+    /**
+     * Set i lane
+     */
+    inline scalarx8<T> &set(std::size_t i, T n)
+    {
+        a[i] = n;
+        return *this;
+    }
+
+    /**
+     * Store lanes to array of 8 values
+     */
+    inline void store(T *p) const
+    {
+        for (std::size_t i = 0; i < lanes; i++)
+            p[i] = a[i];
+    }
+
+    inline scalarx8<T> &operator +=(const scalarx8<T> &rhs)
+    {
+        *this = *this + rhs;
+        return *this;
+    }
+
+    inline scalarx8<T> &operator -=(const scalarx8<T> &rhs)
+    {
+        *this = *this - rhs;
+        return *this;
+    }
+
+    inline scalarx8<T> &operator *=(const scalarx8<T> &rhs)
+    {
+        *this = *this * rhs;
+        return *this;
+    }
+
+    inline scalarx8<T> &operator /=(const scalarx8<T> &rhs)
+    {
+        *this = *this / rhs;
+        return *this;
+    }
+
+    inline scalarx8<T> operator -() const
+    {
+        return map([](T x) { return T(-x); });
+    }
+
+    friend inline scalarx8<T> operator +(const scalarx8<T> &lhs,
+                                         const scalarx8<T> &rhs)
+    {
+        return lhs.map([](T l, T r) { return T(l + r); }, rhs);
+    }
+
+    friend inline scalarx8<T> operator -(const scalarx8<T> &lhs,
+                                         const scalarx8<T> &rhs)
+    {
+        return lhs.map([](T l, T r) { return T(l - r); }, rhs);
+    }
+
+    friend inline scalarx8<T> operator *(const scalarx8<T> &lhs,
+                                         const scalarx8<T> &rhs)
+    {
+        return lhs.map([](T l, T r) { return T(l * r); }, rhs);
+    }
+
+    friend inline scalarx8<T> operator /(const scalarx8<T> &lhs,
+                                         const scalarx8<T> &rhs)
+    {
+        return lhs.map([](T l, T r) { return T(l / r); }, rhs);
+    }
+
+    friend inline maskx8<T> operator <(const scalarx8<T> &lhs,
+                                       const scalarx8<T> &rhs)
+    {
+        return lhs.test([](T l, T r) { return l < r; }, rhs);
+    }
+
+    friend inline maskx8<T> operator <=(const scalarx8<T> &lhs,
+                                        const scalarx8<T> &rhs)
+    {
+        return lhs.test([](T l, T r) { return l <= r; }, rhs);
+    }
+
+    friend inline maskx8<T> operator >(const scalarx8<T> &lhs,
+                                       const scalarx8<T> &rhs)
+    {
+        return lhs.test([](T l, T r) { return l > r; }, rhs);
+    }
+
+    friend inline maskx8<T> operator >=(const scalarx8<T> &lhs,
+                                        const scalarx8<T> &rhs)
+    {
+        return lhs.test([](T l, T r) { return l >= r; }, rhs);
+    }
+
+    friend inline maskx8<T> operator ==(const scalarx8<T> &lhs,
+                                        const scalarx8<T> &rhs)
+    {
+        return lhs.test([](T l, T r) { return l == r; }, rhs);
+    }
+
+    friend inline maskx8<T> operator !=(const scalarx8<T> &lhs,
+                                        const scalarx8<T> &rhs)
+    {
+        return lhs.test([](T l, T r) { return l != r; }, rhs);
+    }
+
+    /**
+     * @return lhs in lanes of m, rhs in other lanes
+     */
+    friend inline scalarx8<T> select(const maskx8<T> &m,
+                                     const scalarx8<T> &lhs,
+                                     const scalarx8<T> &rhs)
+    {
+        return lhs.blend(m, rhs);
+    }
+
+    friend inline scalarx8<T> min(const scalarx8<T> &lhs,
+                                  const scalarx8<T> &rhs)
+    {
+        return lhs.map([](T l, T r) { return l < r ? l : r; }, rhs);
+    }
+
+    friend inline scalarx8<T> max(const scalarx8<T> &lhs,
+                                  const scalarx8<T> &rhs)
+    {
+        return lhs.map([](T l, T r) { return l > r ? l : r; }, rhs);
+    }
+
+    friend inline scalarx8<T> abs(const scalarx8<T> &x)
+    {
+        return x.map([](T n) { return T(std::abs(n)); });
+    }
+
+    friend inline scalarx8<T> sqrt(const scalarx8<T> &x)
+    {
+        return x.map([](T n) { return T(std::sqrt(n)); });
+    }
+
+    /**
+     * @return reciprocal square root by rsqrt_kernel
+     */
+    friend inline scalarx8<T> rsqrt(const scalarx8<T> &x)
+    {
+        return x.map([](T n) { return rsqrt_kernel<T>::run(n); });
+    }
+
+    /**
+     * Load 8 vectors (x, y, z) placed one after another
+     */
+    static inline void load3(const T *p, scalarx8<T> &x, scalarx8<T> &y,
+                             scalarx8<T> &z)
+    {
+        for (std::size_t i = 0; i < lanes; i++)
+        {
+            x.a[i] = p[3 * i];
+            y.a[i] = p[3 * i + 1];
+            z.a[i] = p[3 * i + 2];
+        }
+    }
+
+    /**
+     * Store 8 vectors (x, y, z) one after another
+     */
+    static inline void store3(T *p, const scalarx8<T> &x,
+                              const scalarx8<T> &y, const scalarx8<T> &z)
+    {
+        for (std::size_t i = 0; i < lanes; i++)
+        {
+            p[3 * i] = x.a[i];
+            p[3 * i + 1] = y.a[i];
+            p[3 * i + 2] = z.a[i];
+        }
+    }
+
+    /**
+     * Load 8 vectors (x, y, z, w) placed one after another
+     */
+    static inline void load4(const T *p, scalarx8<T> &x, scalarx8<T> &y,
+                             scalarx8<T> &z, scalarx8<T> &w)
+    {
+        for (std::size_t i = 0; i < lanes; i++)
+        {
+            x.a[i] = p[4 * i];
+            y.a[i] = p[4 * i + 1];
+            z.a[i] = p[4 * i + 2];
+            w.a[i] = p[4 * i + 3];
+        }
+    }
+
+    /**
+     * Store 8 vectors (x, y, z, w) one after another
+     */
+    static inline void store4(T *p, const scalarx8<T> &x,
+                              const scalarx8<T> &y, const scalarx8<T> &z,
+                              const scalarx8<T> &w)
+    {
+        for (std::size_t i = 0; i < lanes; i++)
+        {
+            p[4 * i] = x.a[i];
+            p[4 * i + 1] = y.a[i];
+            p[4 * i + 2] = z.a[i];
+            p[4 * i + 3] = w.a[i];
+        }
+    }
+
+    friend inline std::ostream &operator <<(std::ostream &lhs,
+                                            const scalarx8<T> &rhs)
+    {
+        lhs << "(";
+        for (std::size_t i = 0; i + 1 < lanes; i++)
+            lhs << rhs.a[i] << ", ";
+        return lhs << rhs.a[lanes - 1] << ")";
+    }
+
+private:
+    /**
+     * Lane-wise helpers, result is built in place of return value, copies of
+     * arguments defeat vectorization of short loops
+     */
+    template<class F>
+    inline scalarx8<T> map(F f) const
+    {
+        scalarx8<T> r;
+        for (std::size_t i = 0; i < lanes; i++)
+            r.a[i] = f(a[i]);
+        return r;
+    }
+
+    template<class F>
+    inline scalarx8<T> map(F f, const scalarx8<T> &rhs) const
+    {
+        scalarx8<T> r;
+        for (std::size_t i = 0; i < lanes; i++)
+            r.a[i] = f(a[i], rhs.a[i]);
+        return r;
+    }
+
+    template<class F>
+    inline maskx8<T> test(F f, const scalarx8<T> &rhs) const
+    {
+        maskx8<T> r;
+        for (std::size_t i = 0; i < lanes; i++)
+            r.m[i] = f(a[i], rhs.a[i]);
+        return r;
+    }
+
+    inline scalarx8<T> blend(const maskx8<T> &m, const scalarx8<T> &rhs) const
+    {
+        scalarx8<T> r;
+        for (std::size_t i = 0; i < lanes; i++)
+            r.a[i] = m.m[i] ? a[i] : rhs.a[i];
+        return r;
+    }
+};
+
+#ifdef MATH_AVX
+/**
+ * AVX specialization, all bits of lane set in one register
+ */
+template<>
+class maskx8<float>
+{
+    __m256 m;
+
+public:
+    static const std::size_t lanes = 8;
+
+    explicit maskx8(bool b = false) :
+        m(_mm256_castsi256_ps(_mm256_set1_epi32(b ? -1 : 0)))
+    {
+    }
+
+    explicit maskx8(__m256 m) :
+        m(m)
+    {
+    }
+
+    inline __m256 get_simd() const
+    {
+        return m;
+    }
+
+    inline bool operator [](std::size_t i) const
+    {
+        return (get_bits() >> i) & 1;
+    }
+
+    inline unsigned int get_bits() const
+    {
+        return unsigned(_mm256_movemask_ps(m));
+    }
+
+    inline bool any() const
+    {
+        return get_bits() != 0;
+    }
+
+    inline bool all() const
+    {
+        return get_bits() == 0xff;
+    }
+
+    friend inline maskx8<float> operator &(const maskx8<float> &lhs,
+                                           const maskx8<float> &rhs)
+    {
+        return maskx8<float>(_mm256_and_ps(lhs.m, rhs.m));
+    }
+
+    friend inline maskx8<float> operator |(const maskx8<float> &lhs,
+                                           const maskx8<float> &rhs)
+    {
+        return maskx8<float>(_mm256_or_ps(lhs.m, rhs.m));
+    }
+
+    friend inline maskx8<float> operator ^(const maskx8<float> &lhs,
+                                           const maskx8<float> &rhs)
+    {
+        return maskx8<float>(_mm256_xor_ps(lhs.m, rhs.m));
+    }
+
+    inline maskx8<float> operator !() const
+    {
+        return maskx8<float>(_mm256_xor_ps(m, maskx8<float>(true).m));
+    }
+};
+
+/**
+ * AVX specialization, eight lanes in one register
+ */
+template<>
+class alignas(32) scalarx8<float>
+{
+    typedef float type;
+
+    __m256 m;
+
+public:
+    static const std::size_t lanes = 8;
+
+    scalarx8(float n = 0.0f) :
+        m(_mm256_set1_ps(n))
+    {
+    }
+
+    explicit scalarx8(const float *p) :
+        m(_mm256_loadu_ps(p))
+    {
+    }
+
+    explicit scalarx8(__m256 m) :
+        m(m)
+    {
+    }
+
+    inline __m256 get_simd() const
+    {
+        return m;
+    }
+
+    inline float operator [](std::size_t i) const
+    {
+        alignas(32) float a[8];
+        _mm256_store_ps(a, m);
+        return a[i];
+    }
+
+    inline scalarx8<float> &set(std::size_t i, float n)
+    {
+        alignas(32) float a[8];
+        _mm256_store_ps(a, m);
+        a[i] = n;
+        m = _mm256_load_ps(a);
+        return *this;
+    }
+
+    inline void store(float *p) const
+    {
+        _mm256_storeu_ps(p, m);
+    }
+
+    inline scalarx8<float> &operator +=(const scalarx8<float> &rhs)
+    {
+        m = _mm256_add_ps(m, rhs.m);
+        return *this;
+    }
+
+    inline scalarx8<float> &operator -=(const scalarx8<float> &rhs)
+    {
+        m = _mm256_sub_ps(m, rhs.m);
+        return *this;
+    }
+
+    inline scalarx8<float> &operator *=(const scalarx8<float> &rhs)
+    {
+        m = _mm256_mul_ps(m, rhs.m);
+        return *this;
+    }
+
+    inline scalarx8<float> &operator /=(const scalarx8<float> &rhs)
+    {
+        m = _mm256_div_ps(m, rhs.m);
+        return *this;
+    }
+
+    inline scalarx8<float> operator -() const
+    {
+        return scalarx8<float>(_mm256_xor_ps(m, _mm256_set1_ps(-0.0f)));
+    }
+
+    friend inline scalarx8<float> operator +(const scalarx8<float> &lhs,
+                                             const scalarx8<float> &rhs)
+    {
+        return scalarx8<float>(_mm256_add_ps(lhs.m, rhs.m));
+    }
+
+    friend inline scalarx8<float> operator -(const scalarx8<float> &lhs,
+                                             const scalarx8<float> &rhs)
+    {
+        return scalarx8<float>(_mm256_sub_ps(lhs.m, rhs.m));
+    }
+
+    friend inline scalarx8<float> operator *(const scalarx8<float> &lhs,
+                                             const scalarx8<float> &rhs)
+    {
+        return scalarx8<float>(_mm256_mul_ps(lhs.m, rhs.m));
+    }
+
+    friend inline scalarx8<float> operator /(const scalarx8<float> &lhs,
+                                             const scalarx8<float> &rhs)
+    {
+        return scalarx8<float>(_mm256_div_ps(lhs.m, rhs.m));
+    }
+
+    friend inline maskx8<float> operator <(const scalarx8<float> &lhs,
+                                           const scalarx8<float> &rhs)
+    {
+        return maskx8<float>(_mm256_cmp_ps(lhs.m, rhs.m, _CMP_LT_OQ));
+    }
+
+    friend inline maskx8<float> operator <=(const scalarx8<float> &lhs,
+                                            const scalarx8<float> &rhs)
+    {
+        return maskx8<float>(_mm256_cmp_ps(lhs.m, rhs.m, _CMP_LE_OQ));
+    }
+
+    friend inline maskx8<float> operator >(const scalarx8<float> &lhs,
+                                           const scalarx8<float> &rhs)
+    {
+        return maskx8<float>(_mm256_cmp_ps(lhs.m, rhs.m, _CMP_GT_OQ));
+    }
+
+    friend inline maskx8<float> operator >=(const scalarx8<float> &lhs,
+                                            const scalarx8<float> &rhs)
+    {
+        return maskx8<float>(_mm256_cmp_ps(lhs.m, rhs.m, _CMP_GE_OQ));
+    }
+
+    friend inline maskx8<float> operator ==(const scalarx8<float> &lhs,
+                                            const scalarx8<float> &rhs)
+    {
+        return maskx8<float>(_mm256_cmp_ps(lhs.m, rhs.m, _CMP_EQ_OQ));
+    }
+
+    friend inline maskx8<float> operator !=(const scalarx8<float> &lhs,
+                                            const scalarx8<float> &rhs)
+    {
+        return maskx8<float>(_mm256_cmp_ps(lhs.m, rhs.m, _CMP_NEQ_UQ));
+    }
+
+    friend inline scalarx8<float> select(const maskx8<float> &m,
+                                         const scalarx8<float> &lhs,
+                                         const scalarx8<float> &rhs)
+    {
+        return scalarx8<float>(_mm256_blendv_ps(rhs.m, lhs.m, m.get_simd()));
+    }
+
+    /**
+     * @return lhs < rhs ? lhs : rhs, same as generic version
+     */
+    friend inline scalarx8<float> min(const scalarx8<float> &lhs,
+                                      const scalarx8<float> &rhs)
+    {
+        return scalarx8<float>(_mm256_min_ps(lhs.m, rhs.m));
+    }
+
+    /**
+     * @return lhs > rhs ? lhs : rhs, same as generic version
+     */
+    friend inline scalarx8<float> max(const scalarx8<float> &lhs,
+                                      const scalarx8<float> &rhs)
+    {
+        return scalarx8<float>(_mm256_max_ps(lhs.m, rhs.m));
+    }
+
+    friend inline scalarx8<float> abs(const scalarx8<float> &x)
+    {
+        return scalarx8<float>(_mm256_andnot_ps(_mm256_set1_ps(-0.0f), x.m));
+    }
+
+    friend inline scalarx8<float> sqrt(const scalarx8<float> &x)
+    {
+        return scalarx8<float>(_mm256_sqrt_ps(x.m));
+    }
+
+    /**
+     * @return reciprocal square root, rsqrtps refined by one Newton step
+     * as rsqrt_kernel<float>
+     */
+    friend inline scalarx8<float> rsqrt(const scalarx8<float> &x)
+    {
+        return scalarx8<float>(rsqrt_kernel<float>::refine(
+            x.m, _mm256_rsqrt_ps(x.m)));
+    }
+
+    /**
+     * Load 8 vectors (x, y, z) placed one after another, halves of
+     * registers hold vectors 0-3 and 4-7 and are shuffled in place
+     */
+    static inline void load3(const float *p, scalarx8<float> &x,
+                             scalarx8<float> &y, scalarx8<float> &z)
+    {
+        __m256 m03 = _mm256_insertf128_ps(
+            _mm256_castps128_ps256(_mm_loadu_ps(p)), _mm_loadu_ps(p + 12), 1);
+        __m256 m14 = _mm256_insertf128_ps(
+            _mm256_castps128_ps256(_mm_loadu_ps(p + 4)),
+            _mm_loadu_ps(p + 16), 1);
+        __m256 m25 = _mm256_insertf128_ps(
+            _mm256_castps128_ps256(_mm_loadu_ps(p + 8)),
+            _mm_loadu_ps(p + 20), 1);
+        __m256 xy = _mm256_shuffle_ps(m14, m25, _MM_SHUFFLE(2, 1, 3, 2));
+        __m256 yz = _mm256_shuffle_ps(m03, m14, _MM_SHUFFLE(1, 0, 2, 1));
+        x.m = _mm256_shuffle_ps(m03, xy, _MM_SHUFFLE(2, 0, 3, 0));
+        y.m = _mm256_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0));
+        z.m = _mm256_shuffle_ps(yz, m25, _MM_SHUFFLE(3, 0, 3, 1));
+    }
+
+    /**
+     * Store 8 vectors (x, y, z) one after another, inverse of load3()
+     */
+    static inline void store3(float *p, const scalarx8<float> &x,
+                              const scalarx8<float> &y,
+                              const scalarx8<float> &z)
+    {
+        __m256 xy = _mm256_shuffle_ps(x.m, y.m, _MM_SHUFFLE(2, 0, 2, 0));
+        __m256 yz = _mm256_shuffle_ps(y.m, z.m, _MM_SHUFFLE(3, 1, 3, 1));
+        __m256 zx = _mm256_shuffle_ps(z.m, x.m, _MM_SHUFFLE(3, 1, 2, 0));
+        __m256 m03 = _mm256_shuffle_ps(xy, zx, _MM_SHUFFLE(2, 0, 2, 0));
+        __m256 m14 = _mm256_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0));
+        __m256 m25 = _mm256_shuffle_ps(zx, yz, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm_storeu_ps(p, _mm256_castps256_ps128(m03));
+        _mm_storeu_ps(p + 4, _mm256_castps256_ps128(m14));
+        _mm_storeu_ps(p + 8, _mm256_castps256_ps128(m25));
+        _mm_storeu_ps(p + 12, _mm256_extractf128_ps(m03, 1));
+        _mm_storeu_ps(p + 16, _mm256_extractf128_ps(m14, 1));
+        _mm_storeu_ps(p + 20, _mm256_extractf128_ps(m25, 1));
+    }
+
+    /**
+     * Load 8 vectors (x, y, z, w) placed one after another, vectors i and
+     * i + 4 are paired in halves and transposed as 4x4 blocks
+     */
+    static inline void load4(const float *p, scalarx8<float> &x,
+                             scalarx8<float> &y, scalarx8<float> &z,
+                             scalarx8<float> &w)
+    {
+        __m256 r0 = _mm256_loadu_ps(p), r1 = _mm256_loadu_ps(p + 8);
+        __m256 r2 = _mm256_loadu_ps(p + 16), r3 = _mm256_loadu_ps(p + 24);
+        __m256 a = _mm256_permute2f128_ps(r0, r2, 0x20);
+        __m256 b = _mm256_permute2f128_ps(r0, r2, 0x31);
+        __m256 c = _mm256_permute2f128_ps(r1, r3, 0x20);
+        __m256 d = _mm256_permute2f128_ps(r1, r3, 0x31);
+        __m256 t0 = _mm256_unpacklo_ps(a, b), t1 = _mm256_unpacklo_ps(c, d);
+        __m256 t2 = _mm256_unpackhi_ps(a, b), t3 = _mm256_unpackhi_ps(c, d);
+        x.m = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+        y.m = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+        z.m = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+        w.m = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));
+    }
+
+    /**
+     * Store 8 vectors (x, y, z, w) one after another, inverse of load4()
+     */
+    static inline void store4(float *p, const scalarx8<float> &x,
+                              const scalarx8<float> &y,
+                              const scalarx8<float> &z,
+                              const scalarx8<float> &w)
+    {
+        __m256 t0 = _mm256_unpacklo_ps(x.m, y.m);
+        __m256 t1 = _mm256_unpacklo_ps(z.m, w.m);
+        __m256 t2 = _mm256_unpackhi_ps(x.m, y.m);
+        __m256 t3 = _mm256_unpackhi_ps(z.m, w.m);
+        __m256 a = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 b = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+        __m256 c = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 d = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));
+        _mm256_storeu_ps(p, _mm256_permute2f128_ps(a, b, 0x20));
+        _mm256_storeu_ps(p + 8, _mm256_permute2f128_ps(c, d, 0x20));
+        _mm256_storeu_ps(p + 16, _mm256_permute2f128_ps(a, b, 0x31));
+        _mm256_storeu_ps(p + 24, _mm256_permute2f128_ps(c, d, 0x31));
+    }
+
+    friend inline std::ostream &operator <<(std::ostream &lhs,
+                                            const scalarx8<float> &rhs)
+    {
+        alignas(32) float a[8];
+        _mm256_store_ps(a, rhs.m);
+        lhs << "(";
+        for (std::size_t i = 0; i + 1 < lanes; i++)
+            lhs << a[i] << ", ";
+        return lhs << a[lanes - 1] << ")";
+    }
+};
+#endif
+
+/**
+ * Eight vector3 in lanes, x, y and z hold one component of every lane
+ *
+ * Same operators as vector3, lane by lane. Arrays of vector3 are loaded
+ * and stored 8 at a time. AVX specialization needs 32-byte alignment, use
+ * aligned_allocator in containers.
+ */
+template<class T>
+class vector3x8
+{
+    typedef T type;
+
+public:
+    static const std::size_t lanes = 8;
+
+    scalarx8<T> x, y, z;
+
+    /**
+     * Construct zero vectors
+     */
+    vector3x8()
+    {
+    }
+
+    vector3x8(const scalarx8<T> &x, const scalarx8<T> &y,
+              const scalarx8<T> &z) :
+        x(x), y(y), z(z)
+    {
+    }
+
+    /**
+     * Construct lanes of vector v
+     */
+    explicit vector3x8(const vector3<T> &v) :
+        x(v.x), y(v.y), z(v.z)
+    {
+    }
+
+    /**
+     * Construct lanes from array of 8 vectors
+     */
+    explicit vector3x8(const vector3<T> *p)
+    {
+        scalarx8<T>::load3(reinterpret_cast<const T *>(p), x, y, z);
+    }
+
+    /**
+     * @return vector of i lane
+     */
+    inline vector3<T> get(std::size_t i) const
+    {
+        return vector3<T>(x[i], y[i], z[i]);
+    }
+
+    /**
+     * Set i lane
+     */
+    inline vector3x8<T> &set(std::size_t i, const vector3<T> &v)
+    {
+        x.set(i, v.x);
+        y.set(i, v.y);
+        z.set(i, v.z);
+        return *this;
+    }
+
+    /**
+     * Store lanes to array of 8 vectors
+     */
+    inline void store(vector3<T> *p) const
+    {
+        scalarx8<T>::store3(reinterpret_cast<T *>(p), x, y, z);
+    }
+
+    inline vector3x8<T> &operator +=(const vector3x8<T> &rhs)
+    {
+        x += rhs.x;
+        y += rhs.y;
+        z += rhs.z;
+        return *this;
+    }
+
+    inline vector3x8<T> &operator -=(const vector3x8<T> &rhs)
+    {
+        x -= rhs.x;
+        y -= rhs.y;
+        z -= rhs.z;
+        return *this;
+    }
+
+    inline vector3x8<T> &operator *=(const scalarx8<T> &rhs)
+    {
+        x *= rhs;
+        y *= rhs;
+        z *= rhs;
+        return *this;
+    }
+
+    inline vector3x8<T> &operator /=(const scalarx8<T> &rhs)
+    {
+        x /= rhs;
+        y /= rhs;
+        z /= rhs;
+        return *this;
+    }
+
+    inline vector3x8<T> operator -() const
+    {
+        return vector3x8<T>(-x, -y, -z);
+    }
+
+    inline vector3x8<T> operator +(const vector3x8<T> &rhs) const
+    {
+        return vector3x8<T>(x + rhs.x, y + rhs.y, z + rhs.z);
+    }
+
+    inline vector3x8<T> operator -(const vector3x8<T> &rhs) const
+    {
+        return vector3x8<T>(x - rhs.x, y - rhs.y, z - rhs.z);
+    }
+
+    inline vector3x8<T> operator *(const scalarx8<T> &rhs) const
+    {
+        return vector3x8<T>(x * rhs, y * rhs, z * rhs);
+    }
+
+    friend inline vector3x8<T> operator *(const scalarx8<T> &lhs,
+                                          const vector3x8<T> &rhs)
+    {
+        return rhs * lhs;
+    }
+
+    inline vector3x8<T> operator /(const scalarx8<T> &rhs) const
+    {
+        return vector3x8<T>(x / rhs, y / rhs, z / rhs);
+    }
+
+    friend inline scalarx8<T> dot(const vector3x8<T> &lhs,
+                                  const vector3x8<T> &rhs)
+    {
+        return lhs.x * rhs.x + lhs.y * rhs.y + lhs.z * rhs.z;
+    }
+
+    friend inline vector3x8<T> cross(const vector3x8<T> &lhs,
+                                     const vector3x8<T> &rhs)
+    {
+        return vector3x8<T>(lhs.y * rhs.z - lhs.z * rhs.y,
+                            lhs.z * rhs.x - lhs.x * rhs.z,
+                            lhs.x * rhs.y - lhs.y * rhs.x);
+    }
+
+    /**
+     * @return lengths
+     */
+    inline scalarx8<T> norm() const
+    {
+        return sqrt(dot(*this, *this));
+    }
+
+    /**
+     * @return normalized vectors
+     */
+    inline vector3x8<T> normalize() const
+    {
+        return operator /(norm());
+    }
+
+    /**
+     * @return normalized vectors, approximation of normalize() by rsqrt()
+     */
+    inline vector3x8<T> normalize_fast() const
+    {
+        return operator *(rsqrt(dot(*this, *this)));
+    }
+
+    /**
+     * @return lhs in lanes of m, rhs in other lanes
+     */
+    friend inline vector3x8<T> select(const maskx8<T> &m,
+                                      const vector3x8<T> &lhs,
+                                      const vector3x8<T> &rhs)
+    {
+        return vector3x8<T>(select(m, lhs.x, rhs.x), select(m, lhs.y, rhs.y),
+                            select(m, lhs.z, rhs.z));
+    }
+
+    friend inline std::ostream &operator <<(std::ostream &lhs,
+                                            const vector3x8<T> &rhs)
+    {
+        return lhs << "(" << rhs.x << ", " << rhs.y << ", " << rhs.z << ")";
+    }
+};
+
+/**
+ * Eight quaternions in lanes, v and w hold imaginary and real parts of
+ * every lane
+ *
+ * Same operators as quaternion, lane by lane, slerp() evaluates the same
+ * polynomial as quaternion slerp().
+ */
+template<class T>
+class quaternionx8
+{
+    typedef T type;
+
+public:
+    static const std::size_t lanes = 8;
+
+    /**
+     * Imaginary parts
+     */
+    vector3x8<T> v;
+
+    /**
+     * Real parts
+     */
+    scalarx8<T> w;
+
+    /**
+     * Construct zero quaternions
+     */
+    quaternionx8()
+    {
+    }
+
+    quaternionx8(const vector3x8<T> &v, const scalarx8<T> &w) :
+        v(v), w(w)
+    {
+    }
+
+    /**
+     * Construct lanes of quaternion q
+     */
+    explicit quaternionx8(const quaternion<T> &q) :
+        v(q.v), w(q.w)
+    {
+    }
+
+    /**
+     * Construct lanes from array of 8 quaternions
+     */
+    explicit quaternionx8(const quaternion<T> *p)
+    {
+        static_assert(sizeof(quaternion<T>) == 4 * sizeof(T),
+                      "quaternion must be four packed values");
+        scalarx8<T>::load4(reinterpret_cast<const T *>(p), v.x, v.y, v.z, w);
+    }
+
+    /**
+     * @return quaternion of i lane
+     */
+    inline quaternion<T> get(std::size_t i) const
+    {
+        return quaternion<T>(v.get(i), w[i]);
+    }
+
+    /**
+     * Set i lane
+     */
+    inline quaternionx8<T> &set(std::size_t i, const quaternion<T> &q)
+    {
+        v.set(i, q.v);
+        w.set(i, q.w);
+        return *this;
+    }
+
+    /**
+     * Store lanes to array of 8 quaternions
+     */
+    inline void store(quaternion<T> *p) const
+    {
+        scalarx8<T>::store4(reinterpret_cast<T *>(p), v.x, v.y, v.z, w);
+    }
+
+    inline quaternionx8<T> &operator +=(const quaternionx8<T> &rhs)
+    {
+        v += rhs.v;
+        w += rhs.w;
+        return *this;
+    }
+
+    inline quaternionx8<T> &operator -=(const quaternionx8<T> &rhs)
+    {
+        v -= rhs.v;
+        w -= rhs.w;
+        return *this;
+    }
+
+    inline quaternionx8<T> &operator *=(const scalarx8<T> &rhs)
+    {
+        v *= rhs;
+        w *= rhs;
+        return *this;
+    }
+
+    inline quaternionx8<T> &operator *=(const quaternionx8<T> &rhs)
+    {
+        *this = *this * rhs;
+        return *this;
+    }
+
+    inline quaternionx8<T> operator +(const quaternionx8<T> &rhs) const
+    {
+        return quaternionx8<T>(v + rhs.v, w + rhs.w);
+    }
+
+    inline quaternionx8<T> operator -(const quaternionx8<T> &rhs) const
+    {
+        return quaternionx8<T>(v - rhs.v, w - rhs.w);
+    }
+
+    inline quaternionx8<T> operator *(const scalarx8<T> &rhs) const
+    {
+        return quaternionx8<T>(v * rhs, w * rhs);
+    }
+
+    friend inline quaternionx8<T> operator *(const scalarx8<T> &lhs,
+                                             const quaternionx8<T> &rhs)
+    {
+        return rhs * lhs;
+    }
+
+    /**
+     * @return Hamilton products of lanes
+     */
+    inline quaternionx8<T> operator *(const quaternionx8<T> &rhs) const
+    {
+        return quaternionx8<T>(cross(v, rhs.v) + w * rhs.v + rhs.w * v,
+                               w * rhs.w - dot(v, rhs.v));
+    }
+
+    /**
+     * @return quaternion norms, i.e. squared lengths
+     */
+    inline scalarx8<T> get_norm() const
+    {
+        return dot(v, v) + w * w;
+    }
+
+    inline quaternionx8<T> get_normalize() const
+    {
+        scalarx8<T> m = scalarx8<T>(T(1)) / sqrt(get_norm());
+        return quaternionx8<T>(v * m, w * m);
+    }
+
+    inline quaternionx8<T> &normalize()
+    {
+        *this = get_normalize();
+        return *this;
+    }
+
+    /**
+     * @return normalized quaternions, approximation of get_normalize() by
+     * rsqrt()
+     */
+    inline quaternionx8<T> get_normalize_fast() const
+    {
+        scalarx8<T> m = rsqrt(get_norm());
+        return quaternionx8<T>(v * m, w * m);
+    }
+
+    inline quaternionx8<T> &normalize_fast()
+    {
+        *this = get_normalize_fast();
+        return *this;
+    }
+
+    inline quaternionx8<T> get_conjugate() const
+    {
+        return quaternionx8<T>(-v, w);
+    }
+
+    inline quaternionx8<T> &conjugate()
+    {
+        v = -v;
+        return *this;
+    }
+
+    inline quaternionx8<T> get_inverse() const
+    {
+        return get_conjugate() * (scalarx8<T>(T(1)) / get_norm());
+    }
+
+    inline quaternionx8<T> &inverse()
+    {
+        *this = get_inverse();
+        return *this;
+    }
+
+    /**
+     * @return vectors rotated by unit quaternions, same as
+     * quaternion::rotate()
+     */
+    inline vector3x8<T> rotate(const vector3x8<T> &rhs) const
+    {
+        vector3x8<T> t = cross(v, rhs) * scalarx8<T>(T(2));
+        return rhs + t * w + cross(v, t);
+    }
+
+    /**
+     * @return scalar products of quaternions as four-dimensional vectors
+     */
+    friend inline scalarx8<T> dot(const quaternionx8<T> &lhs,
+                                  const quaternionx8<T> &rhs)
+    {
+        return dot(lhs.v, rhs.v) + lhs.w * rhs.w;
+    }
+
+    /**
+     * @return normalized linear interpolation of unit quaternions along
+     * shortest path
+     */
+    friend inline quaternionx8<T> nlerp(const quaternionx8<T> &lhs,
+                                        const quaternionx8<T> &rhs,
+                                        const scalarx8<T> &t)
+    {
+        scalarx8<T> s = select(dot(lhs, rhs) < scalarx8<T>(T(0)), -t, t);
+        return (lhs * (scalarx8<T>(T(1)) - t) + rhs * s).get_normalize();
+    }
+
+    /**
+     * @return spherical linear interpolation of unit quaternions along
+     * shortest path, see quaternion slerp() for angle error, result is not
+     * renormalized and its norm differs from 1 by up to 2.9e-5
+     */
+    friend inline quaternionx8<T> slerp(const quaternionx8<T> &lhs,
+                                        const quaternionx8<T> &rhs,
+                                        const scalarx8<T> &t)
+    {
+        scalarx8<T> x = dot(lhs, rhs);
+        scalarx8<T> s = select(x < scalarx8<T>(T(0)), scalarx8<T>(T(-1)),
+                               scalarx8<T>(T(1)));
+        scalarx8<T> u, v;
+        slerp_weights(x * s, t, u, v,
+                      std::make_index_sequence<quaternion<T>::slerp_order>());
+        return lhs * u + rhs * (s * v);
+    }
+
+    /**
+     * @return lhs in lanes of m, rhs in other lanes
+     */
+    friend inline quaternionx8<T> select(const maskx8<T> &m,
+                                         const quaternionx8<T> &lhs,
+                                         const quaternionx8<T> &rhs)
+    {
+        return quaternionx8<T>(select(m, lhs.v, rhs.v),
+                               select(m, lhs.w, rhs.w));
+    }
+
+    friend inline std::ostream &operator <<(std::ostream &lhs,
+                                            const quaternionx8<T> &rhs)
+    {
+        return lhs << "(" << rhs.v << ", " << rhs.w << ")";
+    }
+
+private:
+    /**
+     * Weights sin((1 - t) * a) / sin(a) and sin(t * a) / sin(a) of slerp
+     * for x = cos(a) in [0, 1] in one pass, coefficients of quaternion
+     * polynomial are tabulated at compile time
+     */
+    template<std::size_t... I>
+    static inline void slerp_weights(const scalarx8<T> &x,
+                                     const scalarx8<T> &t, scalarx8<T> &u,
+                                     scalarx8<T> &v, std::index_sequence<I...>)
+    {
+        static constexpr T cu[] = {quaternion<T>::slerp_u(int(I))...};
+        static constexpr T cv[] = {quaternion<T>::slerp_v(int(I))...};
+        scalarx8<T> one(T(1)), s = one - t, s2 = s * s, t2 = t * t;
+        scalarx8<T> xm1 = x - one, a = one, b = one;
+        for (std::size_t i = sizeof...(I); i-- > 0; )
+        {
+            a = one + (cu[i] * s2 - cv[i]) * xm1 * a;
+            b = one + (cu[i] * t2 - cv[i]) * xm1 * b;
+        }
+        u = a * s;
+        v = b * t;
+    }
+};
+
+template<class T>
+const std::size_t maskx8<T>::lanes;
+
+template<class T>
+const std::size_t scalarx8<T>::lanes;
+
+template<class T>
+const std::size_t vector3x8<T>::lanes;
+
+template<class T>
+const std::size_t quaternionx8<T>::lanes;
+
+typedef scalarx8<float> scalarx8f;
+typedef scalarx8<double> scalarx8d;
+typedef scalarx8<long double> scalarx8ld;
+
+typedef vector3x8<float> vector3x8f;
+typedef vector3x8<double> vector3x8d;
+typedef vector3x8<long double> vector3x8ld;
+
+typedef quaternionx8<float> quaternionx8f;
+typedef quaternionx8<double> quaternionx8d;
+typedef quaternionx8<long double> quaternionx8ld;
+
+static_assert(std::is_trivially_copyable<vector3x8<float> >::value &&
+              std::is_trivially_copyable<quaternionx8<double> >::value,
+              "packets must be trivially copyable");
+}
+
+#endif
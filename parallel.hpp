@@ -0,0 +1,52 @@
+#ifndef _MATH_PARALLEL_
+#define _MATH_PARALLEL_
+
+#include <cstddef>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace math
+{
+/**
+ * Call f(begin, end) for chunks of at most grain indices covering [0, n)
+ *
+ * Chunks are handed out dynamically to hardware_concurrency() threads, the
+ * calling thread included, and the call returns when all of them are done.
+ * f must be safe to call concurrently on disjoint ranges.
+ */
+template<class F>
+inline void parallel_for(std::size_t n, std::size_t grain, F f)
+{
+    if (!grain)
+        grain = 1;
+    std::size_t chunks = (n + grain - 1) / grain;
+    std::size_t threads = std::thread::hardware_concurrency();
+    if (threads > chunks)
+        threads = chunks;
+    if (threads <= 1)
+    {
+        for (std::size_t b = 0; b < n; b += grain)
+            f(b, n - b < grain ? n : b + grain);
+        return;
+    }
+    std::atomic<std::size_t> next(0);
+    auto work = [&]()
+    {
+        for (std::size_t c; (c = next.fetch_add(1)) < chunks; )
+        {
+            std::size_t b = c * grain;
+            f(b, n - b < grain ? n : b + grain);
+        }
+    };
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (std::size_t i = 1; i < threads; i++)
+        pool.emplace_back(work);
+    work();
+    for (std::size_t i = 0; i < pool.size(); i++)
+        pool[i].join();
+}
+}
+
+#endif
@@ -0,0 +1,161 @@
+#ifndef _MATH_PROJECTION_
+#define _MATH_PROJECTION_
+
+#include <iostream>
+#include <cmath>
+#include <type_traits>
+
+#include "vector.hpp"
+#include "matrix.hpp"
+
+namespace math
+{
+/**
+ * Camera matrix and its inverse
+ *
+ * Builders below are for row vectors, clip = p * direct, and right-handed
+ * view space looking down -z like OpenGL. Inverses are written down in
+ * closed form, so unprojection and picking do not invert 4x4 matrices.
+ */
+template<class T>
+struct inverse_pair
+{
+    typedef T type;
+
+    /**
+     * Matrix
+     */
+    matrix4<T> direct;
+
+    /**
+     * Inverse of direct
+     */
+    matrix4<T> inverse;
+
+    /**
+     * @return pair of composition, lhs applied first
+     */
+    friend inline inverse_pair<T> operator *(const inverse_pair<T> &lhs,
+                                             const inverse_pair<T> &rhs)
+    {
+        return inverse_pair<T>{lhs.direct * rhs.direct,
+                               rhs.inverse * lhs.inverse};
+    }
+
+    friend inline std::ostream &operator <<(std::ostream &lhs,
+                                            const inverse_pair<T> &rhs)
+    {
+        return lhs << "(" << rhs.direct << ", " << rhs.inverse << ")";
+    }
+};
+
+/**
+ * @return perspective projection and its inverse
+ * @param fovy vertical field of view in radians
+ * @param aspect width / height
+ * @param near_z distance to near plane
+ * @param far_z distance to far plane
+ * @param zero_to_one clip depth range is [0, w] instead of [-w, w]
+ */
+template<class T>
+inline inverse_pair<T> perspective(T fovy, T aspect, T near_z, T far_z,
+                                   bool zero_to_one = false)
+{
+    T f = T(1) / std::tan(fovy * T(0.5)), d = T(1) / (near_z - far_z);
+    T a = zero_to_one ? far_z * d : (near_z + far_z) * d;
+    T b = (zero_to_one ? T(1) : T(2)) * near_z * far_z * d;
+    return inverse_pair<T>{
+        matrix4<T>(f / aspect, T(0), T(0), T(0),
+                   T(0), f, T(0), T(0),
+                   T(0), T(0), a, T(-1),
+                   T(0), T(0), b, T(0)),
+        matrix4<T>(aspect / f, T(0), T(0), T(0),
+                   T(0), T(1) / f, T(0), T(0),
+                   T(0), T(0), T(0), T(1) / b,
+                   T(0), T(0), T(-1), a / b)};
+}
+
+/**
+ * @return perspective projection with far plane at infinity and depth
+ * reversed, near plane maps to 1 and infinity to 0, and its inverse
+ *
+ * Clip depth range is [0, w]. With floating-point depth buffer cleared to 0
+ * and greater depth test, precision stays uniform over distance.
+ * @param fovy vertical field of view in radians
+ * @param aspect width / height
+ * @param near_z distance to near plane
+ */
+template<class T>
+inline inverse_pair<T> infinite_reverse_z(T fovy, T aspect, T near_z)
+{
+    T f = T(1) / std::tan(fovy * T(0.5));
+    return inverse_pair<T>{
+        matrix4<T>(f / aspect, T(0), T(0), T(0),
+                   T(0), f, T(0), T(0),
+                   T(0), T(0), T(0), T(-1),
+                   T(0), T(0), near_z, T(0)),
+        matrix4<T>(aspect / f, T(0), T(0), T(0),
+                   T(0), T(1) / f, T(0), T(0),
+                   T(0), T(0), T(0), T(1) / near_z,
+                   T(0), T(0), T(-1), T(0))};
+}
+
+/**
+ * @return orthographic projection of box [left, right] x [bottom, top] x
+ * [-near_z, -far_z] and its inverse
+ * @param zero_to_one clip depth range is [0, w] instead of [-w, w]
+ */
+template<class T>
+inline inverse_pair<T> ortho(T left, T right, T bottom, T top, T near_z,
+                             T far_z, bool zero_to_one = false)
+{
+    T sx = T(2) / (right - left), sy = T(2) / (top - bottom);
+    T sz = (zero_to_one ? T(1) : T(2)) / (near_z - far_z);
+    T tx = -(right + left) / (right - left);
+    T ty = -(top + bottom) / (top - bottom);
+    T tz = zero_to_one ? near_z / (near_z - far_z) :
+                         (near_z + far_z) / (near_z - far_z);
+    return inverse_pair<T>{
+        matrix4<T>(sx, T(0), T(0), T(0),
+                   T(0), sy, T(0), T(0),
+                   T(0), T(0), sz, T(0),
+                   tx, ty, tz, T(1)),
+        matrix4<T>(T(1) / sx, T(0), T(0), T(0),
+                   T(0), T(1) / sy, T(0), T(0),
+                   T(0), T(0), T(1) / sz, T(0),
+                   -tx / sx, -ty / sy, -tz / sz, T(1))};
+}
+
+/**
+ * @return view matrix of camera at eye looking at target and its inverse,
+ * camera to world matrix
+ * @param up direction of view space y, must not be parallel to view
+ */
+template<class T>
+inline inverse_pair<T> look_at(const vector3<T> &eye, const vector3<T> &target,
+                               const vector3<T> &up)
+{
+    vector3<T> f = (target - eye).normalize();
+    vector3<T> s = cross(f, up).normalize();
+    vector3<T> u = cross(s, f);
+    return inverse_pair<T>{
+        matrix4<T>(s.x, u.x, -f.x, T(0),
+                   s.y, u.y, -f.y, T(0),
+                   s.z, u.z, -f.z, T(0),
+                   -dot(s, eye), -dot(u, eye), dot(f, eye), T(1)),
+        matrix4<T>(s.x, s.y, s.z, T(0),
+                   u.x, u.y, u.z, T(0),
+                   -f.x, -f.y, -f.z, T(0),
+                   eye.x, eye.y, eye.z, T(1))};
+}
+
+typedef inverse_pair<float> inverse_pairf;
+typedef inverse_pair<double> inverse_paird;
+typedef inverse_pair<long double> inverse_pairld;
+
+static_assert(std::is_trivially_copyable<inverse_pair<float> >::value &&
+              std::is_trivially_copyable<inverse_pair<double> >::value,
+              "inverse pairs must be trivially copyable");
+}
+
+#endif
@@ -3,8 +3,11 @@
 
 #include <iostream>
 #include <cmath>
+#include <cstddef>
+#include <type_traits>
 
 #include "vector.hpp"
+#include "matrix.hpp"
 
 namespace math
 {
@@ -30,36 +33,32 @@ public:
     /**
      * Construct quaternion (0, 0, 0, w)
      */
-    quaternion(T w = T(0))
+    constexpr quaternion(T w = T(0)) :
+        v(T(0)), w(w)
     {
-        set(w);
     }
 
     /**
      * Construct quaternion (x, y, z, w)
      */
-    quaternion(T x, T y, T z, T w = T(0))
+    constexpr quaternion(T x, T y, T z, T w = T(0)) :
+        v(x, y, z), w(w)
     {
-        set(x, y, z, w);
     }
 
     /**
      * Construct quaternion (v, w)
      */
-    quaternion(const vector3<T> &v, T w = T(0))
+    constexpr quaternion(const vector3<T> &v, T w = T(0)) :
+        v(v), w(w)
     {
-        set(v, w);
     }
 
     /**
      * Construct quaternion from array
      */
-    quaternion(const T *a)
-    {
-        set(a);
-    }
-
-    ~quaternion()
+    constexpr quaternion(const T *a) :
+        v(a), w(a[3])
     {
     }
 
@@ -69,7 +68,7 @@ public:
      */
     inline T &operator [](unsigned int i)
     {
-        get(i);
+        return get(i);
     }
 
     /**
@@ -78,7 +77,7 @@ public:
      */
     inline const T &operator [](unsigned int i) const
     {
-        get(i);
+        return get(i);
     }
 
     /**
@@ -87,7 +86,7 @@ public:
      */
     inline T &operator ()(unsigned int i)
     {
-        get(i);
+        return get(i);
     }
 
     /**
@@ -96,7 +95,7 @@ public:
      */
     inline const T &operator ()(unsigned int i) const
     {
-        get(i);
+        return get(i);
     }
 
     /**
@@ -105,7 +104,7 @@ public:
      */
     inline operator T *()
     {
-        return &v;
+        return &v.x;
     }
 
     /**
@@ -114,7 +113,7 @@ public:
      */
     inline operator const T *() const
     {
-        return &v;
+        return &v.x;
     }
 
     /**
@@ -123,7 +122,7 @@ public:
      */
     inline T &get(unsigned int i)
     {
-        return *(&v + i);
+        return *(&v.x + i);
     }
 
     /**
@@ -132,14 +131,14 @@ public:
      */
     inline const T &get(unsigned int i) const
     {
-        return *(&v + i);
+        return *(&v.x + i);
     }
 
     /**
      * Explicit getter
      * @return imaginary part
      */
-    inline vector3<T> &get_im()
+    inline constexpr vector3<T> &get_im()
     {
         return v;
     }
@@ -148,7 +147,7 @@ public:
      * Explicit getter
      * @return imaginary part of constant quaternion
      */
-    inline const vector3<T> &get_im() const
+    inline constexpr const vector3<T> &get_im() const
     {
         return v;
     }
@@ -157,7 +156,7 @@ public:
      * Explicit getter
      * @return real part
      */
-    inline T &get_re()
+    inline constexpr T &get_re()
     {
         return w;
     }
@@ -166,7 +165,7 @@ public:
      * Explicit getter
      * @return real part of constant quaternion
      */
-    inline const T &get_re() const
+    inline constexpr const T &get_re() const
     {
         return w;
     }
@@ -174,7 +173,7 @@ public:
     /**
      * Set quaternion (0, 0, 0, w)
      */
-    inline quaternion<T> &set(T w = T(0))
+    inline constexpr quaternion<T> &set(T w = T(0))
     {
         v.set();
         this->w = w;
@@ -184,7 +183,7 @@ public:
     /**
      * Set quaternion (x, y, z, w)
      */
-    inline quaternion<T> &set(T x, T y, T z, T w = T(0))
+    inline constexpr quaternion<T> &set(T x, T y, T z, T w = T(0))
     {
         v.set(x, y, z);
         this->w = w;
@@ -194,7 +193,7 @@ public:
     /**
      * Set quaternion (v, w)
      */
-    inline quaternion<T> &set(const vector3<T> &v, T w = T(0))
+    inline constexpr quaternion<T> &set(const vector3<T> &v, T w = T(0))
     {
         this->v = v;
         this->w = w;
@@ -204,17 +203,17 @@ public:
     /**
      * Set quaternion from array
      */
-    inline quaternion<T> &set(const T *a)
+    inline constexpr quaternion<T> &set(const T *a)
     {
         v.set(a);
-        w = a[4];
+        w = a[3];
         return *this;
     }
 
     /**
      * Operator +=
      */
-    inline quaternion<T> &operator +=(T rhs)
+    inline constexpr quaternion<T> &operator +=(T rhs)
     {
         w += rhs;
         return *this;
@@ -223,7 +222,7 @@ public:
     /**
      * Operator +=
      */
-    inline quaternion<T> &operator +=(const vector3<T> &rhs)
+    inline constexpr quaternion<T> &operator +=(const vector3<T> &rhs)
     {
         v += rhs;
         return *this;
@@ -232,7 +231,7 @@ public:
     /**
      * Operator +=
      */
-    inline quaternion<T> &operator +=(const quaternion<T> &rhs)
+    inline constexpr quaternion<T> &operator +=(const quaternion<T> &rhs)
     {
         v += rhs.v;
         w += rhs.w;
@@ -242,7 +241,7 @@ public:
     /**
      * Operator +
      */
-    inline quaternion<T> operator +(T rhs) const
+    inline constexpr quaternion<T> operator +(T rhs) const
     {
         return quaternion<T>(v, w + rhs);
     }
@@ -250,7 +249,7 @@ public:
     /**
      * Operator +
      */
-    inline quaternion<T> operator +(const vector3<T> &rhs) const
+    inline constexpr quaternion<T> operator +(const vector3<T> &rhs) const
     {
         return quaternion<T>(v + rhs, w);
     }
@@ -258,7 +257,7 @@ public:
     /**
      * Operator +
      */
-    inline quaternion<T> operator +(const quaternion<T> &rhs) const
+    inline constexpr quaternion<T> operator +(const quaternion<T> &rhs) const
     {
         return quaternion<T>(v + rhs.v, w + rhs.w);
     }
@@ -266,7 +265,7 @@ public:
     /**
      * Operator +
      */
-    friend inline quaternion<T> operator +(T lhs, const quaternion<T> &rhs)
+    friend inline constexpr quaternion<T> operator +(T lhs, const quaternion<T> &rhs)
     {
         return quaternion<T>(rhs.v, lhs + rhs.w);
     }
@@ -274,7 +273,7 @@ public:
     /**
      * Operator +
      */
-    friend inline quaternion<T> operator +(const vector3<T> &lhs, const quaternion<T> &rhs)
+    friend inline constexpr quaternion<T> operator +(const vector3<T> &lhs, const quaternion<T> &rhs)
     {
         return quaternion<T>(lhs + rhs.v, rhs.w);
     }
@@ -282,7 +281,7 @@ public:
     /**
      * Operator -=
      */
-    inline quaternion<T> &operator -=(T rhs)
+    inline constexpr quaternion<T> &operator -=(T rhs)
     {
         w -= rhs;
         return *this;
@@ -291,7 +290,7 @@ public:
     /**
      * Operator -=
      */
-    inline quaternion<T> &operator -=(const vector3<T> &rhs)
+    inline constexpr quaternion<T> &operator -=(const vector3<T> &rhs)
     {
         v -= rhs;
         return *this;
@@ -300,7 +299,7 @@ public:
     /**
      * Operator -=
      */
-    inline quaternion<T> &operator -=(const quaternion<T> &rhs)
+    inline constexpr quaternion<T> &operator -=(const quaternion<T> &rhs)
     {
         v -= rhs.v;
         w -= rhs.w;
@@ -310,7 +309,7 @@ public:
     /**
      * Operator -
      */
-    inline quaternion<T> operator -(T rhs) const
+    inline constexpr quaternion<T> operator -(T rhs) const
     {
         return quaternion<T>(v, w - rhs);
     }
@@ -318,7 +317,7 @@ public:
     /**
      * Operator -
      */
-    inline quaternion<T> operator -(const vector3<T> &rhs) const
+    inline constexpr quaternion<T> operator -(const vector3<T> &rhs) const
     {
         return quaternion<T>(v - rhs, w);
     }
@@ -326,7 +325,7 @@ public:
     /**
      * Operator -
      */
-    inline quaternion<T> operator -(const quaternion<T> &rhs) const
+    inline constexpr quaternion<T> operator -(const quaternion<T> &rhs) const
     {
         return quaternion<T>(v - rhs.v, w - rhs.w);
     }
@@ -334,7 +333,7 @@ public:
     /**
      * Operator -
      */
-    friend inline quaternion<T> operator -(T lhs, const quaternion<T> &rhs)
+    friend inline constexpr quaternion<T> operator -(T lhs, const quaternion<T> &rhs)
     {
         return quaternion<T>(-rhs.v, lhs - rhs.w);
     }
@@ -342,7 +341,7 @@ public:
     /**
      * Operator -
      */
-    friend inline quaternion<T> operator -(const vector3<T> &lhs, const quaternion<T> &rhs)
+    friend inline constexpr quaternion<T> operator -(const vector3<T> &lhs, const quaternion<T> &rhs)
     {
         return quaternion<T>(lhs - rhs.v, -rhs.w);
     }
@@ -350,7 +349,7 @@ public:
     /**
      * Operator *=
      */
-    inline quaternion<T> &operator *=(T rhs)
+    inline constexpr quaternion<T> &operator *=(T rhs)
     {
         v *= rhs;
         w *= rhs;
@@ -360,27 +359,25 @@ public:
     /**
      * Operator *=
      */
-    inline quaternion<T> &operator *=(const vector3<T> &rhs)
+    inline constexpr quaternion<T> &operator *=(const vector3<T> &rhs)
     {
-        v = cross(v, rhs.v);
-        w = -dot(v, rhs.v);
+        *this = *this * rhs;
         return *this;
     }
 
     /**
      * Operator *=
      */
-    inline quaternion<T> &operator *=(const quaternion<T> &rhs)
+    inline constexpr quaternion<T> &operator *=(const quaternion<T> &rhs)
     {
-        v = cross(v, rhs.v) + w * rhs.v + rhs.w * v;
-        w = w * rhs.w - dot(v, rhs.v);
+        *this = *this * rhs;
         return *this;
     }
 
     /**
      * Operator *
      */
-    inline quaternion<T> operator *(T rhs) const
+    inline constexpr quaternion<T> operator *(T rhs) const
     {
         return quaternion<T>(v * rhs, w * rhs);
     }
@@ -388,7 +385,7 @@ public:
     /**
      * Operator *
      */
-    inline quaternion<T> operator *(const vector3<T> &rhs) const
+    inline constexpr quaternion<T> operator *(const vector3<T> &rhs) const
     {
         return quaternion<T>(cross(v, rhs) + w * rhs, -dot(v, rhs));
     }
@@ -396,7 +393,7 @@ public:
     /**
      * Operator *
      */
-    inline quaternion<T> operator *(const quaternion<T> &rhs) const
+    inline constexpr quaternion<T> operator *(const quaternion<T> &rhs) const
     {
         return quaternion<T>(cross(v, rhs.v) + w * rhs.v + rhs.w * v,
                              w * rhs.w - dot(v, rhs.v));
@@ -405,7 +402,7 @@ public:
     /**
      * Operator *
      */
-    friend inline quaternion<T> operator *(T lhs, const quaternion<T> &rhs)
+    friend inline constexpr quaternion<T> operator *(T lhs, const quaternion<T> &rhs)
     {
         return quaternion<T>(lhs * rhs.v, lhs * rhs.w);
     }
@@ -413,7 +410,7 @@ public:
     /**
      * Operator *
      */
-    friend inline quaternion<T> operator *(const vector3<T> &lhs, const quaternion<T> &rhs)
+    friend inline constexpr quaternion<T> operator *(const vector3<T> &lhs, const quaternion<T> &rhs)
     {
         return quaternion<T>(cross(lhs, rhs.v) + rhs.w * lhs, -dot(lhs, rhs.v));
     }
@@ -421,7 +418,7 @@ public:
     /**
      * Operator ==
      */
-    inline bool operator ==(const quaternion<T> &rhs) const
+    inline constexpr bool operator ==(const quaternion<T> &rhs) const
     {
         return v == rhs.v && w == rhs.w;
     }
@@ -429,15 +426,15 @@ public:
     /**
      * Operator !=
      */
-    inline bool operator !=(const quaternion<T> &rhs) const
+    inline constexpr bool operator !=(const quaternion<T> &rhs) const
     {
         return v != rhs.v || w != rhs.w;
     }
 
     /**
-     * @return quaternion norm
+     * @return quaternion norm, i.e. squared length
      */
-    inline T get_norm() const
+    inline constexpr T get_norm() const
     {
         return dot(v, v) + w * w;
     }
@@ -447,7 +444,7 @@ public:
      */
     inline quaternion<T> get_normalize() const
     {
-        T m = 1.0 / get_norm();
+        T m = T(1) / std::sqrt(get_norm());
         return quaternion<T>(v * m, w * m);
     }
 
@@ -457,13 +454,32 @@ public:
     inline quaternion<T> &normalize()
     {
         *this = get_normalize();
-	return *this;
+        return *this;
+    }
+
+    /**
+     * @return normalized quaternion, approximation of get_normalize() by
+     * rsqrt_kernel
+     */
+    inline quaternion<T> get_normalize_fast() const
+    {
+        T m = rsqrt_kernel<T>::run(get_norm());
+        return quaternion<T>(v * m, w * m);
+    }
+
+    /**
+     * Set normalized quaternion by get_normalize_fast()
+     */
+    inline quaternion<T> &normalize_fast()
+    {
+        *this = get_normalize_fast();
+        return *this;
     }
 
     /**
      * @return conjugated quaternion
      */
-    inline quaternion<T> get_conjugate() const
+    inline constexpr quaternion<T> get_conjugate() const
     {
         return quaternion<T>(-v, w);
     }
@@ -471,39 +487,258 @@ public:
     /**
      * Set conjugated quaternion
      */
-    inline quaternion<T> &conjugate() 
+    inline constexpr quaternion<T> &conjugate()
     {
         *this = get_conjugate();
-	return *this;
+        return *this;
     }
 
     /**
      * @return inversed quaternion
      */
-    inline quaternion<T> get_inverse() const
+    inline constexpr quaternion<T> get_inverse() const
     {
-        return conjugate().normalize();
+        return get_conjugate() * (T(1) / get_norm());
     }
 
     /**
      * Set inversed quaternion
      */
-    inline quaternion<T> &inverse()
+    inline constexpr quaternion<T> &inverse()
     {
         *this = get_inverse();
-	return *this;
+        return *this;
     }
 
-    friend inline std::ostream &operator <<(std::ostream &lhs,
-                                            const vector4<T> &rhs)
+    /**
+     * @return vector rotated by unit quaternion, same as q * v * q^-1
+     * computed as v + w * t + u x t with t = 2 * u x v
+     */
+    inline constexpr vector3<T> rotate(const vector3<T> &rhs) const
+    {
+        vector3<T> t = cross(v, rhs) * T(2);
+        return rhs + t * w + cross(v, t);
+    }
+
+    /**
+     * Rotate n vectors by unit quaternion, in and out may be equal.
+     * Vectors are processed in blocks laid out across lanes.
+     */
+    inline void rotate(const vector3<T> *in, vector3<T> *out,
+                       std::size_t n) const
+    {
+        const std::size_t lanes = 8;
+        const T x = v.x, y = v.y, z = v.z, s = w;
+        for (std::size_t b = 0; b < n; b += lanes)
+        {
+            std::size_t count = n - b < lanes ? n - b : lanes;
+            T px[lanes], py[lanes], pz[lanes];
+            for (std::size_t l = 0; l < lanes; l++)
+            {
+                const vector3<T> &p = in[b + (l < count ? l : 0)];
+                px[l] = p.x;
+                py[l] = p.y;
+                pz[l] = p.z;
+            }
+            for (std::size_t l = 0; l < lanes; l++)
+            {
+                T tx = T(2) * (y * pz[l] - z * py[l]);
+                T ty = T(2) * (z * px[l] - x * pz[l]);
+                T tz = T(2) * (x * py[l] - y * px[l]);
+                px[l] += s * tx + (y * tz - z * ty);
+                py[l] += s * ty + (z * tx - x * tz);
+                pz[l] += s * tz + (x * ty - y * tx);
+            }
+            for (std::size_t l = 0; l < count; l++)
+                out[b + l].set(px[l], py[l], pz[l]);
+        }
+    }
+
+    /**
+     * @return rotation matrix of unit quaternion for row vectors,
+     * v * to_matrix3() == rotate(v)
+     */
+    inline constexpr matrix3<T> to_matrix3() const
+    {
+        T xx = v.x * v.x, yy = v.y * v.y, zz = v.z * v.z;
+        T xy = v.x * v.y, xz = v.x * v.z, yz = v.y * v.z;
+        T wx = w * v.x, wy = w * v.y, wz = w * v.z;
+        return matrix3<T>(T(1) - T(2) * (yy + zz), T(2) * (xy + wz),
+                          T(2) * (xz - wy),
+                          T(2) * (xy - wz), T(1) - T(2) * (xx + zz),
+                          T(2) * (yz + wx),
+                          T(2) * (xz + wy), T(2) * (yz - wx),
+                          T(1) - T(2) * (xx + yy));
+    }
+
+    /**
+     * @return homogeneous rotation matrix of unit quaternion for row vectors
+     */
+    inline constexpr matrix4<T> to_matrix4() const
+    {
+        matrix3<T> m = to_matrix3();
+        return matrix4<T>(m(0, 0), m(0, 1), m(0, 2), T(0),
+                          m(1, 0), m(1, 1), m(1, 2), T(0),
+                          m(2, 0), m(2, 1), m(2, 2), T(0),
+                          T(0), T(0), T(0), T(1));
+    }
+
+    /**
+     * @return unit quaternion of rotation matrix for row vectors
+     */
+    static inline quaternion<T> from_matrix(const matrix3<T> &m)
+    {
+        return from_matrix(m(0, 0), m(0, 1), m(0, 2),
+                           m(1, 0), m(1, 1), m(1, 2),
+                           m(2, 0), m(2, 1), m(2, 2));
+    }
+
+    /**
+     * @return unit quaternion of upper 3x3 rotation part of matrix
+     */
+    static inline quaternion<T> from_matrix(const matrix4<T> &m)
+    {
+        return from_matrix(m(0, 0), m(0, 1), m(0, 2),
+                           m(1, 0), m(1, 1), m(1, 2),
+                           m(2, 0), m(2, 1), m(2, 2));
+    }
+
+    /**
+     * @return scalar product of quaternions as four-dimensional vectors
+     */
+    friend inline constexpr T dot(const quaternion<T> &lhs,
+                                  const quaternion<T> &rhs)
+    {
+        return dot(lhs.v, rhs.v) + lhs.w * rhs.w;
+    }
+
+    /**
+     * @return normalized linear interpolation of unit quaternions along
+     * shortest path
+     */
+    friend inline quaternion<T> nlerp(const quaternion<T> &lhs,
+                                      const quaternion<T> &rhs, T t)
+    {
+        T s = dot(lhs, rhs) < T(0) ? -t : t;
+        return (lhs * (T(1) - t) + rhs * s).get_normalize();
+    }
+
+    /**
+     * @return spherical linear interpolation of unit quaternions along
+     * shortest path
+     *
+     * Weights sin((1 - t) * a) / sin(a) and sin(t * a) / sin(a) are
+     * evaluated by polynomial of cos(a) without acos/sin calls (D. Eberly,
+     * A Fast and Accurate Algorithm for Computing SLERP). Maximum angle
+     * error of result is 8.3e-6 rad on the unit sphere of quaternions, i.e.
+     * 1.7e-5 rad of rotation angle, for float, double and long double alike.
+     * Result is not renormalized, its norm differs from 1 by up to 2.9e-5,
+     * worst near a = 1.44 rad and t = 0.5. Normalize result where unit
+     * length matters, e.g. before composing it repeatedly.
+     */
+    friend inline constexpr quaternion<T> slerp(const quaternion<T> &lhs,
+                                                const quaternion<T> &rhs, T t)
+    {
+        T x = dot(lhs, rhs);
+        T s = x < T(0) ? T(-1) : T(1);
+        return lhs * slerp_weight(x * s, T(1) - t) +
+               rhs * (s * slerp_weight(x * s, t));
+    }
+
+    /**
+     * @return weight sin(t * a) / sin(a) of slerp for x = cos(a) in [0, 1]
+     */
+    static inline constexpr T slerp_weight(T x, T t)
     {
-        return lhs << rhs.v << rhs.w;
+        T t2 = t * t, xm1 = x - T(1), c = T(1);
+        for (int i = slerp_order - 1; i >= 0; i--)
+            c = T(1) + (slerp_u(i) * t2 - slerp_v(i)) * xm1 * c;
+        return c * t;
+    }
+
+    /**
+     * Number of terms of slerp polynomial
+     */
+    static const int slerp_order = 8;
+
+    /**
+     * Coefficients of slerp polynomial, u(i) = 1 / (i (2i + 1)),
+     * v(i) = i / (2i + 1) for i = 1..n, the last term is scaled to
+     * minimize maximum error on [0, 1]
+     */
+    static inline constexpr T slerp_u(int i)
+    {
+        return (i == slerp_order - 1 ? T(slerp_mu) : T(1)) /
+               T((i + 1) * (2 * i + 3));
+    }
+
+    static inline constexpr T slerp_v(int i)
+    {
+        return (i == slerp_order - 1 ? T(slerp_mu) : T(1)) * T(i + 1) /
+               T(2 * i + 3);
+    }
+
+    static constexpr double slerp_mu = 1.85298109240830;
+
+    friend inline std::ostream &operator <<(std::ostream &lhs,
+                                            const quaternion<T> &rhs)
+    {
+        return lhs << "(" << rhs.v << ", " << rhs.w << ")";
+    }
+
+private:
+    /**
+     * Shepperd's method, picks the largest of w, x, y, z to divide by
+     */
+    static inline quaternion<T> from_matrix(T m00, T m01, T m02,
+                                            T m10, T m11, T m12,
+                                            T m20, T m21, T m22)
+    {
+        T trace = m00 + m11 + m22;
+        if (trace > T(0))
+        {
+            T s = T(0.5) / std::sqrt(trace + T(1));
+            return quaternion<T>((m12 - m21) * s, (m20 - m02) * s,
+                                 (m01 - m10) * s, T(0.25) / s);
+        }
+        if (m00 > m11 && m00 > m22)
+        {
+            T s = T(2) * std::sqrt(T(1) + m00 - m11 - m22);
+            T r = T(1) / s;
+            return quaternion<T>(T(0.25) * s, (m01 + m10) * r,
+                                 (m02 + m20) * r, (m12 - m21) * r);
+        }
+        if (m11 > m22)
+        {
+            T s = T(2) * std::sqrt(T(1) + m11 - m00 - m22);
+            T r = T(1) / s;
+            return quaternion<T>((m01 + m10) * r, T(0.25) * s,
+                                 (m12 + m21) * r, (m20 - m02) * r);
+        }
+        T s = T(2) * std::sqrt(T(1) + m22 - m00 - m11);
+        T r = T(1) / s;
+        return quaternion<T>((m02 + m20) * r, (m12 + m21) * r,
+                             T(0.25) * s, (m01 - m10) * r);
     }
 };
 
+/**
+ * Normalize n quaternions by get_normalize_fast(), in and out may be equal
+ */
+template<class T>
+inline void normalize_fast(const quaternion<T> *in, quaternion<T> *out,
+                           std::size_t n)
+{
+    rsqrt_kernel<T>::template normalize<4>(reinterpret_cast<const T *>(in),
+                                           reinterpret_cast<T *>(out), n);
+}
+
 typedef quaternion<float> quaternionf;
 typedef quaternion<double> quaterniond;
 typedef quaternion<long double> quaternionld;
+
+static_assert(std::is_trivially_copyable<quaternion<double> >::value,
+              "quaternion must be trivially copyable");
 }
 
 #endif
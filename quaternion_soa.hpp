@@ -0,0 +1,384 @@
+#ifndef _MATH_QUATERNION_SOA_
+#define _MATH_QUATERNION_SOA_
+
+#include <cstddef>
+#include <cmath>
+#include <cassert>
+#include <vector>
+
+#include "aligned.hpp"
+#include "quaternion.hpp"
+
+namespace math
+{
+/**
+ * Structure-of-arrays container of quaternions
+ *
+ * Components are stored in separate cache-line aligned arrays padded with
+ * zeros to a whole number of lanes, so batch kernels below always run on
+ * full blocks of lanes elements. Operands of binary kernels must have the
+ * same size, without assertions the smaller size is used.
+ */
+template<class T>
+class quaternion_soa
+{
+    typedef T type;
+    typedef std::vector<T, aligned_allocator<T> > array;
+
+    array x, y, z, w;
+    std::size_t size;
+
+public:
+    /**
+     * Number of elements processed by one kernel block
+     */
+    static const std::size_t lanes = 64 / sizeof(T) > 0 ? 64 / sizeof(T) : 1;
+
+    /**
+     * Construct n zero quaternions
+     */
+    explicit quaternion_soa(std::size_t n = 0) :
+        size(0)
+    {
+        resize(n);
+    }
+
+    /**
+     * Construct from array of n quaternions
+     */
+    quaternion_soa(const quaternion<T> *q, std::size_t n) :
+        size(0)
+    {
+        set(q, n);
+    }
+
+    /**
+     * @return number of quaternions
+     */
+    inline std::size_t get_size() const
+    {
+        return size;
+    }
+
+    /**
+     * @return number of quaternions including padding
+     */
+    inline std::size_t get_capacity() const
+    {
+        return x.size();
+    }
+
+    /**
+     * Resize container, new quaternions are zero
+     */
+    inline void resize(std::size_t n)
+    {
+        std::size_t capacity = (n + lanes - 1) / lanes * lanes;
+        if (n < size)
+            for (std::size_t i = n; i < size; i++)
+                x[i] = y[i] = z[i] = w[i] = T(0);
+        x.resize(capacity, T(0));
+        y.resize(capacity, T(0));
+        z.resize(capacity, T(0));
+        w.resize(capacity, T(0));
+        size = n;
+    }
+
+    inline void clear()
+    {
+        resize(0);
+    }
+
+    inline void push_back(const quaternion<T> &q)
+    {
+        resize(size + 1);
+        set(size - 1, q);
+    }
+
+    /**
+     * Explicit getters
+     * @return component array
+     */
+    inline T *get_x()
+    {
+        return x.data();
+    }
+
+    inline const T *get_x() const
+    {
+        return x.data();
+    }
+
+    inline T *get_y()
+    {
+        return y.data();
+    }
+
+    inline const T *get_y() const
+    {
+        return y.data();
+    }
+
+    inline T *get_z()
+    {
+        return z.data();
+    }
+
+    inline const T *get_z() const
+    {
+        return z.data();
+    }
+
+    inline T *get_w()
+    {
+        return w.data();
+    }
+
+    inline const T *get_w() const
+    {
+        return w.data();
+    }
+
+    /**
+     * Explicit getter
+     * @return copy of i quaternion
+     */
+    inline quaternion<T> get(std::size_t i) const
+    {
+        return quaternion<T>(x[i], y[i], z[i], w[i]);
+    }
+
+    /**
+     * Array access operator
+     * @return copy of i quaternion
+     */
+    inline quaternion<T> operator [](std::size_t i) const
+    {
+        return get(i);
+    }
+
+    /**
+     * Set i quaternion
+     */
+    inline quaternion_soa<T> &set(std::size_t i, const quaternion<T> &q)
+    {
+        x[i] = q.v.x;
+        y[i] = q.v.y;
+        z[i] = q.v.z;
+        w[i] = q.w;
+        return *this;
+    }
+
+    /**
+     * Set container from array of n quaternions
+     */
+    inline quaternion_soa<T> &set(const quaternion<T> *q, std::size_t n)
+    {
+        resize(n);
+        for (std::size_t i = 0; i < n; i++)
+            set(i, q[i]);
+        return *this;
+    }
+
+    /**
+     * Copy quaternions into array of get_size() quaternions
+     */
+    inline void store(quaternion<T> *q) const
+    {
+        for (std::size_t i = 0; i < size; i++)
+            q[i] = get(i);
+    }
+
+    /**
+     * Spherical linear interpolation of get_size() pairs of unit quaternions
+     * with factors t into out, see slerp() of quaternion for accuracy,
+     * results are not renormalized and their norm differs from 1 by up to
+     * 2.9e-5. Sizes must be equal, out may be lhs or rhs, padding stays
+     * zero.
+     */
+    friend inline void slerp(const quaternion_soa<T> &lhs,
+                             const quaternion_soa<T> &rhs, const T *t,
+                             quaternion_soa<T> &out)
+    {
+        std::size_t n = common_size(lhs, rhs);
+        out.resize(n);
+        for (std::size_t b = 0; b < out.get_capacity(); b += lanes)
+        {
+            T f[lanes];
+            load_factors(t + b, f, n - b);
+            slerp_block(lhs.x.data() + b, lhs.y.data() + b,
+                        lhs.z.data() + b, lhs.w.data() + b,
+                        rhs.x.data() + b, rhs.y.data() + b,
+                        rhs.z.data() + b, rhs.w.data() + b, f,
+                        out.x.data() + b, out.y.data() + b,
+                        out.z.data() + b, out.w.data() + b);
+        }
+    }
+
+    /**
+     * Normalized linear interpolation of get_size() pairs of unit
+     * quaternions with factors t into out, sizes must be equal, out may be
+     * lhs or rhs, padding stays zero.
+     */
+    friend inline void nlerp(const quaternion_soa<T> &lhs,
+                             const quaternion_soa<T> &rhs, const T *t,
+                             quaternion_soa<T> &out)
+    {
+        std::size_t n = common_size(lhs, rhs);
+        out.resize(n);
+        for (std::size_t b = 0; b < out.get_capacity(); b += lanes)
+        {
+            T f[lanes];
+            load_factors(t + b, f, n - b);
+            nlerp_block(lhs.x.data() + b, lhs.y.data() + b,
+                        lhs.z.data() + b, lhs.w.data() + b,
+                        rhs.x.data() + b, rhs.y.data() + b,
+                        rhs.z.data() + b, rhs.w.data() + b, f,
+                        out.x.data() + b, out.y.data() + b,
+                        out.z.data() + b, out.w.data() + b);
+        }
+    }
+
+    /**
+     * Slerp of one block of lanes elements given by component arrays,
+     * outputs may alias inputs, norm of results differs from 1 by up to
+     * 2.9e-5 as for slerp() of quaternion
+     */
+    static inline void slerp_block(const T *ax, const T *ay, const T *az,
+                                   const T *aw, const T *bx, const T *by,
+                                   const T *bz, const T *bw, const T *t,
+                                   T *ox, T *oy, T *oz, T *ow)
+    {
+        T xm1[lanes], sign[lanes], ta[lanes], tb[lanes];
+        T ca[lanes], cb[lanes];
+        for (std::size_t l = 0; l < lanes; l++)
+        {
+            T d = ax[l] * bx[l] + ay[l] * by[l] + az[l] * bz[l] + aw[l] * bw[l];
+            sign[l] = d < T(0) ? T(-1) : T(1);
+            xm1[l] = d * sign[l] - T(1);
+            tb[l] = t[l];
+            ta[l] = T(1) - t[l];
+            ca[l] = cb[l] = T(1);
+        }
+        for (int i = quaternion<T>::slerp_order - 1; i >= 0; i--)
+        {
+            const T u = quaternion<T>::slerp_u(i);
+            const T v = quaternion<T>::slerp_v(i);
+            for (std::size_t l = 0; l < lanes; l++)
+            {
+                ca[l] = T(1) + (u * ta[l] * ta[l] - v) * xm1[l] * ca[l];
+                cb[l] = T(1) + (u * tb[l] * tb[l] - v) * xm1[l] * cb[l];
+            }
+        }
+        for (std::size_t l = 0; l < lanes; l++)
+        {
+            ca[l] *= ta[l];
+            cb[l] *= tb[l] * sign[l];
+        }
+        for (std::size_t l = 0; l < lanes; l++)
+        {
+            T rx = ax[l] * ca[l] + bx[l] * cb[l];
+            T ry = ay[l] * ca[l] + by[l] * cb[l];
+            T rz = az[l] * ca[l] + bz[l] * cb[l];
+            T rw = aw[l] * ca[l] + bw[l] * cb[l];
+            ox[l] = rx;
+            oy[l] = ry;
+            oz[l] = rz;
+            ow[l] = rw;
+        }
+    }
+
+    /**
+     * Nlerp of one block of lanes elements given by component arrays,
+     * outputs may alias inputs
+     */
+    static inline void nlerp_block(const T *ax, const T *ay, const T *az,
+                                   const T *aw, const T *bx, const T *by,
+                                   const T *bz, const T *bw, const T *t,
+                                   T *ox, T *oy, T *oz, T *ow)
+    {
+        for (std::size_t l = 0; l < lanes; l++)
+        {
+            T d = ax[l] * bx[l] + ay[l] * by[l] + az[l] * bz[l] + aw[l] * bw[l];
+            T ca = T(1) - t[l];
+            T cb = d < T(0) ? -t[l] : t[l];
+            T rx = ax[l] * ca + bx[l] * cb;
+            T ry = ay[l] * ca + by[l] * cb;
+            T rz = az[l] * ca + bz[l] * cb;
+            T rw = aw[l] * ca + bw[l] * cb;
+            T n = rx * rx + ry * ry + rz * rz + rw * rw;
+            T m = n > T(0) ? T(1) / std::sqrt(n) : T(0);
+            ox[l] = rx * m;
+            oy[l] = ry * m;
+            oz[l] = rz * m;
+            ow[l] = rw * m;
+        }
+    }
+
+private:
+    /**
+     * @return size of binary kernel result, out may alias operands as it
+     * only shrinks to it without reallocation
+     */
+    static inline std::size_t common_size(const quaternion_soa<T> &lhs,
+                                          const quaternion_soa<T> &rhs)
+    {
+        assert(lhs.size == rhs.size);
+        return lhs.size < rhs.size ? lhs.size : rhs.size;
+    }
+
+    /**
+     * Copy n factors of block, zero the rest
+     */
+    static inline void load_factors(const T *t, T *f, std::size_t n)
+    {
+        for (std::size_t l = 0; l < lanes; l++)
+            f[l] = l < n ? t[l] : T(0);
+    }
+};
+
+template<class T>
+const std::size_t quaternion_soa<T>::lanes;
+
+/**
+ * Blend n pairs of unit quaternion poses, out[i] = slerp(a[i], b[i], t[i]).
+ * Quaternions are gathered in blocks laid out across lanes and interpolated
+ * by the same kernel as quaternion_soa, out may be a or b. Results are
+ * within 2.9e-5 of unit length, see slerp() of quaternion.
+ */
+template<class T>
+inline void blend_poses(const quaternion<T> *a, const quaternion<T> *b,
+                        const T *t, quaternion<T> *out, std::size_t n)
+{
+    const std::size_t lanes = quaternion_soa<T>::lanes;
+    for (std::size_t i = 0; i < n; i += lanes)
+    {
+        std::size_t count = n - i < lanes ? n - i : lanes;
+        T ax[lanes], ay[lanes], az[lanes], aw[lanes];
+        T bx[lanes], by[lanes], bz[lanes], bw[lanes], f[lanes];
+        for (std::size_t l = 0; l < lanes; l++)
+        {
+            std::size_t k = i + (l < count ? l : 0);
+            ax[l] = a[k].v.x;
+            ay[l] = a[k].v.y;
+            az[l] = a[k].v.z;
+            aw[l] = a[k].w;
+            bx[l] = b[k].v.x;
+            by[l] = b[k].v.y;
+            bz[l] = b[k].v.z;
+            bw[l] = b[k].w;
+            f[l] = t[k];
+        }
+        quaternion_soa<T>::slerp_block(ax, ay, az, aw, bx, by, bz, bw, f,
+                                       ax, ay, az, aw);
+        for (std::size_t l = 0; l < count; l++)
+            out[i + l] = quaternion<T>(ax[l], ay[l], az[l], aw[l]);
+    }
+}
+
+typedef quaternion_soa<float> quaternionf_soa;
+typedef quaternion_soa<double> quaterniond_soa;
+typedef quaternion_soa<long double> quaternionld_soa;
+}
+
+#endif
@@ -0,0 +1,446 @@
+#ifndef _MATH_RAY_
+#define _MATH_RAY_
+
+#include <iostream>
+#include <cstddef>
+#include <type_traits>
+
+#include "simd.hpp"
+#include "vector.hpp"
+
+namespace math
+{
+/**
+ * Ray class, points origin + t * direction for t > 0
+ */
+template<class T>
+class ray
+{
+    typedef T type;
+
+public:
+    vector3<T> origin, direction;
+
+    /**
+     * Construct ray from zero along z
+     */
+    constexpr ray() :
+        origin(T(0)), direction(T(0), T(0), T(1))
+    {
+    }
+
+    /**
+     * Construct ray (origin, direction)
+     */
+    constexpr ray(const vector3<T> &origin, const vector3<T> &direction) :
+        origin(origin), direction(direction)
+    {
+    }
+
+    /**
+     * Set ray (origin, direction)
+     */
+    inline constexpr ray<T> &set(const vector3<T> &origin,
+                                 const vector3<T> &direction)
+    {
+        this->origin = origin;
+        this->direction = direction;
+        return *this;
+    }
+
+    /**
+     * @return point at distance t measured in direction lengths
+     */
+    inline constexpr vector3<T> get_point(T t) const
+    {
+        return origin + direction * t;
+    }
+
+    /**
+     * Two-sided Moller-Trumbore ray-triangle test
+     * @param t on input maximum distance, on output distance of hit
+     * @param u, v barycentric coordinates of hit, point is
+     * (1 - u - v) * v0 + u * v1 + v * v2
+     * @return true and updates t, u and v for hit closer than t
+     */
+    inline constexpr bool intersect(const vector3<T> &v0, const vector3<T> &v1,
+                                    const vector3<T> &v2,
+                                    T &t, T &u, T &v) const
+    {
+        vector3<T> e1 = v1 - v0, e2 = v2 - v0;
+        vector3<T> p = cross(direction, e2);
+        T det = dot(e1, p);
+        if (det == T(0))
+            return false;
+        T inv = T(1) / det;
+        vector3<T> s = origin - v0;
+        T nu = dot(s, p) * inv;
+        if (nu < T(0) || nu > T(1))
+            return false;
+        vector3<T> q = cross(s, e1);
+        T nv = dot(direction, q) * inv;
+        if (nv < T(0) || nu + nv > T(1))
+            return false;
+        T nt = dot(e2, q) * inv;
+        if (!(nt > T(0) && nt < t))
+            return false;
+        t = nt;
+        u = nu;
+        v = nv;
+        return true;
+    }
+
+    friend inline std::ostream &operator <<(std::ostream &lhs,
+                                            const ray<T> &rhs)
+    {
+        return lhs << "(" << rhs.origin << ", " << rhs.direction << ")";
+    }
+};
+
+/**
+ * Eight rays as structure of arrays
+ */
+template<class T>
+class alignas(32) ray_packet
+{
+    typedef T type;
+
+public:
+    static const std::size_t lanes = 8;
+
+    T ox[lanes], oy[lanes], oz[lanes];
+    T dx[lanes], dy[lanes], dz[lanes];
+
+    /**
+     * Set i ray
+     */
+    inline ray_packet<T> &set(std::size_t i, const ray<T> &r)
+    {
+        ox[i] = r.origin.x;
+        oy[i] = r.origin.y;
+        oz[i] = r.origin.z;
+        dx[i] = r.direction.x;
+        dy[i] = r.direction.y;
+        dz[i] = r.direction.z;
+        return *this;
+    }
+
+    /**
+     * Set packet from n rays, remaining lanes repeat the first one
+     */
+    inline ray_packet<T> &set(const ray<T> *r, std::size_t n)
+    {
+        for (std::size_t i = 0; i < lanes; i++)
+            set(i, r[i < n ? i : 0]);
+        return *this;
+    }
+
+    /**
+     * Explicit getter
+     * @return copy of i ray
+     */
+    inline ray<T> get(std::size_t i) const
+    {
+        return ray<T>(vector3<T>(ox[i], oy[i], oz[i]),
+                      vector3<T>(dx[i], dy[i], dz[i]));
+    }
+};
+
+template<class T>
+const std::size_t ray_packet<T>::lanes;
+
+/**
+ * Eight triangles as structure of arrays, unused lanes are degenerate and
+ * never hit
+ */
+template<class T>
+class alignas(32) triangle_packet
+{
+    typedef T type;
+
+public:
+    static const std::size_t lanes = 8;
+
+    T x0[lanes], y0[lanes], z0[lanes];
+    T x1[lanes], y1[lanes], z1[lanes];
+    T x2[lanes], y2[lanes], z2[lanes];
+
+    /**
+     * Set i triangle
+     */
+    inline triangle_packet<T> &set(std::size_t i, const vector3<T> &v0,
+                                   const vector3<T> &v1, const vector3<T> &v2)
+    {
+        x0[i] = v0.x;
+        y0[i] = v0.y;
+        z0[i] = v0.z;
+        x1[i] = v1.x;
+        y1[i] = v1.y;
+        z1[i] = v1.z;
+        x2[i] = v2.x;
+        y2[i] = v2.y;
+        z2[i] = v2.z;
+        return *this;
+    }
+
+    /**
+     * Set packet from n triangles (v[3 i], v[3 i + 1], v[3 i + 2]),
+     * remaining lanes are zero
+     */
+    inline triangle_packet<T> &set(const vector3<T> *v, std::size_t n)
+    {
+        const vector3<T> zero(T(0));
+        for (std::size_t i = 0; i < lanes; i++)
+            if (i < n)
+                set(i, v[3 * i], v[3 * i + 1], v[3 * i + 2]);
+            else
+                set(i, zero, zero, zero);
+        return *this;
+    }
+
+    /**
+     * Explicit getter of i triangle
+     */
+    inline void get(std::size_t i, vector3<T> &v0, vector3<T> &v1,
+                    vector3<T> &v2) const
+    {
+        v0.set(x0[i], y0[i], z0[i]);
+        v1.set(x1[i], y1[i], z1[i]);
+        v2.set(x2[i], y2[i], z2[i]);
+    }
+};
+
+template<class T>
+const std::size_t triangle_packet<T>::lanes;
+
+/**
+ * Eight-wide Moller-Trumbore kernels, generic version runs every lane of
+ * same arithmetic as ray::intersect() in plain loops
+ */
+template<class T>
+struct ray_kernel
+{
+    static const std::size_t lanes = 8;
+
+    /**
+     * Test one ray against eight triangles
+     * @return bit mask of lanes hit closer than t_max, hit distances and
+     * barycentrics of all lanes into t, u and v
+     */
+    static inline unsigned int intersect(const ray<T> &r,
+                                         const triangle_packet<T> &p,
+                                         T t_max, T *t, T *u, T *v)
+    {
+        const T ox = r.origin.x, oy = r.origin.y, oz = r.origin.z;
+        const T dx = r.direction.x, dy = r.direction.y, dz = r.direction.z;
+        unsigned int mask = 0;
+        for (std::size_t l = 0; l < lanes; l++)
+        {
+            T e1x = p.x1[l] - p.x0[l], e1y = p.y1[l] - p.y0[l];
+            T e1z = p.z1[l] - p.z0[l];
+            T e2x = p.x2[l] - p.x0[l], e2y = p.y2[l] - p.y0[l];
+            T e2z = p.z2[l] - p.z0[l];
+            T sx = ox - p.x0[l], sy = oy - p.y0[l], sz = oz - p.z0[l];
+            mask |= lane(dx, dy, dz, e1x, e1y, e1z, e2x, e2y, e2z,
+                         sx, sy, sz, t_max, t[l], u[l], v[l]) << l;
+        }
+        return mask;
+    }
+
+    /**
+     * Test eight rays against one triangle
+     * @param t on input maximum distances, lanes hit closer are updated
+     * together with u and v
+     * @return bit mask of updated lanes
+     */
+    static inline unsigned int intersect(const ray_packet<T> &r,
+                                         const vector3<T> &v0,
+                                         const vector3<T> &v1,
+                                         const vector3<T> &v2,
+                                         T *t, T *u, T *v)
+    {
+        const vector3<T> e1 = v1 - v0, e2 = v2 - v0;
+        unsigned int mask = 0;
+        for (std::size_t l = 0; l < lanes; l++)
+        {
+            T nt, nu, nv;
+            unsigned int hit = lane(r.dx[l], r.dy[l], r.dz[l],
+                                    e1.x, e1.y, e1.z, e2.x, e2.y, e2.z,
+                                    r.ox[l] - v0.x, r.oy[l] - v0.y,
+                                    r.oz[l] - v0.z, t[l], nt, nu, nv);
+            t[l] = hit ? nt : t[l];
+            u[l] = hit ? nu : u[l];
+            v[l] = hit ? nv : v[l];
+            mask |= hit << l;
+        }
+        return mask;
+    }
+
+private:
+    static inline unsigned int lane(T dx, T dy, T dz,
+                                    T e1x, T e1y, T e1z,
+                                    T e2x, T e2y, T e2z,
+                                    T sx, T sy, T sz, T t_max,
+                                    T &t, T &u, T &v)
+    {
+        T px = dy * e2z - dz * e2y;
+        T py = dz * e2x - dx * e2z;
+        T pz = dx * e2y - dy * e2x;
+        T det = e1x * px + e1y * py + e1z * pz;
+        T inv = T(1) / det;
+        T qx = sy * e1z - sz * e1y;
+        T qy = sz * e1x - sx * e1z;
+        T qz = sx * e1y - sy * e1x;
+        u = (sx * px + sy * py + sz * pz) * inv;
+        v = (dx * qx + dy * qy + dz * qz) * inv;
+        t = (e2x * qx + e2y * qy + e2z * qz) * inv;
+        return (det != T(0)) & (u >= T(0)) & (v >= T(0)) &
+               (u + v <= T(1)) & (t > T(0)) & (t < t_max);
+    }
+};
+
+template<class T>
+const std::size_t ray_kernel<T>::lanes;
+
+#ifdef MATH_AVX
+/**
+ * AVX specialization, eight lanes in one register
+ */
+template<>
+struct ray_kernel<float>
+{
+    static const std::size_t lanes = 8;
+
+    static inline unsigned int intersect(const ray<float> &r,
+                                         const triangle_packet<float> &p,
+                                         float t_max, float *t, float *u,
+                                         float *v)
+    {
+        __m256 x0 = _mm256_load_ps(p.x0), y0 = _mm256_load_ps(p.y0);
+        __m256 z0 = _mm256_load_ps(p.z0);
+        __m256 e1x = _mm256_sub_ps(_mm256_load_ps(p.x1), x0);
+        __m256 e1y = _mm256_sub_ps(_mm256_load_ps(p.y1), y0);
+        __m256 e1z = _mm256_sub_ps(_mm256_load_ps(p.z1), z0);
+        __m256 e2x = _mm256_sub_ps(_mm256_load_ps(p.x2), x0);
+        __m256 e2y = _mm256_sub_ps(_mm256_load_ps(p.y2), y0);
+        __m256 e2z = _mm256_sub_ps(_mm256_load_ps(p.z2), z0);
+        __m256 sx = _mm256_sub_ps(_mm256_set1_ps(r.origin.x), x0);
+        __m256 sy = _mm256_sub_ps(_mm256_set1_ps(r.origin.y), y0);
+        __m256 sz = _mm256_sub_ps(_mm256_set1_ps(r.origin.z), z0);
+        __m256 nt, nu, nv;
+        __m256 hit = lane(_mm256_set1_ps(r.direction.x),
+                          _mm256_set1_ps(r.direction.y),
+                          _mm256_set1_ps(r.direction.z),
+                          e1x, e1y, e1z, e2x, e2y, e2z, sx, sy, sz,
+                          _mm256_set1_ps(t_max), nt, nu, nv);
+        _mm256_storeu_ps(t, nt);
+        _mm256_storeu_ps(u, nu);
+        _mm256_storeu_ps(v, nv);
+        return _mm256_movemask_ps(hit);
+    }
+
+    static inline unsigned int intersect(const ray_packet<float> &r,
+                                         const vector3<float> &v0,
+                                         const vector3<float> &v1,
+                                         const vector3<float> &v2,
+                                         float *t, float *u, float *v)
+    {
+        __m256 x0 = _mm256_set1_ps(v0.x), y0 = _mm256_set1_ps(v0.y);
+        __m256 z0 = _mm256_set1_ps(v0.z);
+        __m256 t_max = _mm256_loadu_ps(t), nt, nu, nv;
+        __m256 hit = lane(_mm256_load_ps(r.dx), _mm256_load_ps(r.dy),
+                          _mm256_load_ps(r.dz),
+                          _mm256_set1_ps(v1.x - v0.x),
+                          _mm256_set1_ps(v1.y - v0.y),
+                          _mm256_set1_ps(v1.z - v0.z),
+                          _mm256_set1_ps(v2.x - v0.x),
+                          _mm256_set1_ps(v2.y - v0.y),
+                          _mm256_set1_ps(v2.z - v0.z),
+                          _mm256_sub_ps(_mm256_load_ps(r.ox), x0),
+                          _mm256_sub_ps(_mm256_load_ps(r.oy), y0),
+                          _mm256_sub_ps(_mm256_load_ps(r.oz), z0),
+                          t_max, nt, nu, nv);
+        _mm256_storeu_ps(t, _mm256_blendv_ps(t_max, nt, hit));
+        _mm256_storeu_ps(u, _mm256_blendv_ps(_mm256_loadu_ps(u), nu, hit));
+        _mm256_storeu_ps(v, _mm256_blendv_ps(_mm256_loadu_ps(v), nv, hit));
+        return _mm256_movemask_ps(hit);
+    }
+
+private:
+    static inline __m256 lane(__m256 dx, __m256 dy, __m256 dz,
+                              __m256 e1x, __m256 e1y, __m256 e1z,
+                              __m256 e2x, __m256 e2y, __m256 e2z,
+                              __m256 sx, __m256 sy, __m256 sz, __m256 t_max,
+                              __m256 &t, __m256 &u, __m256 &v)
+    {
+        __m256 px = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+        __m256 py = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+        __m256 pz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+        __m256 det = dot(e1x, e1y, e1z, px, py, pz);
+        __m256 inv = _mm256_div_ps(_mm256_set1_ps(1.0f), det);
+        __m256 qx = _mm256_sub_ps(_mm256_mul_ps(sy, e1z), _mm256_mul_ps(sz, e1y));
+        __m256 qy = _mm256_sub_ps(_mm256_mul_ps(sz, e1x), _mm256_mul_ps(sx, e1z));
+        __m256 qz = _mm256_sub_ps(_mm256_mul_ps(sx, e1y), _mm256_mul_ps(sy, e1x));
+        u = _mm256_mul_ps(dot(sx, sy, sz, px, py, pz), inv);
+        v = _mm256_mul_ps(dot(dx, dy, dz, qx, qy, qz), inv);
+        t = _mm256_mul_ps(dot(e2x, e2y, e2z, qx, qy, qz), inv);
+        __m256 zero = _mm256_setzero_ps();
+        __m256 m = _mm256_cmp_ps(det, zero, _CMP_NEQ_UQ);
+        m = _mm256_and_ps(m, _mm256_cmp_ps(u, zero, _CMP_GE_OQ));
+        m = _mm256_and_ps(m, _mm256_cmp_ps(v, zero, _CMP_GE_OQ));
+        m = _mm256_and_ps(m, _mm256_cmp_ps(_mm256_add_ps(u, v),
+                                           _mm256_set1_ps(1.0f), _CMP_LE_OQ));
+        m = _mm256_and_ps(m, _mm256_cmp_ps(t, zero, _CMP_GT_OQ));
+        return _mm256_and_ps(m, _mm256_cmp_ps(t, t_max, _CMP_LT_OQ));
+    }
+
+    static inline __m256 dot(__m256 ax, __m256 ay, __m256 az,
+                             __m256 bx, __m256 by, __m256 bz)
+    {
+        return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax, bx),
+                                           _mm256_mul_ps(ay, by)),
+                             _mm256_mul_ps(az, bz));
+    }
+};
+#endif
+
+/**
+ * Test one ray against eight triangles, see ray_kernel
+ * @return bit mask of lanes hit closer than t_max
+ */
+template<class T>
+inline unsigned int intersect(const ray<T> &r, const triangle_packet<T> &p,
+                              T t_max, T *t, T *u, T *v)
+{
+    return ray_kernel<T>::intersect(r, p, t_max, t, u, v);
+}
+
+/**
+ * Test eight rays against one triangle, see ray_kernel
+ * @return bit mask of lanes updated with closer hit
+ */
+template<class T>
+inline unsigned int intersect(const ray_packet<T> &r, const vector3<T> &v0,
+                              const vector3<T> &v1, const vector3<T> &v2,
+                              T *t, T *u, T *v)
+{
+    return ray_kernel<T>::intersect(r, v0, v1, v2, t, u, v);
+}
+
+typedef ray<float> rayf;
+typedef ray<double> rayd;
+typedef ray<long double> rayld;
+
+typedef ray_packet<float> ray_packetf;
+typedef ray_packet<double> ray_packetd;
+typedef ray_packet<long double> ray_packetld;
+
+typedef triangle_packet<float> triangle_packetf;
+typedef triangle_packet<double> triangle_packetd;
+typedef triangle_packet<long double> triangle_packetld;
+
+static_assert(std::is_trivially_copyable<ray<double> >::value,
+              "ray must be trivially copyable");
+}
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef _MATH_SIMD_
+#define _MATH_SIMD_
+
+/**
+ * Instruction set detection for the SIMD specializations.
+ * Define MATH_NO_SIMD to force the generic scalar code.
+ */
+#ifndef MATH_NO_SIMD
+
+#if defined(__SSE__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define MATH_SSE 1
+#include <xmmintrin.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MATH_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX__)
+#define MATH_AVX 1
+#include <immintrin.h>
+#endif
+
+#endif
+
+#endif
@@ -0,0 +1,301 @@
+#ifndef _MATH_SKINNING_
+#define _MATH_SKINNING_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "simd.hpp"
+#include "vector.hpp"
+#include "matrix.hpp"
+#include "affine.hpp"
+#include "dual_quaternion.hpp"
+#include "thread_pool.hpp"
+
+namespace math
+{
+/**
+ * Linear blend skinning over vertex streams
+ *
+ * Every vertex has four influences, bones[4 * i + k] indexes the palette and
+ * weights[4 * i + k] is its weight. Unused influences must have zero weight
+ * and a valid bone index. Bone transforms are blended and applied to
+ * positions and, when not null, normals in one pass. Normals are transformed
+ * by blended linear part and are not renormalized. Outputs may be equal to
+ * inputs.
+ *
+ * Palette is either matrix4 for row vectors or packed 3x4 affine palette of
+ * 12 values per bone laid out as three columns of matrix4,
+ * palette[12 * b + 4 * j + i] = m(i, j), see pack_palette(). The packed
+ * palette reads 25% less memory per influence.
+ */
+template<class T>
+struct skin_kernel
+{
+    static const std::size_t lanes = 8;
+
+    static inline void run(const matrix4<T> *palette,
+                           const std::uint16_t *bones, const T *weights,
+                           const vector3<T> *positions,
+                           const vector3<T> *normals,
+                           vector3<T> *out_positions, vector3<T> *out_normals,
+                           std::size_t n)
+    {
+        run_lanes(palette, bones, weights, positions, normals,
+                  out_positions, out_normals, n);
+    }
+
+    static inline void run(const T *palette,
+                           const std::uint16_t *bones, const T *weights,
+                           const vector3<T> *positions,
+                           const vector3<T> *normals,
+                           vector3<T> *out_positions, vector3<T> *out_normals,
+                           std::size_t n)
+    {
+        run_lanes(palette, bones, weights, positions, normals,
+                  out_positions, out_normals, n);
+    }
+
+private:
+    static inline T get(const matrix4<T> *palette, std::size_t b,
+                        unsigned int i, unsigned int j)
+    {
+        return palette[b](i, j);
+    }
+
+    static inline T get(const T *palette, std::size_t b,
+                        unsigned int i, unsigned int j)
+    {
+        return palette[12 * b + 4 * j + i];
+    }
+
+    /**
+     * Blend 4x3 affine part of bones for a block of vertices, then transform
+     * the block across lanes
+     */
+    template<class P>
+    static inline void run_lanes(const P *palette,
+                                 const std::uint16_t *bones, const T *weights,
+                                 const vector3<T> *positions,
+                                 const vector3<T> *normals,
+                                 vector3<T> *out_positions,
+                                 vector3<T> *out_normals, std::size_t n)
+    {
+        for (std::size_t b = 0; b < n; b += lanes)
+        {
+            std::size_t count = n - b < lanes ? n - b : lanes;
+            T m[12][lanes];
+            for (std::size_t l = 0; l < lanes; l++)
+            {
+                std::size_t v = b + (l < count ? l : 0);
+                for (unsigned int c = 0; c < 12; c++)
+                    m[c][l] = T(0);
+                for (std::size_t k = 0; k < 4; k++)
+                {
+                    std::size_t bone = bones[4 * v + k];
+                    T w = weights[4 * v + k];
+                    for (unsigned int i = 0; i < 4; i++)
+                        for (unsigned int j = 0; j < 3; j++)
+                            m[3 * i + j][l] += w * get(palette, bone, i, j);
+                }
+            }
+            for (int pass = 0; pass < 2; pass++)
+            {
+                const vector3<T> *in = pass ? normals : positions;
+                vector3<T> *out = pass ? out_normals : out_positions;
+                if (!in)
+                    break;
+                T px[lanes], py[lanes], pz[lanes];
+                for (std::size_t l = 0; l < lanes; l++)
+                {
+                    const vector3<T> &p = in[b + (l < count ? l : 0)];
+                    px[l] = p.x;
+                    py[l] = p.y;
+                    pz[l] = p.z;
+                }
+                T s = pass ? T(0) : T(1);
+                for (std::size_t l = 0; l < lanes; l++)
+                {
+                    T x = px[l] * m[0][l] + py[l] * m[3][l] + pz[l] * m[6][l];
+                    T y = px[l] * m[1][l] + py[l] * m[4][l] + pz[l] * m[7][l];
+                    T z = px[l] * m[2][l] + py[l] * m[5][l] + pz[l] * m[8][l];
+                    px[l] = x + s * m[9][l];
+                    py[l] = y + s * m[10][l];
+                    pz[l] = z + s * m[11][l];
+                }
+                for (std::size_t l = 0; l < count; l++)
+                    out[b + l].set(px[l], py[l], pz[l]);
+            }
+        }
+    }
+};
+
+template<class T>
+const std::size_t skin_kernel<T>::lanes;
+
+#ifdef MATH_SSE2
+/**
+ * SSE specialization, bone rows or columns are blended in registers
+ */
+template<>
+struct skin_kernel<float>
+{
+    static inline void run(const matrix4<float> *palette,
+                           const std::uint16_t *bones, const float *weights,
+                           const vector3<float> *positions,
+                           const vector3<float> *normals,
+                           vector3<float> *out_positions,
+                           vector3<float> *out_normals, std::size_t n)
+    {
+        for (std::size_t v = 0; v < n; v++)
+        {
+            __m128 r0 = _mm_setzero_ps(), r1 = _mm_setzero_ps();
+            __m128 r2 = _mm_setzero_ps(), r3 = _mm_setzero_ps();
+            for (std::size_t k = 0; k < 4; k++)
+            {
+                const matrix4<float> &m = palette[bones[4 * v + k]];
+                __m128 w = _mm_set1_ps(weights[4 * v + k]);
+                r0 = _mm_add_ps(r0, _mm_mul_ps(w, m.get_row(0)));
+                r1 = _mm_add_ps(r1, _mm_mul_ps(w, m.get_row(1)));
+                r2 = _mm_add_ps(r2, _mm_mul_ps(w, m.get_row(2)));
+                r3 = _mm_add_ps(r3, _mm_mul_ps(w, m.get_row(3)));
+            }
+            transform(r0, r1, r2, r3, positions, normals,
+                      out_positions, out_normals, v);
+        }
+    }
+
+    static inline void run(const float *palette,
+                           const std::uint16_t *bones, const float *weights,
+                           const vector3<float> *positions,
+                           const vector3<float> *normals,
+                           vector3<float> *out_positions,
+                           vector3<float> *out_normals, std::size_t n)
+    {
+        for (std::size_t v = 0; v < n; v++)
+        {
+            __m128 r0 = _mm_setzero_ps(), r1 = _mm_setzero_ps();
+            __m128 r2 = _mm_setzero_ps(), r3 = _mm_setzero_ps();
+            for (std::size_t k = 0; k < 4; k++)
+            {
+                const float *m = palette + 12 * bones[4 * v + k];
+                __m128 w = _mm_set1_ps(weights[4 * v + k]);
+                r0 = _mm_add_ps(r0, _mm_mul_ps(w, _mm_loadu_ps(m)));
+                r1 = _mm_add_ps(r1, _mm_mul_ps(w, _mm_loadu_ps(m + 4)));
+                r2 = _mm_add_ps(r2, _mm_mul_ps(w, _mm_loadu_ps(m + 8)));
+            }
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+            transform(r0, r1, r2, r3, positions, normals,
+                      out_positions, out_normals, v);
+        }
+    }
+
+private:
+    static inline void transform(__m128 r0, __m128 r1, __m128 r2, __m128 r3,
+                                 const vector3<float> *positions,
+                                 const vector3<float> *normals,
+                                 vector3<float> *out_positions,
+                                 vector3<float> *out_normals, std::size_t v)
+    {
+        const vector3<float> &p = positions[v];
+        __m128 r = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.x), r0),
+                              _mm_mul_ps(_mm_set1_ps(p.y), r1));
+        r = _mm_add_ps(r, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.z), r2), r3));
+        if (normals)
+        {
+            const vector3<float> &q = normals[v];
+            __m128 s = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(q.x), r0),
+                                  _mm_mul_ps(_mm_set1_ps(q.y), r1));
+            s = _mm_add_ps(s, _mm_mul_ps(_mm_set1_ps(q.z), r2));
+            store(s, out_normals[v]);
+        }
+        store(r, out_positions[v]);
+    }
+
+    static inline void store(__m128 r, vector3<float> &v)
+    {
+        float *q = &v.x;
+        _mm_storel_pi(reinterpret_cast<__m64 *>(q), r);
+        _mm_store_ss(q + 2, _mm_movehl_ps(r, r));
+    }
+};
+#endif
+
+/**
+ * Pack n matrices into 3x4 affine palette of 12 values per bone
+ */
+template<class T>
+inline void pack_palette(const matrix4<T> *m, T *out, std::size_t n)
+{
+    for (std::size_t b = 0; b < n; b++)
+        for (unsigned int j = 0; j < 3; j++)
+            for (unsigned int i = 0; i < 4; i++)
+                out[12 * b + 4 * j + i] = m[b](i, j);
+}
+
+/**
+ * Pack n affine transforms into 3x4 affine palette of 12 values per bone
+ */
+template<class T>
+inline void pack_palette(const affine3<T> *m, T *out, std::size_t n)
+{
+    for (std::size_t b = 0; b < n; b++)
+        for (unsigned int j = 0; j < 3; j++)
+        {
+            for (unsigned int i = 0; i < 3; i++)
+                out[12 * b + 4 * j + i] = m[b].linear(i, j);
+            out[12 * b + 4 * j + 3] = m[b].translation[j];
+        }
+}
+
+/**
+ * Skin n vertices with matrix4 palette, see skin_kernel
+ */
+template<class T>
+inline void skin(const matrix4<T> *palette,
+                 const std::uint16_t *bones, const T *weights,
+                 const vector3<T> *positions, const vector3<T> *normals,
+                 vector3<T> *out_positions, vector3<T> *out_normals,
+                 std::size_t n)
+{
+    skin_kernel<T>::run(palette, bones, weights, positions, normals,
+                        out_positions, out_normals, n);
+}
+
+/**
+ * Skin n vertices with packed 3x4 affine palette, see skin_kernel
+ */
+template<class T>
+inline void skin(const T *palette,
+                 const std::uint16_t *bones, const T *weights,
+                 const vector3<T> *positions, const vector3<T> *normals,
+                 vector3<T> *out_positions, vector3<T> *out_normals,
+                 std::size_t n)
+{
+    skin_kernel<T>::run(palette, bones, weights, positions, normals,
+                        out_positions, out_normals, n);
+}
+
+/**
+ * Skin n vertices in chunks of at most chunk vertices on pool, palette is
+ * any palette accepted by skin(). Pool outlives frames, so per-frame calls
+ * start no threads.
+ */
+template<class P, class T>
+inline void skin_parallel(thread_pool &pool, const P *palette,
+                          const std::uint16_t *bones, const T *weights,
+                          const vector3<T> *positions,
+                          const vector3<T> *normals,
+                          vector3<T> *out_positions, vector3<T> *out_normals,
+                          std::size_t n, std::size_t chunk = 4096)
+{
+    pool.parallel_for(n, chunk, [&](std::size_t begin, std::size_t end)
+    {
+        skin(palette, bones + 4 * begin, weights + 4 * begin,
+             positions + begin, normals ? normals + begin : nullptr,
+             out_positions + begin, normals ? out_normals + begin : nullptr,
+             end - begin);
+    });
+}
+}
+
+#endif
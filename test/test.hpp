@@ -0,0 +1,30 @@
+#ifndef _MATH_TEST_
+#define _MATH_TEST_
+
+#include <cstdio>
+
+/**
+ * Minimal checks for test programs, failures are printed and counted, main
+ * returns test_result()
+ */
+static int test_failures = 0;
+
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+                        #condition); \
+            test_failures++; \
+        } \
+    } while (0)
+
+static inline int test_result()
+{
+    if (test_failures)
+        std::printf("%d checks failed\n", test_failures);
+    return test_failures ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,120 @@
+/**
+ * aabb and bsphere against brute force over points
+ */
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "bounds.hpp"
+#include "test.hpp"
+
+using namespace math;
+
+template<class T>
+static vector3<T> transform(const vector3<T> &p, const matrix4<T> &m)
+{
+    vector4<T> r = vector4<T>(p.x, p.y, p.z, T(1)) * m;
+    return vector3<T>(r.x, r.y, r.z);
+}
+
+template<class T>
+static bool inside(const bsphere<T> &s, const vector3<T> &p)
+{
+    return (p - s.center).norm() <= s.radius * T(1.0001) + T(1e-4);
+}
+
+template<class T>
+static bool inside(const aabb<T> &b, const vector3<T> &p)
+{
+    for (unsigned int i = 0; i < 3; i++)
+        if (p[i] < b.min[i] - T(1e-4) || p[i] > b.max[i] + T(1e-4))
+            return false;
+    return true;
+}
+
+template<class T>
+static void test()
+{
+    std::mt19937 g(1);
+    std::uniform_real_distribution<double> d(-1.0, 1.0);
+    auto r = [&]() { return T(d(g)); };
+
+    std::vector<vector3<T> > p(10000);
+    for (std::size_t i = 0; i < p.size(); i++)
+        p[i].set(r() * T(3), r() + T(2), r() * T(0.5));
+    aabb<T> box(p.data(), p.size());
+    bsphere<T> sphere(p.data(), p.size());
+    CHECK(aabb<T>().set_parallel(p.data(), p.size(), 1000) == box);
+    bsphere<T> parallel;
+    parallel.set_parallel(p.data(), p.size(), 1000);
+    CHECK(std::abs(parallel.radius - sphere.radius) <= T(1e-5));
+    for (std::size_t i = 0; i < p.size(); i++)
+    {
+        CHECK(inside(box, p[i]));
+        CHECK(inside(sphere, p[i]));
+    }
+
+    // matrices whose longest row or column underestimates spectral norm
+    T h = std::sqrt(T(0.5));
+    matrix4<T> rz(h, h, T(0), T(0),
+                  -h, h, T(0), T(0),
+                  T(0), T(0), T(1), T(0),
+                  T(0), T(0), T(0), T(1));
+    matrix4<T> scale;
+    scale(0, 0) = T(2);
+    std::vector<matrix4<T> > m;
+    m.push_back(matrix4<T>(T(1), T(1), T(0), T(0),
+                           T(1), T(1), T(0), T(0),
+                           T(0), T(0), T(1), T(0),
+                           T(1), T(2), T(3), T(1)));
+    m.push_back(rz.get_transpose() * scale * rz);
+    m.push_back(scale * rz);
+    m.push_back(rz * scale);
+    for (std::size_t i = 0; i < 20; i++)
+    {
+        matrix4<T> n;
+        for (unsigned int k = 0; k < 12; k++)
+            n(k / 3, k % 3) = r() * T(2);
+        m.push_back(n);
+    }
+
+    bsphere<T> unit(vector3<T>(T(0.5), T(-1), T(2)), T(1.5));
+    std::vector<vector3<T> > surface;
+    for (unsigned int k = 0; k < 27; k++)
+        if (k != 13)
+            surface.push_back(vector3<T>(T(k % 3) - T(1), T(k / 3 % 3) - T(1),
+                                         T(k / 9) - T(1)));
+    for (std::size_t i = 0; i < 2000; i++)
+        surface.push_back(vector3<T>(r(), r(), r()));
+    for (std::size_t i = 0; i < surface.size(); i++)
+        surface[i] = unit.center + surface[i].normalize() * unit.radius;
+
+    for (std::size_t i = 0; i < m.size(); i++)
+    {
+        bsphere<T> s = unit.get_transform(m[i]);
+        aabb<T> b = box.get_transform(m[i]);
+        for (std::size_t k = 0; k < surface.size(); k++)
+            CHECK(inside(s, transform(surface[k], m[i])));
+        for (unsigned int k = 0; k < 8; k++)
+        {
+            vector3<T> c(k & 1 ? box.max.x : box.min.x,
+                         k & 2 ? box.max.y : box.min.y,
+                         k & 4 ? box.max.z : box.min.z);
+            CHECK(inside(b, transform(c, m[i])));
+        }
+    }
+
+    // axis scale stays exact
+    matrix4<T> axis;
+    axis(0, 0) = T(2);
+    axis(1, 1) = T(-3);
+    axis(2, 2) = T(0.5);
+    CHECK(std::abs(unit.get_transform(axis).radius - T(4.5)) <= T(1e-5));
+}
+
+int main()
+{
+    test<float>();
+    test<double>();
+    return test_result();
+}
@@ -0,0 +1,121 @@
+/**
+ * bvh queries against brute force over all triangles
+ */
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "bvh.hpp"
+#include "test.hpp"
+
+using namespace math;
+
+template<class T>
+static bool brute_intersect(const std::vector<vector3<T> > &v, const ray<T> &r,
+                            T &t)
+{
+    bool hit = false;
+    for (std::size_t i = 0; i < v.size(); i += 3)
+    {
+        T u, w;
+        hit |= r.intersect(v[i], v[i + 1], v[i + 2], t, u, w);
+    }
+    return hit;
+}
+
+template<class T>
+static void check_ray(const bvh<T> &tree, const std::vector<vector3<T> > &v,
+                      const ray<T> &r, std::size_t &hits)
+{
+    T bt = T(1e30), t = T(1e30), u, w;
+    std::uint32_t id;
+    bool expected = brute_intersect(v, r, bt);
+    bool hit = tree.intersect(r, t, u, w, id);
+    CHECK(hit == expected);
+    CHECK(tree.occluded(r, T(1e30)) == expected);
+    if (hit && expected)
+    {
+        CHECK(std::abs(t - bt) <= T(1e-4) * (T(1) + bt));
+        T it = T(1e30);
+        r.intersect(v[3 * id], v[3 * id + 1], v[3 * id + 2], it, u, w);
+        CHECK(std::abs(it - t) <= T(1e-4) * (T(1) + t));
+    }
+    hits += expected;
+}
+
+template<class T>
+static void test()
+{
+    std::mt19937 g(1);
+    std::uniform_real_distribution<double> d(0.0, 1.0);
+    auto r = [&]() { return T(d(g)); };
+
+    std::vector<vector3<T> > v;
+    for (std::size_t i = 0; i < 2000; i++)
+    {
+        vector3<T> c(r() * T(10), r() * T(10), r() * T(10));
+        for (unsigned int k = 0; k < 3; k++)
+            v.push_back(c + vector3<T>(r() - T(0.5), r() - T(0.5),
+                                       r() - T(0.5)));
+    }
+    bvh<T> tree(v.data(), v.size() / 3);
+
+    std::size_t hits = 0;
+    for (std::size_t i = 0; i < 500; i++)
+    {
+        vector3<T> o(r() * T(12) - T(1), r() * T(12) - T(1),
+                     r() * T(12) - T(1));
+        vector3<T> dir(r() - T(0.5), r() - T(0.5), r() - T(0.5));
+        check_ray(tree, v, ray<T>(o, dir), hits);
+    }
+
+    // axis directions with every combination of signed zeros, e.g.
+    // -vector3(0, 1, 0) is (-0, -1, -0)
+    std::size_t axis_hits = 0;
+    for (unsigned int axis = 0; axis < 3; axis++)
+        for (unsigned int signs = 0; signs < 16; signs++)
+        {
+            vector3<T> dir(signs & 1 ? T(-0.0) : T(0.0),
+                           signs & 2 ? T(-0.0) : T(0.0),
+                           signs & 4 ? T(-0.0) : T(0.0));
+            T one = signs & 8 ? T(-1) : T(1);
+            (axis == 0 ? dir.x : axis == 1 ? dir.y : dir.z) = one;
+            for (std::size_t i = 0; i < 100; i++)
+            {
+                vector3<T> o(r() * T(10), r() * T(10), r() * T(10));
+                T s = one < T(0) ? T(11) : T(-1);
+                (axis == 0 ? o.x : axis == 1 ? o.y : o.z) = s;
+                check_ray(tree, v, ray<T>(o, dir), axis_hits);
+            }
+        }
+    CHECK(hits > 0);
+    CHECK(axis_hits > 0);
+
+    for (std::size_t i = 0; i < 100; i++)
+    {
+        vector3<T> c(r() * T(10), r() * T(10), r() * T(10));
+        vector3<T> e(r(), r(), r());
+        aabb<T> box(c - e, c + e);
+        std::vector<std::uint32_t> ids;
+        tree.overlap(box, ids);
+        std::vector<bool> found(v.size() / 3, false);
+        for (std::size_t k = 0; k < ids.size(); k++)
+            found[ids[k]] = true;
+        std::size_t expected = 0;
+        for (std::size_t k = 0; k < v.size() / 3; k++)
+        {
+            bool o = aabb<T>(&v[3 * k], 3).overlaps(box);
+            CHECK(found[k] == o);
+            expected += o;
+        }
+        CHECK(ids.size() == expected);
+    }
+}
+
+int main()
+{
+    test<float>();
+    test<double>();
+    return test_result();
+}
@@ -0,0 +1,80 @@
+/**
+ * Batch kernels of every level available on host against scalar level, for
+ * tails of every length and in place
+ */
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "dispatch.hpp"
+#include "test.hpp"
+
+using namespace math;
+
+static bool close(const std::vector<vector3<float> > &lhs,
+                  const std::vector<vector3<float> > &rhs, float tolerance)
+{
+    for (std::size_t i = 0; i < lhs.size(); i++)
+        for (unsigned int k = 0; k < 3; k++)
+            if (!(std::abs(lhs[i][k] - rhs[i][k]) <=
+                  tolerance * (1.0f + std::abs(rhs[i][k]))))
+                return false;
+    return true;
+}
+
+int main()
+{
+    std::mt19937 g(1);
+    std::uniform_real_distribution<float> d(-1.0f, 1.0f);
+    const std::size_t size = 100, guard = 20;
+    std::vector<vector3<float> > in(size + guard);
+    for (std::size_t i = 0; i < in.size(); i++)
+        in[i].set(d(g) * 10.0f, d(g) * 10.0f, d(g) * 10.0f + 0.5f);
+    matrix4<float> m;
+    for (unsigned int i = 0; i < 4; i++)
+        for (unsigned int j = 0; j < 3; j++)
+            m(i, j) = d(g) * 2.0f;
+
+    const vector3<float> mark(7.0f, -7.0f, 77.0f);
+    batch_kernels scalar(isa_scalar);
+    CHECK(scalar.get_level() == isa_scalar);
+    for (int l = isa_scalar; l <= get_cpu_isa(); l++)
+    {
+        batch_kernels k{isa(l)};
+        CHECK(k.get_level() == isa(l));
+        for (std::size_t n = 0; n <= size; n++)
+        {
+            for (unsigned int op = 0; op < 3; op++)
+            {
+                std::vector<vector3<float> > a(size + guard, mark), b = a;
+                std::vector<vector3<float> > c(in);
+                auto run = [&](const batch_kernels &q,
+                               const vector3<float> *src, vector3<float> *dst)
+                {
+                    if (op == 0)
+                        q.transform_points(m, src, dst, n);
+                    else if (op == 1)
+                        q.transform_directions(m, src, dst, n);
+                    else
+                        q.normalize_fast(src, dst, n);
+                };
+                run(scalar, in.data(), a.data());
+                run(k, in.data(), b.data());
+                run(k, c.data(), c.data());
+                float tolerance = op == 2 ? 2e-6f : 1e-5f;
+                std::vector<vector3<float> > ea(a.begin(), a.begin() + n);
+                std::vector<vector3<float> > eb(b.begin(), b.begin() + n);
+                std::vector<vector3<float> > ec(c.begin(), c.begin() + n);
+                CHECK(close(eb, ea, tolerance));
+                CHECK(close(ec, ea, tolerance));
+
+                // nothing past n is written
+                bool untouched = true;
+                for (std::size_t i = n; i < b.size(); i++)
+                    untouched = untouched && b[i] == mark && c[i] == in[i];
+                CHECK(untouched);
+            }
+        }
+    }
+    return test_result();
+}
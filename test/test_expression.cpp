@@ -0,0 +1,81 @@
+/**
+ * Batch expressions against element-wise evaluation, destination aliasing
+ * an operand included
+ */
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "expression.hpp"
+#include "test.hpp"
+
+using namespace math;
+
+template<class T>
+static bool equal(const vector3<T> &lhs, const vector3<T> &rhs)
+{
+    return (lhs - rhs).norm() <= T(1e-4);
+}
+
+template<class T>
+static void test()
+{
+    std::mt19937 g(1);
+    std::uniform_real_distribution<double> d(-1.0, 1.0);
+    auto r = [&]() { return vector3<T>(T(d(g)), T(d(g)), T(d(g))); };
+
+    const std::size_t sizes[] = {1, 3, 16, 100, 1000};
+    for (std::size_t n : sizes)
+    {
+        std::vector<vector3<T> > pa(n), pb(n), pc(n);
+        for (std::size_t i = 0; i < n; i++)
+        {
+            pa[i] = r();
+            pb[i] = r();
+            pc[i] = r();
+        }
+        vector3_soa<T> a(pa.data(), n), b(pb.data(), n), c(pc.data(), n);
+        vector3<T> v = r();
+        T s = T(1.5);
+
+        // destination grows from empty
+        vector3_soa<T> out;
+        assign(out, lazy(a) + lazy(b) * s - lazy(v));
+        CHECK(out.get_size() == n);
+        for (std::size_t i = 0; i < n; i++)
+            CHECK(equal(out[i], pa[i] + pb[i] * s - v));
+        for (std::size_t i = n; i < out.get_capacity(); i++)
+            CHECK(out.get_x()[i] == T(0) && out.get_y()[i] == T(0) &&
+                  out.get_z()[i] == T(0));
+
+        // destination shrinks
+        vector3_soa<T> large(2 * n + 5);
+        assign(large, lazy(b) - lazy(c) / s);
+        CHECK(large.get_size() == n);
+        for (std::size_t i = 0; i < n; i++)
+            CHECK(equal(large[i], pb[i] - pc[i] / s));
+
+        // destination is operand
+        assign(a, lazy(a) + lazy(b) - lazy(a) * s + lazy(c));
+        CHECK(a.get_size() == n);
+        for (std::size_t i = 0; i < n; i++)
+            CHECK(equal(a[i], pa[i] + pb[i] - pa[i] * s + pc[i]));
+
+        // broadcast only keeps size of destination
+        assign(b, -lazy(v));
+        CHECK(b.get_size() == n);
+        for (std::size_t i = 0; i < n; i++)
+            CHECK(equal(b[i], -v));
+    }
+
+    vector3<T> x = r(), y = r(), z;
+    assign(z, lazy(x) * T(2) - lazy(y));
+    CHECK(equal(z, x * T(2) - y));
+}
+
+int main()
+{
+    test<float>();
+    test<double>();
+    return test_result();
+}
@@ -0,0 +1,120 @@
+/**
+ * Parallel hierarchy update against serial update and brute force over
+ * random hierarchies
+ */
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "hierarchy.hpp"
+#include "test.hpp"
+
+using namespace math;
+
+template<class T>
+static bool equal(const matrix4<T> &lhs, const matrix4<T> &rhs)
+{
+    for (unsigned int i = 0; i < 16; i++)
+        if (lhs[i] != rhs[i])
+            return false;
+    return true;
+}
+
+template<class T>
+static void compare(const hierarchy<T> &serial, const hierarchy<T> &parallel,
+                    std::size_t serial_count, std::size_t parallel_count)
+{
+    CHECK(serial_count == parallel_count);
+    std::size_t changed = 0, wrong = 0;
+    for (std::uint32_t i = 0; i < serial.get_size(); i++)
+    {
+        std::uint32_t p = serial.get_parent(i);
+        matrix4<T> world = p == hierarchy<T>::invalid ?
+            serial.get_local(i) : serial.get_local(i) * serial.get_world(p);
+        wrong += !equal(serial.get_world(i), parallel.get_world(i)) ||
+                 !equal(serial.get_world(i), world) ||
+                 serial.is_changed(i) != parallel.is_changed(i);
+        changed += serial.is_changed(i);
+    }
+    CHECK(!wrong);
+    CHECK(changed == serial_count);
+    CHECK(!serial.is_dirty() && !parallel.is_dirty());
+}
+
+template<class T>
+static void test(thread_pool &pool, std::size_t grain)
+{
+    std::mt19937 g(1);
+    std::uniform_real_distribution<double> d(-1.0, 1.0);
+    auto r = [&]() { return T(d(g)); };
+    auto local = [&](hierarchy<T> &h, std::uint32_t i)
+    {
+        vector3<T> t(r(), r(), r()), s(r() + T(2), r() + T(2), r() + T(2));
+        quaternion<T> q(vector3<T>(r(), r(), r()), r() + T(2));
+        h.set_local(i, t, q.normalize(), s);
+    };
+
+    hierarchy<T> serial, parallel;
+    for (unsigned int round = 0; round < 8; round++)
+    {
+        // grow, deep chains and wide levels both appear
+        std::size_t n = serial.get_size(), add = round % 2 ? 300 : 2000;
+        for (std::size_t k = 0; k < add; k++)
+        {
+            std::uint32_t p = hierarchy<T>::invalid;
+            if (n + k > 0 && g() % 16)
+                p = g() % 4 ? std::uint32_t(n + k - 1 - g() % 8 % (n + k)) :
+                              std::uint32_t(g() % (n + k));
+            std::uint32_t i = serial.add(p);
+            CHECK(parallel.add(p) == i);
+            local(serial, i);
+        }
+        // dirty random nodes, parallel copy takes all locals
+        for (std::size_t k = 0; k < serial.get_size() / (round + 2); k++)
+        {
+            std::uint32_t i = std::uint32_t(g() % serial.get_size());
+            local(serial, i);
+        }
+        for (std::uint32_t i = 0; i < serial.get_size(); i++)
+            parallel.set_local(i, serial.get_translation(i),
+                               serial.get_rotation(i), serial.get_scale(i));
+        // parallel copy is all dirty, bring it level with serial first
+        parallel.update(pool, grain);
+        serial.update();
+        for (std::uint32_t i = 0; i < serial.get_size(); i++)
+            CHECK(equal(serial.get_world(i), parallel.get_world(i)));
+
+        // now dirty same nodes in both
+        for (std::size_t k = 0; k < 1 + round * 37; k++)
+        {
+            std::uint32_t i = std::uint32_t(g() % serial.get_size());
+            parallel.set_scale(i, serial.get_scale(i) * T(1.5));
+            serial.set_scale(i, serial.get_scale(i) * T(1.5));
+        }
+        std::size_t s = serial.update();
+        std::size_t p = parallel.update(pool, grain);
+        compare(serial, parallel, s, p);
+
+        // clean update recomputes nothing
+        s = serial.update();
+        p = parallel.update(pool, grain);
+        compare(serial, parallel, s, p);
+        CHECK(s == 0);
+    }
+}
+
+int main()
+{
+    const std::size_t threads[] = {1, 2, 3, 4};
+    const std::size_t grains[] = {1, 7, 64, 4096};
+    for (std::size_t t : threads)
+    {
+        thread_pool pool(t);
+        for (std::size_t grain : grains)
+        {
+            test<float>(pool, grain);
+            test<double>(pool, grain);
+        }
+    }
+    return test_result();
+}
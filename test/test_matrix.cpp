@@ -0,0 +1,90 @@
+/**
+ * Batch solve against row vector product, solve(m, x * m) gives back x
+ */
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "matrix.hpp"
+#include "test.hpp"
+
+using namespace math;
+
+template<std::size_t N, class T>
+static bool equal(const vector<N, T> &lhs, const vector<N, T> &rhs)
+{
+    return (lhs - rhs).norm() <= T(1e3) * std::numeric_limits<T>::epsilon();
+}
+
+template<std::size_t N, class T>
+static void test_solve(std::mt19937 &g)
+{
+    typedef matrix<N, N, T> M;
+    typedef vector<N, T> V;
+    std::uniform_real_distribution<double> d(-1.0, 1.0);
+    const std::size_t n = 37;
+    std::vector<M> m(n);
+    std::vector<V> x(n), b(n), out(n);
+    for (std::size_t i = 0; i < n; i++)
+    {
+        // dominant diagonal keeps matrices away from singular, zero corner
+        // of every third matrix forces a pivot exchange
+        for (unsigned int r = 0; r < N; r++)
+            for (unsigned int c = 0; c < N; c++)
+                m[i](r, c) = T(d(g) * 2.0) + (r == c ? T(4) : T(0));
+        if (i % 3 == 0)
+            m[i](0, 0) = T(0);
+        for (unsigned int k = 0; k < N; k++)
+            x[i][k] = T(d(g));
+        b[i] = x[i] * m[i];
+    }
+    solve(m.data(), b.data(), out.data(), n);
+    for (std::size_t i = 0; i < n; i++)
+        CHECK(equal(out[i], x[i]));
+    solve(m.data(), b.data(), b.data(), n);
+    for (std::size_t i = 0; i < n; i++)
+        CHECK(equal(b[i], x[i]));
+}
+
+/**
+ * matrix4 transpose() is const and returns copy, other square sizes
+ * transpose in place
+ */
+template<class T>
+static void test_transpose()
+{
+    const matrix4<T> m(T(1), T(2), T(3), T(4),
+                       T(5), T(6), T(7), T(8),
+                       T(9), T(10), T(11), T(12),
+                       T(13), T(14), T(15), T(16));
+    matrix4<T> t = m.transpose();
+    CHECK(m(0, 1) == T(2) && m(1, 0) == T(5));
+    CHECK(t == m.get_transpose());
+    for (unsigned int r = 0; r < 4; r++)
+        for (unsigned int c = 0; c < 4; c++)
+            CHECK(t(r, c) == m(c, r));
+
+    matrix3<T> n(T(1), T(2), T(3),
+                 T(4), T(5), T(6),
+                 T(7), T(8), T(9));
+    matrix3<T> u = n.get_transpose();
+    CHECK(&n.transpose() == &n);
+    CHECK(n == u && n(0, 1) == T(4) && n(1, 0) == T(2));
+}
+
+template<class T>
+static void test()
+{
+    std::mt19937 g(1);
+    test_solve<3, T>(g);
+    test_solve<4, T>(g);
+    test_transpose<T>();
+}
+
+int main()
+{
+    test<float>();
+    test<double>();
+    return test_result();
+}
@@ -0,0 +1,86 @@
+/**
+ * Closed-form inverses of camera matrices against products with direct
+ * matrices, and depth range of projections
+ */
+#include <cmath>
+#include <limits>
+
+#include "projection.hpp"
+#include "test.hpp"
+
+using namespace math;
+
+template<class T>
+static bool identity(const matrix4<T> &m)
+{
+    const T tolerance = T(64) * std::numeric_limits<T>::epsilon();
+    for (unsigned int i = 0; i < 4; i++)
+        for (unsigned int j = 0; j < 4; j++)
+            if (!(std::abs(m(i, j) - (i == j ? T(1) : T(0))) <= tolerance))
+                return false;
+    return true;
+}
+
+template<class T>
+static bool inverse(const inverse_pair<T> &p)
+{
+    return identity(p.direct * p.inverse) && identity(p.inverse * p.direct);
+}
+
+/**
+ * @return clip depth z / w of view space point at distance d
+ */
+template<class T>
+static T depth(const inverse_pair<T> &p, T d)
+{
+    vector4<T> c = vector4<T>(T(0.3), T(-0.2), -d, T(1)) * p.direct;
+    return c.z / c.w;
+}
+
+template<class T>
+static bool near(T lhs, T rhs)
+{
+    return std::abs(lhs - rhs) <= T(1e-4);
+}
+
+template<class T>
+static void test()
+{
+    const bool ranges[] = {false, true};
+    for (bool zero_to_one : ranges)
+    {
+        T low = zero_to_one ? T(0) : T(-1);
+
+        inverse_pair<T> p = perspective(T(1.1), T(16) / T(9), T(0.5), T(50),
+                                        zero_to_one);
+        CHECK(inverse(p));
+        CHECK(near(depth(p, T(0.5)), low) && near(depth(p, T(50)), T(1)));
+
+        inverse_pair<T> o = ortho(T(-3), T(5), T(-2), T(4), T(1), T(20),
+                                  zero_to_one);
+        CHECK(inverse(o));
+        CHECK(near(depth(o, T(1)), low) && near(depth(o, T(20)), T(1)));
+    }
+
+    inverse_pair<T> z = infinite_reverse_z(T(0.9), T(1.5), T(0.1));
+    CHECK(inverse(z));
+    CHECK(near(depth(z, T(0.1)), T(1)) && depth(z, T(1e6)) < T(1e-6) &&
+          depth(z, T(1e6)) > T(0));
+
+    inverse_pair<T> v = look_at(vector3<T>(T(1), T(2), T(3)),
+                                vector3<T>(T(-2), T(0.5), T(-1)),
+                                vector3<T>(T(0), T(1), T(0)));
+    CHECK(inverse(v));
+    vector4<T> target = vector4<T>(T(-2), T(0.5), T(-1), T(1)) * v.direct;
+    CHECK(near(target.x, T(0)) && near(target.y, T(0)) && target.z < T(0));
+
+    inverse_pair<T> c = v * perspective(T(1.1), T(1), T(0.5), T(50));
+    CHECK(inverse(c));
+}
+
+int main()
+{
+    test<float>();
+    test<double>();
+    return test_result();
+}
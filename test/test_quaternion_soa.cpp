@@ -0,0 +1,75 @@
+/**
+ * quaternion_soa kernels against quaternion slerp and nlerp, output
+ * aliasing an operand included
+ */
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "quaternion_soa.hpp"
+#include "test.hpp"
+
+using namespace math;
+
+template<class T>
+static bool equal(const quaternion<T> &lhs, const quaternion<T> &rhs)
+{
+    return std::abs(dot(lhs - rhs, lhs - rhs)) <= T(1e-9);
+}
+
+template<class T>
+static void test()
+{
+    std::mt19937 g(1);
+    std::uniform_real_distribution<double> d(-1.0, 1.0);
+    auto r = [&]()
+    {
+        return quaternion<T>(T(d(g)), T(d(g)), T(d(g)), T(d(g))).normalize();
+    };
+
+    const std::size_t sizes[] = {1, 3, 16, 100, 1000};
+    for (std::size_t n : sizes)
+    {
+        std::vector<quaternion<T> > pa(n), pb(n);
+        std::vector<T> t(n);
+        for (std::size_t i = 0; i < n; i++)
+        {
+            pa[i] = r();
+            pb[i] = r();
+            t[i] = T(d(g) * 0.5 + 0.5);
+        }
+        quaternion_soa<T> a(pa.data(), n), b(pb.data(), n), out;
+
+        slerp(a, b, t.data(), out);
+        CHECK(out.get_size() == n);
+        for (std::size_t i = 0; i < n; i++)
+        {
+            CHECK(equal(out[i], slerp(pa[i], pb[i], t[i])));
+            CHECK(std::abs(std::sqrt(dot(out[i], out[i])) - T(1)) <=
+                  T(2.9e-5) + T(4) * std::numeric_limits<T>::epsilon());
+        }
+        for (std::size_t i = n; i < out.get_capacity(); i++)
+            CHECK(out.get_x()[i] == T(0) && out.get_y()[i] == T(0) &&
+                  out.get_z()[i] == T(0) && out.get_w()[i] == T(0));
+
+        nlerp(a, b, t.data(), out);
+        for (std::size_t i = 0; i < n; i++)
+            CHECK(equal(out[i], nlerp(pa[i], pb[i], t[i])));
+
+        nlerp(a, b, t.data(), b);
+        for (std::size_t i = 0; i < n; i++)
+            CHECK(equal(b[i], nlerp(pa[i], pb[i], t[i])));
+
+        slerp(a, a, t.data(), a);
+        for (std::size_t i = 0; i < n; i++)
+            CHECK(equal(a[i], pa[i]));
+    }
+}
+
+int main()
+{
+    test<float>();
+    test<double>();
+    return test_result();
+}
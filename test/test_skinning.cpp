@@ -0,0 +1,100 @@
+/**
+ * Skinning on thread pool against brute-force blend of bone transforms
+ */
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "skinning.hpp"
+#include "test.hpp"
+
+using namespace math;
+
+template<class T>
+static bool equal(const vector3<T> &lhs, const vector3<T> &rhs)
+{
+    return (lhs - rhs).norm() <= T(1e-4) * (T(1) + rhs.norm());
+}
+
+template<class T>
+static void test(thread_pool &pool)
+{
+    std::mt19937 g(1);
+    std::uniform_real_distribution<double> d(-1.0, 1.0);
+    auto r = [&]() { return T(d(g)); };
+
+    const std::size_t bone_count = 40, n = 5003;
+    std::vector<matrix4<T> > palette(bone_count);
+    for (std::size_t b = 0; b < bone_count; b++)
+        for (unsigned int i = 0; i < 4; i++)
+            for (unsigned int j = 0; j < 3; j++)
+                palette[b](i, j) = r() + (i == j ? T(1) : T(0));
+    std::vector<T> packed(12 * bone_count);
+    pack_palette(palette.data(), packed.data(), bone_count);
+
+    std::vector<std::uint16_t> bones(4 * n);
+    std::vector<T> weights(4 * n);
+    std::vector<vector3<T> > p(n), q(n), expected_p(n), expected_q(n);
+    for (std::size_t i = 0; i < n; i++)
+    {
+        // some vertices use fewer than four influences
+        T sum = T(0);
+        for (unsigned int k = 0; k < 4; k++)
+        {
+            bones[4 * i + k] = std::uint16_t(g() % bone_count);
+            weights[4 * i + k] = k > i % 4 ? T(0) : r() + T(1.5);
+            sum += weights[4 * i + k];
+        }
+        for (unsigned int k = 0; k < 4; k++)
+            weights[4 * i + k] /= sum;
+        p[i].set(r() * T(10), r() * T(10), r() * T(10));
+        q[i].set(r(), r(), r());
+        vector4<T> sp(T(0)), sq(T(0));
+        for (unsigned int k = 0; k < 4; k++)
+        {
+            const matrix4<T> &m = palette[bones[4 * i + k]];
+            T w = weights[4 * i + k];
+            sp += vector4<T>(p[i].x, p[i].y, p[i].z, T(1)) * m * w;
+            sq += vector4<T>(q[i].x, q[i].y, q[i].z, T(0)) * m * w;
+        }
+        expected_p[i].set(sp.x, sp.y, sp.z);
+        expected_q[i].set(sq.x, sq.y, sq.z);
+    }
+
+    const std::size_t chunks[] = {1, 100, 4096};
+    for (std::size_t chunk : chunks)
+    {
+        std::vector<vector3<T> > op(n), oq(n);
+        skin_parallel(pool, palette.data(), bones.data(), weights.data(),
+                      p.data(), q.data(), op.data(), oq.data(), n, chunk);
+        std::size_t wrong = 0;
+        for (std::size_t i = 0; i < n; i++)
+            wrong += !equal(op[i], expected_p[i]) ||
+                     !equal(oq[i], expected_q[i]);
+        CHECK(!wrong);
+
+        // packed palette, no normals, in place
+        op = p;
+        skin_parallel(pool, packed.data(), bones.data(), weights.data(),
+                      op.data(), static_cast<const vector3<T> *>(nullptr),
+                      op.data(), static_cast<vector3<T> *>(nullptr), n,
+                      chunk);
+        wrong = 0;
+        for (std::size_t i = 0; i < n; i++)
+            wrong += !equal(op[i], expected_p[i]);
+        CHECK(!wrong);
+    }
+}
+
+int main()
+{
+    const std::size_t threads[] = {1, 2, 4};
+    for (std::size_t t : threads)
+    {
+        thread_pool pool(t);
+        test<float>(pool);
+        test<double>(pool);
+    }
+    return test_result();
+}
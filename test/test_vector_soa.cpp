@@ -0,0 +1,78 @@
+/**
+ * vector3_soa kernels against vector3 operations, output aliasing an
+ * operand included
+ */
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "vector_soa.hpp"
+#include "test.hpp"
+
+using namespace math;
+
+template<class T>
+static bool equal(const vector3<T> &lhs, const vector3<T> &rhs)
+{
+    return (lhs - rhs).norm() <= T(1e-4);
+}
+
+template<class T>
+static void test()
+{
+    std::mt19937 g(1);
+    std::uniform_real_distribution<double> d(-1.0, 1.0);
+    auto r = [&]() { return vector3<T>(T(d(g)), T(d(g)), T(d(g))); };
+
+    const std::size_t sizes[] = {1, 3, 16, 100, 1000};
+    for (std::size_t n : sizes)
+    {
+        std::vector<vector3<T> > pa(n), pb(n);
+        for (std::size_t i = 0; i < n; i++)
+        {
+            pa[i] = r();
+            pb[i] = r();
+        }
+        vector3_soa<T> a(pa.data(), n), b(pb.data(), n), out;
+
+        add(a, b, out);
+        CHECK(out.get_size() == n);
+        for (std::size_t i = 0; i < n; i++)
+            CHECK(equal(out[i], pa[i] + pb[i]));
+
+        sub(a, b, out);
+        for (std::size_t i = 0; i < n; i++)
+            CHECK(equal(out[i], pa[i] - pb[i]));
+
+        cross(a, b, out);
+        for (std::size_t i = 0; i < n; i++)
+            CHECK(equal(out[i], cross(pa[i], pb[i])));
+        for (std::size_t i = n; i < out.get_capacity(); i++)
+            CHECK(out.get_x()[i] == T(0) && out.get_y()[i] == T(0) &&
+                  out.get_z()[i] == T(0));
+
+        std::vector<T> s(n);
+        dot(a, b, s.data());
+        for (std::size_t i = 0; i < n; i++)
+            CHECK(std::abs(s[i] - dot(pa[i], pb[i])) <= T(1e-5));
+
+        vector3_soa<T> c = a;
+        c += b;
+        for (std::size_t i = 0; i < n; i++)
+            CHECK(equal(c[i], pa[i] + pb[i]));
+        c -= a;
+        for (std::size_t i = 0; i < n; i++)
+            CHECK(equal(c[i], pb[i]));
+
+        cross(a, b, a);
+        for (std::size_t i = 0; i < n; i++)
+            CHECK(equal(a[i], cross(pa[i], pb[i])));
+    }
+}
+
+int main()
+{
+    test<float>();
+    test<double>();
+    return test_result();
+}
@@ -0,0 +1,214 @@
+#ifndef _MATH_THREAD_POOL_
+#define _MATH_THREAD_POOL_
+
+#include <cstddef>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "aligned.hpp"
+
+namespace math
+{
+/**
+ * Work-stealing thread pool
+ *
+ * Every thread owns a queue of ranges. A thread splits its range in halves,
+ * pushes upper half to back of its queue and keeps lower half until range
+ * fits grain, then pops its own queue from back and, when empty, steals
+ * from front of other queues, so large ranges migrate to idle threads.
+ * Workers are started once and sleep while there is no work, unlike
+ * parallel_for() which starts threads on every call.
+ */
+class thread_pool
+{
+public:
+    /**
+     * Construct pool of threads, calling thread of parallel_for() included
+     */
+    explicit thread_pool(std::size_t threads =
+                             std::thread::hardware_concurrency()) :
+        size(threads ? threads : 1), queues(size), queued(0),
+        sleepers(0), stop(false)
+    {
+        workers.reserve(size - 1);
+        for (std::size_t i = 1; i < size; i++)
+            workers.emplace_back([this, i]() { work(i); });
+    }
+
+    thread_pool(const thread_pool &) = delete;
+    thread_pool &operator =(const thread_pool &) = delete;
+
+    ~thread_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleep);
+            stop = true;
+        }
+        wake.notify_all();
+        for (std::size_t i = 0; i < workers.size(); i++)
+            workers[i].join();
+    }
+
+    /**
+     * @return number of threads, calling thread included
+     */
+    inline std::size_t get_size() const
+    {
+        return size;
+    }
+
+    /**
+     * Call f(begin, end) for ranges of at most grain indices covering
+     * [0, n) and return when all of them are done
+     *
+     * f must be safe to call concurrently on disjoint ranges and must not
+     * throw or call parallel_for() of same pool. Calls from different
+     * threads are serialized.
+     */
+    template<class F>
+    inline void parallel_for(std::size_t n, std::size_t grain, F f)
+    {
+        if (!grain)
+            grain = 1;
+        if (size <= 1 || n <= grain)
+        {
+            for (std::size_t b = 0; b < n; b += grain)
+                f(b, n - b < grain ? n : b + grain);
+            return;
+        }
+        std::lock_guard<std::mutex> lock(call);
+        job j;
+        j.call = &invoke<F>;
+        j.f = &f;
+        j.grain = grain;
+        j.remaining.store(n);
+        push(0, task{&j, 0, n});
+        while (j.remaining.load(std::memory_order_acquire))
+        {
+            task t;
+            if (pop(0, t))
+                execute(0, t);
+            else
+                std::this_thread::yield();
+        }
+    }
+
+private:
+    struct job
+    {
+        void (*call)(const void *, std::size_t, std::size_t);
+        const void *f;
+        std::size_t grain;
+        std::atomic<std::size_t> remaining;
+    };
+
+    struct task
+    {
+        job *j;
+        std::size_t begin, end;
+    };
+
+    struct alignas(64) queue
+    {
+        std::mutex mutex;
+        std::deque<task> tasks;
+    };
+
+    std::size_t size;
+    std::vector<queue, aligned_allocator<queue> > queues;
+    std::vector<std::thread> workers;
+    std::atomic<std::size_t> queued;
+    std::atomic<std::size_t> sleepers;
+    std::mutex sleep, call;
+    std::condition_variable wake;
+    bool stop;
+
+    template<class F>
+    static inline void invoke(const void *f, std::size_t begin,
+                              std::size_t end)
+    {
+        (*static_cast<const F *>(f))(begin, end);
+    }
+
+    inline void push(std::size_t id, const task &t)
+    {
+        {
+            std::lock_guard<std::mutex> lock(queues[id].mutex);
+            queues[id].tasks.push_back(t);
+        }
+        queued.fetch_add(1);
+        if (sleepers.load())
+        {
+            {
+                std::lock_guard<std::mutex> lock(sleep);
+            }
+            wake.notify_one();
+        }
+    }
+
+    /**
+     * Pop back of own queue or steal front of other queue
+     */
+    inline bool pop(std::size_t id, task &t)
+    {
+        for (std::size_t k = 0; k < size; k++)
+        {
+            queue &q = queues[(id + k) % size];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (q.tasks.empty())
+                continue;
+            if (k)
+            {
+                t = q.tasks.front();
+                q.tasks.pop_front();
+            }
+            else
+            {
+                t = q.tasks.back();
+                q.tasks.pop_back();
+            }
+            queued.fetch_sub(1);
+            return true;
+        }
+        return false;
+    }
+
+    inline void execute(std::size_t id, task t)
+    {
+        job *j = t.j;
+        while (t.end - t.begin > j->grain)
+        {
+            std::size_t mid = t.begin + (t.end - t.begin) / 2;
+            push(id, task{j, mid, t.end});
+            t.end = mid;
+        }
+        j->call(j->f, t.begin, t.end);
+        j->remaining.fetch_sub(t.end - t.begin, std::memory_order_acq_rel);
+    }
+
+    inline void work(std::size_t id)
+    {
+        for (;;)
+        {
+            task t;
+            if (pop(id, t))
+            {
+                execute(id, t);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleep);
+            sleepers.fetch_add(1);
+            wake.wait(lock, [this]() { return stop || queued.load() > 0; });
+            sleepers.fetch_sub(1);
+            if (stop)
+                return;
+        }
+    }
+};
+}
+
+#endif
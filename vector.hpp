@@ -3,17 +3,92 @@
 
 #include <iostream>
 #include <cmath>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
 
 namespace math
 {
-template<class T> class vector3;
-template<class T> class vector4;
+template<std::size_t N, class T> class vector;
+
+template<class T> using vector2 = vector<2, T>;
+template<class T> using vector3 = vector<3, T>;
+template<class T> using vector4 = vector<4, T>;
+
+/**
+ * @return x, last step of unrolled_sum()
+ */
+template<class T>
+inline constexpr T unrolled_sum(T x)
+{
+    return x;
+}
+
+/**
+ * @return x + y + ... added left to right, reduces pack expanded over index
+ * sequence without loop
+ */
+template<class T, class... A>
+inline constexpr T unrolled_sum(T x, T y, A... z)
+{
+    return unrolled_sum(T(x + y), z...);
+}
+
+/**
+ * Reciprocal square root for normalize_fast()
+ *
+ * Generic version is exact 1 / sqrt(x), double has no hardware estimate
+ * worth refining. SSE specialization for float refines rsqrtps estimate by
+ * one Newton-Raphson step: relative error is below 2.5e-7 for positive
+ * finite x, lengths of normalize_fast() results are within 5e-7 of 1, zero
+ * and infinity give NaN. Batch normalize() runs four vectors per register
+ * and is about twice as fast as normalize() of single vectors, single calls
+ * gain only where sqrt and divide are slow.
+ */
+template<class T>
+struct rsqrt_kernel
+{
+    /**
+     * @return 1 / sqrt(x)
+     */
+    static inline T run(T x)
+    {
+        return T(1) / std::sqrt(x);
+    }
+
+    /**
+     * Set r[i] = 1 / sqrt(x[i]) for i < n, x and r may be equal
+     */
+    static inline void run(const T *x, T *r, std::size_t n)
+    {
+        for (std::size_t i = 0; i < n; i++)
+            r[i] = T(1) / std::sqrt(x[i]);
+    }
+
+    /**
+     * Normalize n vectors of N elements stored one after another,
+     * in and out may be equal
+     */
+    template<std::size_t N>
+    static inline void normalize(const T *in, T *out, std::size_t n)
+    {
+        for (std::size_t i = 0; i < n; i++, in += N, out += N)
+        {
+            T d = T(0);
+            for (std::size_t k = 0; k < N; k++)
+                d += in[k] * in[k];
+            T r = run(d);
+            for (std::size_t k = 0; k < N; k++)
+                out[k] = in[k] * r;
+        }
+    }
+};
 
 /**
  * Two-dimensional vector class
  */
 template<class T>
-class vector2
+class vector<2, T>
 {
     typedef T type;
 
@@ -23,31 +98,31 @@ public:
     /**
      * Construct vector (n, n)
      */
-    explicit vector2(T n = T(0))
+    explicit constexpr vector(T n = T(0)) :
+        x(n), y(n)
     {
-        set(n);
     }
 
     /**
      * Construct vector (x, y)
      */
-    vector2(T x, T y)
+    constexpr vector(T x, T y) :
+        x(x), y(y)
     {
-        set(x, y);
     }
 
     /**
      * Construct vector from array
      */
-    explicit vector2(const T *a)
+    explicit constexpr vector(const T *a) :
+        x(a[0]), y(a[1])
     {
-        set(a);
     }
 
     /**
      * Construct vector (x, y) from (x, y, z)
      */
-    vector2(const vector3<T> &v) :
+    constexpr vector(const vector3<T> &v) :
         x(v.x), y(v.y)
     {
     }
@@ -55,13 +130,8 @@ public:
     /**
      * Construct vector (x / w, y / w) from (x, y, z, w)
      */
-    vector2(const vector4<T> &v)
-    {
-        x = v.x / v.w;
-        y = v.x / v.w;
-    }
-
-    ~vector2()
+    constexpr vector(const vector4<T> &v) :
+        x(v.x / v.w), y(v.y / v.w)
     {
     }
 
@@ -140,7 +210,7 @@ public:
     /**
      * Set vector (n, n)
      */
-    inline vector3<T> &set(T n = T(0))
+    inline constexpr vector2<T> &set(T n = T(0))
     {
         x = n;
         y = n;
@@ -150,7 +220,7 @@ public:
     /**
      * Set vector (x, y)
      */
-    inline vector3<T> &set(T x, T y)
+    inline constexpr vector2<T> &set(T x, T y)
     {
         this->x = x;
         this->y = y;
@@ -160,7 +230,7 @@ public:
     /**
      * Set vector from array
      */
-    inline vector3<T> &set(const T *a)
+    inline constexpr vector2<T> &set(const T *a)
     {
         x = a[0];
         y = a[1];
@@ -170,7 +240,7 @@ public:
     /**
      * Operator +=
      */
-    inline vector2<T> &operator +=(const vector2<T> &rhs)
+    inline constexpr vector2<T> &operator +=(const vector2<T> &rhs)
     {
         x += rhs.x;
         y += rhs.y;
@@ -180,7 +250,7 @@ public:
     /**
      * Operator +
      */
-    inline vector2<T> operator +(const vector2<T> &rhs) const
+    inline constexpr vector2<T> operator +(const vector2<T> &rhs) const
     {
         return vector2<T> (x + rhs.x, y + rhs.y);
     }
@@ -188,7 +258,7 @@ public:
     /**
      * Operator -=
      */
-    inline vector2<T> &operator -=(const vector2<T> &rhs)
+    inline constexpr vector2<T> &operator -=(const vector2<T> &rhs)
     {
         x -= rhs.x;
         y -= rhs.y;
@@ -198,7 +268,7 @@ public:
     /**
      * Operator -
      */
-    inline vector2<T> operator -() const
+    inline constexpr vector2<T> operator -() const
     {
         return vector2<T>(-x, -y);
     }
@@ -206,7 +276,7 @@ public:
     /**
      * Operator -
      */
-    inline vector2<T> operator -(const vector2<T> &rhs) const
+    inline constexpr vector2<T> operator -(const vector2<T> &rhs) const
     {
         return vector2<T> (x - rhs.x, y - rhs.y);
     }
@@ -214,7 +284,7 @@ public:
     /**
      * Operator *=
      */
-    inline vector2<T> &operator *=(T rhs)
+    inline constexpr vector2<T> &operator *=(T rhs)
     {
         x *= rhs;
         y *= rhs;
@@ -224,7 +294,7 @@ public:
     /**
      * Operator *
      */
-    inline vector2<T> operator *(const T rhs) const
+    inline constexpr vector2<T> operator *(const T rhs) const
     {
         return vector2<T> (x * rhs, y * rhs);
     }
@@ -232,7 +302,7 @@ public:
     /**
      * Operator *
      */
-    friend inline vector2<T> operator *(const T lhs, const vector2<T> &rhs)
+    friend inline constexpr vector2<T> operator *(const T lhs, const vector2<T> &rhs)
     {
         return vector2<T> (lhs * rhs.x, lhs * rhs.y);
     }
@@ -240,7 +310,7 @@ public:
     /**
      * Operator /=
      */
-    inline vector2<T> &operator /=(T rhs)
+    inline constexpr vector2<T> &operator /=(T rhs)
     {
         x /= rhs;
         y /= rhs;
@@ -250,7 +320,7 @@ public:
     /**
      * Operator /
      */
-    inline vector2<T> operator /(T rhs) const
+    inline constexpr vector2<T> operator /(T rhs) const
     {
         return vector2<T> (x / rhs, y / rhs);
     }
@@ -258,7 +328,7 @@ public:
     /**
      * Operator ==
      */
-    inline bool operator ==(const vector2<T> &rhs) const
+    inline constexpr bool operator ==(const vector2<T> &rhs) const
     {
         return x == rhs.x && y == rhs.y;
     }
@@ -266,15 +336,15 @@ public:
     /**
      * Operator !=
      */
-    inline bool operator !=(const vector2<T> &rhs) const
+    inline constexpr bool operator !=(const vector2<T> &rhs) const
     {
-        return x != rhs.y || y != rhs.y;
+        return x != rhs.x || y != rhs.y;
     }
 
     /**
      * @return scalar product
      */
-    friend inline T dot(const vector2<T> &lhs, const vector2<T> &rhs)
+    friend inline constexpr T dot(const vector2<T> &lhs, const vector2<T> &rhs)
     {
         return lhs.x * rhs.x + lhs.y * rhs.y;
     }
@@ -295,6 +365,15 @@ public:
         return operator /(norm());
     }
 
+    /**
+     * @return normalized vector, approximation of normalize() by
+     * rsqrt_kernel
+     */
+    inline vector2<T> normalize_fast() const
+    {
+        return operator *(rsqrt_kernel<T>::run(dot(*this, *this)));
+    }
+
     friend inline std::ostream &operator <<(std::ostream &lhs,
                                             const vector2<T> &rhs)
     {
@@ -311,7 +390,7 @@ typedef vector2<long double> vector2ld;
  * Three-dimensional vector class
  */
 template<class T>
-class vector3
+class vector<3, T>
 {
     typedef T type;
 
@@ -321,31 +400,31 @@ public:
     /**
      * Construct vector (n, n, n)
      */
-    explicit vector3(T n = T(0))
+    explicit constexpr vector(T n = T(0)) :
+        x(n), y(n), z(n)
     {
-        set(n);
     }
 
     /**
      * Construct vector (x, y, z)
      */
-    vector3(T x, T y, T z)
+    constexpr vector(T x, T y, T z) :
+        x(x), y(y), z(z)
     {
-        set(x, y, z);
     }
 
     /**
      * Construct vector from array
      */
-    explicit vector3(const T *a)
+    explicit constexpr vector(const T *a) :
+        x(a[0]), y(a[1]), z(a[2])
     {
-        set(a);
     }
 
     /**
      * Construct vector (x, y, z) from (x, y)
      */
-    vector3(const vector2<T> &v, T z = T(0)) :
+    constexpr vector(const vector2<T> &v, T z = T(0)) :
         x(v.x), y(v.y), z(z)
     {
     }
@@ -353,15 +432,8 @@ public:
     /**
      * Construct vector (x / w, y / w, z / w) from (x, y, z, w)
      */
-    vector3(const vector4<T> &v)
-    {
-        T m = 1.0 / v.w;
-        x = v.x * m;
-        y = v.y * m;
-        z = v.z * m;
-    }
-
-    ~vector3()
+    constexpr vector(const vector4<T> &v) :
+        x(v.x / v.w), y(v.y / v.w), z(v.z / v.w)
     {
     }
 
@@ -440,7 +512,7 @@ public:
     /**
      * Set vector (n, n, n)
      */
-    inline vector3<T> &set(T n = T(0))
+    inline constexpr vector3<T> &set(T n = T(0))
     {
         x = n;
         y = n;
@@ -451,7 +523,7 @@ public:
     /**
      * Set vector (x, y, z)
      */
-    inline vector3<T> &set(T x, T y, T z)
+    inline constexpr vector3<T> &set(T x, T y, T z)
     {
         this->x = x;
         this->y = y;
@@ -462,7 +534,7 @@ public:
     /**
      * Set vector from array
      */
-    inline vector3<T> &set(const T *a)
+    inline constexpr vector3<T> &set(const T *a)
     {
         x = a[0];
         y = a[1];
@@ -473,7 +545,7 @@ public:
     /**
      * Operator +=
      */
-    inline vector3<T> &operator +=(const vector3<T> &rhs)
+    inline constexpr vector3<T> &operator +=(const vector3<T> &rhs)
     {
         x += rhs.x;
         y += rhs.y;
@@ -484,7 +556,7 @@ public:
     /**
      * Operator +
      */
-    inline vector3<T> operator +(const vector3<T> &rhs) const
+    inline constexpr vector3<T> operator +(const vector3<T> &rhs) const
     {
         return vector3<T> (x + rhs.x, y + rhs.y, z + rhs.z);
     }
@@ -492,7 +564,7 @@ public:
     /**
      * Operator -=
      */
-    inline vector3<T> &operator -=(const vector3<T> &rhs)
+    inline constexpr vector3<T> &operator -=(const vector3<T> &rhs)
     {
         x -= rhs.x;
         y -= rhs.y;
@@ -503,7 +575,7 @@ public:
     /**
      * Operator -
      */
-    inline vector3<T> operator -() const
+    inline constexpr vector3<T> operator -() const
     {
         return vector3<T>(-x, -y, -z);
     }
@@ -511,7 +583,7 @@ public:
     /**
      * Operator -
      */
-    inline vector3<T> operator -(const vector3<T> &rhs) const
+    inline constexpr vector3<T> operator -(const vector3<T> &rhs) const
     {
         return vector3<T> (x - rhs.x, y - rhs.y, z - rhs.z);
     }
@@ -519,7 +591,7 @@ public:
     /**
      * Operator *=
      */
-    inline vector3<T> &operator *=(T rhs)
+    inline constexpr vector3<T> &operator *=(T rhs)
     {
         x *= rhs;
         y *= rhs;
@@ -530,7 +602,7 @@ public:
     /**
      * Operator *
      */
-    inline vector3<T> operator *(T rhs) const
+    inline constexpr vector3<T> operator *(T rhs) const
     {
         return vector3<T> (x * rhs, y * rhs, z * rhs);
     }
@@ -538,7 +610,7 @@ public:
     /**
      * Operator *
      */
-    friend inline vector3<T> operator *(T lhs, const vector3<T> &rhs)
+    friend inline constexpr vector3<T> operator *(T lhs, const vector3<T> &rhs)
     {
         return vector3<T> (lhs * rhs.x, lhs * rhs.y, lhs * rhs.z);
     }
@@ -546,9 +618,9 @@ public:
     /**
      * Operator /=
      */
-    inline vector3<T> &operator /=(T rhs)
+    inline constexpr vector3<T> &operator /=(T rhs)
     {
-        T m = 1.0 / rhs;
+        T m = T(1) / rhs;
         x *= m;
         y *= m;
         z *= m;
@@ -558,16 +630,16 @@ public:
     /**
      * Operator /
      */
-    inline vector3<T> operator /(T rhs) const
+    inline constexpr vector3<T> operator /(T rhs) const
     {
-        T m = 1.0 / rhs;
+        T m = T(1) / rhs;
         return vector3<T> (x * m, y * m, z * m);
     }
 
     /**
      * Operator ==
      */
-    inline bool operator ==(const vector3<T> &rhs) const
+    inline constexpr bool operator ==(const vector3<T> &rhs) const
     {
         return x == rhs.x && y == rhs.y && z == rhs.z;
     }
@@ -575,7 +647,7 @@ public:
     /**
      * Operator !=
      */
-    inline bool operator !=(const vector3<T> &rhs) const
+    inline constexpr bool operator !=(const vector3<T> &rhs) const
     {
         return x != rhs.x || y != rhs.y || z != rhs.z;
     }
@@ -583,7 +655,7 @@ public:
     /**
      * @return scalar product
      */
-    friend inline T dot(const vector3<T> &lhs, const vector3<T> &rhs)
+    friend inline constexpr T dot(const vector3<T> &lhs, const vector3<T> &rhs)
     {
         return lhs.x * rhs.x + lhs.y * rhs.y + lhs.z * rhs.z;
     }
@@ -591,7 +663,7 @@ public:
     /**
      * @return vector product
      */
-    friend inline vector3<T> cross(const vector3<T> &lhs, const vector3<T> &rhs)
+    friend inline constexpr vector3<T> cross(const vector3<T> &lhs, const vector3<T> &rhs)
     {
         return vector3<T> (lhs.y * rhs.z - lhs.z * rhs.y,
                            lhs.z * rhs.x - lhs.x * rhs.z,
@@ -614,6 +686,15 @@ public:
         return operator /(norm());
     }
 
+    /**
+     * @return normalized vector, approximation of normalize() by
+     * rsqrt_kernel
+     */
+    inline vector3<T> normalize_fast() const
+    {
+        return operator *(rsqrt_kernel<T>::run(dot(*this, *this)));
+    }
+
     friend inline std::ostream &operator <<(std::ostream &lhs,
                                             const vector3<T> &rhs)
     {
@@ -629,7 +710,7 @@ typedef vector3<long double> vector3ld;
  * Homogeneous vector class
  */
 template<class T>
-class vector4
+class vector<4, T>
 {
     typedef T type;
 
@@ -639,31 +720,31 @@ public:
     /**
      * Construct vector (n, n, n, n)
      */
-    explicit vector4(T n = T(0))
+    explicit constexpr vector(T n = T(0)) :
+        x(n), y(n), z(n), w(T(1))
     {
-        set(n);
     }
 
     /**
      * Construct vector (x, y, z, w)
      */
-    vector4(T x, T y, T z, T w = T(1))
+    constexpr vector(T x, T y, T z, T w = T(1)) :
+        x(x), y(y), z(z), w(w)
     {
-        set(x, y, z, w);
     }
 
     /**
      * Construct vector from array
      */
-    explicit vector4(const T *a)
+    explicit constexpr vector(const T *a) :
+        x(a[0]), y(a[1]), z(a[2]), w(a[3])
     {
-        set(a);
     }
 
     /**
      * Construct vector (x, y, z, w) from (x, y)
      */
-    vector4(const vector2<T> &v, T z = T(0), T w = T(1)) :
+    constexpr vector(const vector2<T> &v, T z = T(0), T w = T(1)) :
         x(v.x), y(v.y), z(z), w(w)
     {
     }
@@ -671,15 +752,11 @@ public:
     /**
      * Construct vector (x, y, z, w) from (x, y, z)
      */
-    vector4(const vector3<T> &v, T w = T(1)) :
+    constexpr vector(const vector3<T> &v, T w = T(1)) :
         x(v.x), y(v.y), z(v.z), w(w)
     {
     }
 
-    ~vector4()
-    {
-    }
-
     /**
      * Array access operator
      * @return reference to i element of vector
@@ -755,7 +832,7 @@ public:
     /**
      * Set vector (n, n, n, n)
      */
-    inline vector4<T> &set(T n = T(0))
+    inline constexpr vector4<T> &set(T n = T(0))
     {
         x = n;
         y = n;
@@ -767,7 +844,7 @@ public:
     /**
      * Set vector (x, y, z, w)
      */
-    inline vector4<T> &set(T x, T y, T z, T w = T(1))
+    inline constexpr vector4<T> &set(T x, T y, T z, T w = T(1))
     {
         this->x = x;
         this->y = y;
@@ -779,7 +856,7 @@ public:
     /**
      * Set vector from array
      */
-    inline vector4<T> &set(const T *a)
+    inline constexpr vector4<T> &set(const T *a)
     {
         x = a[0];
         y = a[1];
@@ -791,7 +868,7 @@ public:
     /**
      * Operator +=
      */
-    inline vector4<T> &operator +=(const vector4<T> &rhs)
+    inline constexpr vector4<T> &operator +=(const vector4<T> &rhs)
     {
         x += rhs.x;
         y += rhs.y;
@@ -803,7 +880,7 @@ public:
     /**
      * Operator +
      */
-    inline vector4<T> operator +(const vector4<T> &rhs) const
+    inline constexpr vector4<T> operator +(const vector4<T> &rhs) const
     {
         return vector4<T> (x + rhs.x, y + rhs.y, z + rhs.z, w + rhs.w);
     }
@@ -811,7 +888,7 @@ public:
     /**
      * Operator -=
      */
-    inline vector4<T> &operator -=(const vector4<T> &rhs)
+    inline constexpr vector4<T> &operator -=(const vector4<T> &rhs)
     {
         x -= rhs.x;
         y -= rhs.y;
@@ -823,7 +900,7 @@ public:
     /**
      * Operator -
      */
-    inline vector4<T> operator -() const
+    inline constexpr vector4<T> operator -() const
     {
         return vector4<T>(-x, -y, -z, -w);
     }
@@ -831,7 +908,7 @@ public:
     /**
      * Operator -
      */
-    inline vector4<T> operator -(const vector4<T> &rhs) const
+    inline constexpr vector4<T> operator -(const vector4<T> &rhs) const
     {
         return vector4<T> (x - rhs.x, y - rhs.y, z - rhs.z, w - rhs.w);
     }
@@ -839,7 +916,7 @@ public:
     /**
      * Operator *=
      */
-    inline vector4<T> &operator *=(T rhs)
+    inline constexpr vector4<T> &operator *=(T rhs)
     {
         x *= rhs;
         y *= rhs;
@@ -851,7 +928,7 @@ public:
     /**
      * Operator *
      */
-    inline vector4<T> operator *(T rhs) const
+    inline constexpr vector4<T> operator *(T rhs) const
     {
         return vector4<T> (x * rhs, y * rhs, z * rhs, w * rhs);
     }
@@ -859,7 +936,7 @@ public:
     /**
      * Operator *
      */
-    friend inline vector4<T> operator *(T lhs, const vector4<T> &rhs)
+    friend inline constexpr vector4<T> operator *(T lhs, const vector4<T> &rhs)
     {
         return vector4<T> (lhs * rhs.x, lhs * rhs.y, lhs * rhs.z, lhs * rhs.w);
     }
@@ -867,9 +944,9 @@ public:
     /**
      * Operator /=
      */
-    inline vector4<T> &operator /=(T rhs)
+    inline constexpr vector4<T> &operator /=(T rhs)
     {
-        T m = 1.0 / rhs;
+        T m = T(1) / rhs;
         x *= m;
         y *= m;
         z *= m;
@@ -880,16 +957,16 @@ public:
     /**
      * Operator /
      */
-    inline vector4<T> operator /(T rhs) const
+    inline constexpr vector4<T> operator /(T rhs) const
     {
-        T m = 1.0 / rhs;
+        T m = T(1) / rhs;
         return vector4<T> (x * m, y * m, z * m, w * m);
     }
 
     /**
      * Operator ==
      */
-    inline bool operator ==(const vector4<T> &rhs) const
+    inline constexpr bool operator ==(const vector4<T> &rhs) const
     {
         return x == rhs.x && y == rhs.y && z == rhs.z && w == rhs.w;
     }
@@ -897,7 +974,7 @@ public:
     /**
      * Operator !=
      */
-    inline bool operator !=(const vector4<T> &rhs) const
+    inline constexpr bool operator !=(const vector4<T> &rhs) const
     {
         return x != rhs.x || y != rhs.y || z != rhs.z || w != rhs.w;
     }
@@ -905,7 +982,7 @@ public:
     /**
      * @return scalar product
      */
-    friend inline T dot(const vector4<T> &lhs, const vector4<T> &rhs)
+    friend inline constexpr T dot(const vector4<T> &lhs, const vector4<T> &rhs)
     {
         return lhs.x * rhs.x + lhs.y * rhs.y + lhs.z * rhs.z + lhs.w * rhs.w;
     }
@@ -926,6 +1003,15 @@ public:
         return operator /(norm());
     }
 
+    /**
+     * @return normalized vector, approximation of normalize() by
+     * rsqrt_kernel
+     */
+    inline vector4<T> normalize_fast() const
+    {
+        return operator *(rsqrt_kernel<T>::run(dot(*this, *this)));
+    }
+
     friend inline std::ostream &operator <<(std::ostream &lhs,
                                             const vector4<T> &rhs)
     {
@@ -939,6 +1025,421 @@ public:
 typedef vector4<float> vector4f;
 typedef vector4<double> vector4d;
 typedef vector4<long double> vector4ld;
+
+/**
+ * N-dimensional vector class
+ *
+ * vector2, vector3 and vector4 are specializations with named elements,
+ * other sizes keep elements in array. Element-wise operations are expanded
+ * over index sequences, so they are unrolled at compile time.
+ */
+template<std::size_t N, class T>
+class vector
+{
+    typedef T type;
+    typedef std::make_index_sequence<N> indices;
+
+    T a[N];
+
+    struct fill_tag
+    {
+    };
+
+    struct array_tag
+    {
+    };
+
+    struct elements_tag
+    {
+    };
+
+public:
+    /**
+     * Construct vector (n, ..., n)
+     */
+    explicit constexpr vector(T n = T(0)) :
+        vector(fill_tag(), n, indices())
+    {
+    }
+
+    /**
+     * Construct vector of N elements
+     */
+    template<class... A, class = typename std::enable_if<
+                             (N > 1) && sizeof...(A) == N>::type>
+    constexpr vector(A... e) :
+        a{T(e)...}
+    {
+    }
+
+    /**
+     * Construct vector from array
+     */
+    explicit constexpr vector(const T *a) :
+        vector(array_tag(), a, indices())
+    {
+    }
+
+    /**
+     * @return number of elements
+     */
+    inline constexpr unsigned int get_size() const
+    {
+        return N;
+    }
+
+    /**
+     * Array access operator
+     * @return reference to i element
+     */
+    inline constexpr T &operator [](unsigned int i)
+    {
+        return a[i];
+    }
+
+    /**
+     * Array access operator
+     * @return reference to i element of constant vector
+     */
+    inline constexpr const T &operator [](unsigned int i) const
+    {
+        return a[i];
+    }
+
+    /**
+     * Access operator
+     * @return reference to i element
+     */
+    inline constexpr T &operator ()(unsigned int i)
+    {
+        return a[i];
+    }
+
+    /**
+     * Access operator
+     * @return reference to i element of constant vector
+     */
+    inline constexpr const T &operator ()(unsigned int i) const
+    {
+        return a[i];
+    }
+
+    /**
+     * Type cast
+     * @return array pointer
+     */
+    inline operator T *()
+    {
+        return a;
+    }
+
+    /**
+     * Type cast
+     * @return constant array pointer
+     */
+    inline operator const T *() const
+    {
+        return a;
+    }
+
+    /**
+     * Explicit getter
+     * @return reference to i element
+     */
+    inline constexpr T &get(unsigned int i)
+    {
+        return a[i];
+    }
+
+    /**
+     * Explicit getter
+     * @return reference to i element of constant vector
+     */
+    inline constexpr const T &get(unsigned int i) const
+    {
+        return a[i];
+    }
+
+    /**
+     * Set vector (n, ..., n)
+     */
+    inline constexpr vector<N, T> &set(T n = T(0))
+    {
+        *this = vector<N, T>(n);
+        return *this;
+    }
+
+    /**
+     * Set vector of N elements
+     */
+    template<class... A>
+    inline constexpr typename std::enable_if<(N > 1) && sizeof...(A) == N,
+                                             vector<N, T> &>::type
+    set(A... e)
+    {
+        *this = vector<N, T>(e...);
+        return *this;
+    }
+
+    /**
+     * Set vector from array
+     */
+    inline constexpr vector<N, T> &set(const T *a)
+    {
+        *this = vector<N, T>(a);
+        return *this;
+    }
+
+    /**
+     * Operator +=
+     */
+    inline constexpr vector<N, T> &operator +=(const vector<N, T> &rhs)
+    {
+        *this = *this + rhs;
+        return *this;
+    }
+
+    /**
+     * Operator +
+     */
+    inline constexpr vector<N, T> operator +(const vector<N, T> &rhs) const
+    {
+        return add(rhs, indices());
+    }
+
+    /**
+     * Operator -=
+     */
+    inline constexpr vector<N, T> &operator -=(const vector<N, T> &rhs)
+    {
+        *this = *this - rhs;
+        return *this;
+    }
+
+    /**
+     * Unary operator -
+     */
+    inline constexpr vector<N, T> operator -() const
+    {
+        return neg(indices());
+    }
+
+    /**
+     * Operator -
+     */
+    inline constexpr vector<N, T> operator -(const vector<N, T> &rhs) const
+    {
+        return sub(rhs, indices());
+    }
+
+    /**
+     * Operator *=
+     */
+    inline constexpr vector<N, T> &operator *=(T rhs)
+    {
+        *this = *this * rhs;
+        return *this;
+    }
+
+    /**
+     * Operator *
+     */
+    inline constexpr vector<N, T> operator *(T rhs) const
+    {
+        return mul(rhs, indices());
+    }
+
+    /**
+     * Operator *
+     */
+    friend inline constexpr vector<N, T> operator *(T lhs,
+                                                    const vector<N, T> &rhs)
+    {
+        return rhs * lhs;
+    }
+
+    /**
+     * Operator /=
+     */
+    inline constexpr vector<N, T> &operator /=(T rhs)
+    {
+        *this = *this / rhs;
+        return *this;
+    }
+
+    /**
+     * Operator /
+     */
+    inline constexpr vector<N, T> operator /(T rhs) const
+    {
+        return div(rhs, indices());
+    }
+
+    /**
+     * Operator ==
+     */
+    inline constexpr bool operator ==(const vector<N, T> &rhs) const
+    {
+        for (std::size_t i = 0; i < N; i++)
+            if (a[i] != rhs.a[i])
+                return false;
+        return true;
+    }
+
+    /**
+     * Operator !=
+     */
+    inline constexpr bool operator !=(const vector<N, T> &rhs) const
+    {
+        return !operator ==(rhs);
+    }
+
+    /**
+     * @return scalar product
+     */
+    friend inline constexpr T dot(const vector<N, T> &lhs,
+                                  const vector<N, T> &rhs)
+    {
+        return lhs.inner(rhs, indices());
+    }
+
+    /**
+     * @return vector length
+     */
+    inline T norm() const
+    {
+        return std::sqrt(dot(*this, *this));
+    }
+
+    /**
+     * @return normalized vector
+     */
+    inline vector<N, T> normalize() const
+    {
+        return operator /(norm());
+    }
+
+    /**
+     * @return normalized vector, approximation of normalize() by
+     * rsqrt_kernel
+     */
+    inline vector<N, T> normalize_fast() const
+    {
+        return operator *(rsqrt_kernel<T>::run(dot(*this, *this)));
+    }
+
+    friend inline std::ostream &operator <<(std::ostream &lhs,
+                                            const vector<N, T> &rhs)
+    {
+        lhs << "(";
+        for (std::size_t i = 0; i + 1 < N; i++)
+            lhs << rhs.a[i] << ", ";
+        return lhs << rhs.a[N - 1] << ")";
+    }
+
+private:
+    template<std::size_t... I>
+    constexpr vector(fill_tag, T n, std::index_sequence<I...>) :
+        a{((void)I, n)...}
+    {
+    }
+
+    template<std::size_t... I>
+    constexpr vector(array_tag, const T *p, std::index_sequence<I...>) :
+        a{p[I]...}
+    {
+    }
+
+    template<class... A>
+    constexpr vector(elements_tag, A... e) :
+        a{e...}
+    {
+    }
+
+    template<std::size_t... I>
+    inline constexpr vector<N, T> add(const vector<N, T> &rhs,
+                                      std::index_sequence<I...>) const
+    {
+        return vector<N, T>(elements_tag(), T(a[I] + rhs.a[I])...);
+    }
+
+    template<std::size_t... I>
+    inline constexpr vector<N, T> sub(const vector<N, T> &rhs,
+                                      std::index_sequence<I...>) const
+    {
+        return vector<N, T>(elements_tag(), T(a[I] - rhs.a[I])...);
+    }
+
+    template<std::size_t... I>
+    inline constexpr vector<N, T> neg(std::index_sequence<I...>) const
+    {
+        return vector<N, T>(elements_tag(), T(-a[I])...);
+    }
+
+    template<std::size_t... I>
+    inline constexpr vector<N, T> mul(T rhs, std::index_sequence<I...>) const
+    {
+        return vector<N, T>(elements_tag(), T(a[I] * rhs)...);
+    }
+
+    template<std::size_t... I>
+    inline constexpr vector<N, T> div(T rhs, std::index_sequence<I...>) const
+    {
+        return vector<N, T>(elements_tag(), T(a[I] / rhs)...);
+    }
+
+    template<std::size_t... I>
+    inline constexpr T inner(const vector<N, T> &rhs,
+                             std::index_sequence<I...>) const
+    {
+        return unrolled_sum(T(a[I] * rhs.a[I])...);
+    }
+};
+
+/**
+ * @return I element of vector, constant expression unlike operator []
+ */
+template<std::size_t I, std::size_t N, class T>
+inline constexpr const T &get(const vector<N, T> &v)
+{
+    return v[I];
+}
+
+template<std::size_t I, class T>
+inline constexpr const T &get(const vector<2, T> &v)
+{
+    return I == 0 ? v.x : v.y;
+}
+
+template<std::size_t I, class T>
+inline constexpr const T &get(const vector<3, T> &v)
+{
+    return I == 0 ? v.x : I == 1 ? v.y : v.z;
+}
+
+template<std::size_t I, class T>
+inline constexpr const T &get(const vector<4, T> &v)
+{
+    return I == 0 ? v.x : I == 1 ? v.y : I == 2 ? v.z : v.w;
+}
+
+/**
+ * Normalize n vectors by normalize_fast(), in and out may be equal
+ */
+template<std::size_t N, class T>
+inline void normalize_fast(const vector<N, T> *in, vector<N, T> *out,
+                           std::size_t n)
+{
+    rsqrt_kernel<T>::template normalize<N>(reinterpret_cast<const T *>(in),
+                                           reinterpret_cast<T *>(out), n);
 }
 
+static_assert(std::is_trivially_copyable<vector2<double> >::value &&
+              std::is_trivially_copyable<vector3<double> >::value &&
+              std::is_trivially_copyable<vector4<double> >::value,
+              "vectors must be trivially copyable");
+}
+
+#include "vector_sse.hpp"
+
 #endif
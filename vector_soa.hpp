@@ -0,0 +1,400 @@
+#ifndef _MATH_VECTOR_SOA_
+#define _MATH_VECTOR_SOA_
+
+#include <cstddef>
+#include <cmath>
+#include <cassert>
+#include <vector>
+
+#include "aligned.hpp"
+#include "vector.hpp"
+
+namespace math
+{
+/**
+ * Structure-of-arrays container of three-dimensional vectors
+ *
+ * Components are stored in separate cache-line aligned arrays padded with
+ * zeros to a whole number of lanes, so batch kernels below always run on
+ * full blocks of lanes elements. Operands of binary kernels must have the
+ * same size, without assertions the smaller size is used.
+ */
+template<class T>
+class vector3_soa
+{
+    typedef T type;
+    typedef std::vector<T, aligned_allocator<T> > array;
+
+    array x, y, z;
+    std::size_t size;
+
+public:
+    /**
+     * Number of elements processed by one kernel block
+     */
+    static const std::size_t lanes = 64 / sizeof(T) > 0 ? 64 / sizeof(T) : 1;
+
+    /**
+     * Construct n zero vectors
+     */
+    explicit vector3_soa(std::size_t n = 0) :
+        size(0)
+    {
+        resize(n);
+    }
+
+    /**
+     * Construct from array of n vectors
+     */
+    vector3_soa(const vector3<T> *v, std::size_t n) :
+        size(0)
+    {
+        set(v, n);
+    }
+
+    /**
+     * @return number of vectors
+     */
+    inline std::size_t get_size() const
+    {
+        return size;
+    }
+
+    /**
+     * @return number of vectors including padding
+     */
+    inline std::size_t get_capacity() const
+    {
+        return x.size();
+    }
+
+    /**
+     * Resize container, new vectors are zero
+     */
+    inline void resize(std::size_t n)
+    {
+        std::size_t capacity = (n + lanes - 1) / lanes * lanes;
+        if (n < size)
+            for (std::size_t i = n; i < size; i++)
+                x[i] = y[i] = z[i] = T(0);
+        x.resize(capacity, T(0));
+        y.resize(capacity, T(0));
+        z.resize(capacity, T(0));
+        size = n;
+    }
+
+    inline void clear()
+    {
+        resize(0);
+    }
+
+    inline void push_back(const vector3<T> &v)
+    {
+        resize(size + 1);
+        set(size - 1, v);
+    }
+
+    /**
+     * Explicit getters
+     * @return component array
+     */
+    inline T *get_x()
+    {
+        return x.data();
+    }
+
+    inline const T *get_x() const
+    {
+        return x.data();
+    }
+
+    inline T *get_y()
+    {
+        return y.data();
+    }
+
+    inline const T *get_y() const
+    {
+        return y.data();
+    }
+
+    inline T *get_z()
+    {
+        return z.data();
+    }
+
+    inline const T *get_z() const
+    {
+        return z.data();
+    }
+
+    /**
+     * Explicit getter
+     * @return copy of i vector
+     */
+    inline vector3<T> get(std::size_t i) const
+    {
+        return vector3<T>(x[i], y[i], z[i]);
+    }
+
+    /**
+     * Array access operator
+     * @return copy of i vector
+     */
+    inline vector3<T> operator [](std::size_t i) const
+    {
+        return get(i);
+    }
+
+    /**
+     * Set i vector
+     */
+    inline vector3_soa<T> &set(std::size_t i, const vector3<T> &v)
+    {
+        x[i] = v.x;
+        y[i] = v.y;
+        z[i] = v.z;
+        return *this;
+    }
+
+    /**
+     * Set container from array of n vectors
+     */
+    inline vector3_soa<T> &set(const vector3<T> *v, std::size_t n)
+    {
+        resize(n);
+        for (std::size_t i = 0; i < n; i++)
+            set(i, v[i]);
+        return *this;
+    }
+
+    /**
+     * Copy vectors into array of get_size() vectors
+     */
+    inline void store(vector3<T> *v) const
+    {
+        for (std::size_t i = 0; i < size; i++)
+            v[i].set(x[i], y[i], z[i]);
+    }
+
+    /**
+     * Operator +=, sizes must be equal
+     */
+    inline vector3_soa<T> &operator +=(const vector3_soa<T> &rhs)
+    {
+        add(*this, rhs, *this);
+        return *this;
+    }
+
+    /**
+     * Operator -=, sizes must be equal
+     */
+    inline vector3_soa<T> &operator -=(const vector3_soa<T> &rhs)
+    {
+        sub(*this, rhs, *this);
+        return *this;
+    }
+
+    /**
+     * Operator *=
+     */
+    inline vector3_soa<T> &operator *=(T rhs)
+    {
+        scale(*this, rhs, *this);
+        return *this;
+    }
+
+    /**
+     * out = lhs + rhs, sizes must be equal
+     */
+    friend inline void add(const vector3_soa<T> &lhs,
+                           const vector3_soa<T> &rhs,
+                           vector3_soa<T> &out)
+    {
+        out.resize(common_size(lhs, rhs));
+        add_array(lhs.x.data(), rhs.x.data(), out.x.data(), out.get_capacity());
+        add_array(lhs.y.data(), rhs.y.data(), out.y.data(), out.get_capacity());
+        add_array(lhs.z.data(), rhs.z.data(), out.z.data(), out.get_capacity());
+    }
+
+    /**
+     * out = lhs - rhs, sizes must be equal
+     */
+    friend inline void sub(const vector3_soa<T> &lhs,
+                           const vector3_soa<T> &rhs,
+                           vector3_soa<T> &out)
+    {
+        out.resize(common_size(lhs, rhs));
+        sub_array(lhs.x.data(), rhs.x.data(), out.x.data(), out.get_capacity());
+        sub_array(lhs.y.data(), rhs.y.data(), out.y.data(), out.get_capacity());
+        sub_array(lhs.z.data(), rhs.z.data(), out.z.data(), out.get_capacity());
+    }
+
+    /**
+     * out = lhs * rhs
+     */
+    friend inline void scale(const vector3_soa<T> &lhs, T rhs,
+                             vector3_soa<T> &out)
+    {
+        out.resize(lhs.size);
+        scale_array(lhs.x.data(), rhs, out.x.data(), lhs.get_capacity());
+        scale_array(lhs.y.data(), rhs, out.y.data(), lhs.get_capacity());
+        scale_array(lhs.z.data(), rhs, out.z.data(), lhs.get_capacity());
+    }
+
+    /**
+     * Scalar products of get_size() pairs into out, sizes must be equal
+     */
+    friend inline void dot(const vector3_soa<T> &lhs,
+                           const vector3_soa<T> &rhs, T *out)
+    {
+        std::size_t n = common_size(lhs, rhs);
+        for (std::size_t b = 0; b < n; b += lanes)
+        {
+            T r[lanes];
+            for (std::size_t l = 0; l < lanes; l++)
+                r[l] = lhs.x[b + l] * rhs.x[b + l] +
+                       lhs.y[b + l] * rhs.y[b + l] +
+                       lhs.z[b + l] * rhs.z[b + l];
+            store_block(r, out + b, n - b);
+        }
+    }
+
+    /**
+     * Vector products of get_size() pairs into out, sizes must be equal
+     */
+    friend inline void cross(const vector3_soa<T> &lhs,
+                             const vector3_soa<T> &rhs,
+                             vector3_soa<T> &out)
+    {
+        out.resize(common_size(lhs, rhs));
+        for (std::size_t b = 0; b < out.get_capacity(); b += lanes)
+        {
+            T rx[lanes], ry[lanes], rz[lanes];
+            for (std::size_t l = 0; l < lanes; l++)
+            {
+                rx[l] = lhs.y[b + l] * rhs.z[b + l] - lhs.z[b + l] * rhs.y[b + l];
+                ry[l] = lhs.z[b + l] * rhs.x[b + l] - lhs.x[b + l] * rhs.z[b + l];
+                rz[l] = lhs.x[b + l] * rhs.y[b + l] - lhs.y[b + l] * rhs.x[b + l];
+            }
+            for (std::size_t l = 0; l < lanes; l++)
+            {
+                out.x[b + l] = rx[l];
+                out.y[b + l] = ry[l];
+                out.z[b + l] = rz[l];
+            }
+        }
+    }
+
+    /**
+     * Vector lengths of get_size() vectors into out
+     */
+    friend inline void norm(const vector3_soa<T> &v, T *out)
+    {
+        for (std::size_t b = 0; b < v.size; b += lanes)
+        {
+            T r[lanes];
+            for (std::size_t l = 0; l < lanes; l++)
+                r[l] = std::sqrt(v.x[b + l] * v.x[b + l] +
+                                 v.y[b + l] * v.y[b + l] +
+                                 v.z[b + l] * v.z[b + l]);
+            store_block(r, out + b, v.size - b);
+        }
+    }
+
+    /**
+     * Normalized vectors into out, padding stays zero
+     */
+    friend inline void normalize(const vector3_soa<T> &v, vector3_soa<T> &out)
+    {
+        out.resize(v.size);
+        for (std::size_t b = 0; b < v.get_capacity(); b += lanes)
+        {
+            T rx[lanes], ry[lanes], rz[lanes];
+            for (std::size_t l = 0; l < lanes; l++)
+            {
+                T n = v.x[b + l] * v.x[b + l] +
+                      v.y[b + l] * v.y[b + l] +
+                      v.z[b + l] * v.z[b + l];
+                T m = n > T(0) ? T(1) / std::sqrt(n) : T(0);
+                rx[l] = v.x[b + l] * m;
+                ry[l] = v.y[b + l] * m;
+                rz[l] = v.z[b + l] * m;
+            }
+            for (std::size_t l = 0; l < lanes; l++)
+            {
+                out.x[b + l] = rx[l];
+                out.y[b + l] = ry[l];
+                out.z[b + l] = rz[l];
+            }
+        }
+    }
+
+private:
+    /**
+     * @return size of binary kernel result, out may alias operands as it
+     * only shrinks to it without reallocation
+     */
+    static inline std::size_t common_size(const vector3_soa<T> &lhs,
+                                          const vector3_soa<T> &rhs)
+    {
+        assert(lhs.size == rhs.size);
+        return lhs.size < rhs.size ? lhs.size : rhs.size;
+    }
+
+    static inline void add_array(const T *lhs, const T *rhs, T *out, std::size_t n)
+    {
+        for (std::size_t b = 0; b < n; b += lanes)
+        {
+            T r[lanes];
+            for (std::size_t l = 0; l < lanes; l++)
+                r[l] = lhs[b + l] + rhs[b + l];
+            for (std::size_t l = 0; l < lanes; l++)
+                out[b + l] = r[l];
+        }
+    }
+
+    static inline void sub_array(const T *lhs, const T *rhs, T *out, std::size_t n)
+    {
+        for (std::size_t b = 0; b < n; b += lanes)
+        {
+            T r[lanes];
+            for (std::size_t l = 0; l < lanes; l++)
+                r[l] = lhs[b + l] - rhs[b + l];
+            for (std::size_t l = 0; l < lanes; l++)
+                out[b + l] = r[l];
+        }
+    }
+
+    static inline void scale_array(const T *lhs, T rhs, T *out, std::size_t n)
+    {
+        for (std::size_t b = 0; b < n; b += lanes)
+        {
+            T r[lanes];
+            for (std::size_t l = 0; l < lanes; l++)
+                r[l] = lhs[b + l] * rhs;
+            for (std::size_t l = 0; l < lanes; l++)
+                out[b + l] = r[l];
+        }
+    }
+
+    static inline void store_block(const T *r, T *out, std::size_t n)
+    {
+        if (n >= lanes)
+            for (std::size_t l = 0; l < lanes; l++)
+                out[l] = r[l];
+        else
+            for (std::size_t l = 0; l < n; l++)
+                out[l] = r[l];
+    }
+};
+
+template<class T>
+const std::size_t vector3_soa<T>::lanes;
+
+typedef vector3_soa<float> vector3f_soa;
+typedef vector3_soa<double> vector3d_soa;
+typedef vector3_soa<long double> vector3ld_soa;
+}
+
+#endif
@@ -0,0 +1,522 @@
+#ifndef _MATH_VECTOR_SSE_
+#define _MATH_VECTOR_SSE_
+
+#include <cstddef>
+#include <type_traits>
+
+#include "simd.hpp"
+#include "vector.hpp"
+
+#ifdef MATH_SSE
+
+namespace math
+{
+/**
+ * Reciprocal square root, SSE specialization
+ *
+ * rsqrtps estimate has relative error below 1.5 * 2^-12, one Newton-Raphson
+ * step brings it below 2.5e-7.
+ */
+template<>
+struct rsqrt_kernel<float>
+{
+    /**
+     * @return approximate 1 / sqrt(x)
+     */
+    static inline float run(float x)
+    {
+        __m128 m = _mm_set_ss(x);
+        return _mm_cvtss_f32(refine(m, _mm_rsqrt_ss(m)));
+    }
+
+    /**
+     * Set r[i] = approximate 1 / sqrt(x[i]) for i < n, x and r may be equal
+     */
+    static inline void run(const float *x, float *r, std::size_t n)
+    {
+        std::size_t i = 0;
+#ifdef MATH_AVX
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256 m = _mm256_loadu_ps(x + i);
+            _mm256_storeu_ps(r + i, refine(m, _mm256_rsqrt_ps(m)));
+        }
+#endif
+        for (; i + 4 <= n; i += 4)
+        {
+            __m128 m = _mm_loadu_ps(x + i);
+            _mm_storeu_ps(r + i, refine(m, _mm_rsqrt_ps(m)));
+        }
+        for (; i < n; i++)
+            r[i] = run(x[i]);
+    }
+
+    /**
+     * Normalize n vectors of N elements stored one after another, four
+     * vectors per block, in and out may be equal
+     */
+    template<std::size_t N>
+    static inline void normalize(const float *in, float *out, std::size_t n)
+    {
+        std::size_t i = 0;
+        for (; i + 4 <= n; i += 4, in += 4 * N, out += 4 * N)
+            block(in, out, std::integral_constant<std::size_t, N>());
+        for (; i < n; i++, in += N, out += N)
+        {
+            float d = 0.0f;
+            for (std::size_t k = 0; k < N; k++)
+                d += in[k] * in[k];
+            float r = run(d);
+            for (std::size_t k = 0; k < N; k++)
+                out[k] = in[k] * r;
+        }
+    }
+
+    /**
+     * @return Newton-Raphson step y * (1.5 - 0.5 * x * y * y) for
+     * estimate y of 1 / sqrt(x)
+     */
+    static inline __m128 refine(__m128 x, __m128 y)
+    {
+        __m128 h = _mm_mul_ps(_mm_set1_ps(0.5f), x);
+        return _mm_mul_ps(y, _mm_sub_ps(_mm_set1_ps(1.5f),
+                                        _mm_mul_ps(h, _mm_mul_ps(y, y))));
+    }
+
+#ifdef MATH_AVX
+    static inline __m256 refine(__m256 x, __m256 y)
+    {
+        __m256 h = _mm256_mul_ps(_mm256_set1_ps(0.5f), x);
+        return _mm256_mul_ps(y, _mm256_sub_ps(_mm256_set1_ps(1.5f),
+                             _mm256_mul_ps(h, _mm256_mul_ps(y, y))));
+    }
+#endif
+
+private:
+    /**
+     * @return reciprocal lengths of four vectors with squared elements
+     * (x0, y0, x1, y1) and (x2, y2, x3, y3)
+     */
+    static inline __m128 reciprocal(__m128 s0, __m128 s1)
+    {
+        __m128 e = _mm_shuffle_ps(s0, s1, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 o = _mm_shuffle_ps(s0, s1, _MM_SHUFFLE(3, 1, 3, 1));
+        __m128 d = _mm_add_ps(e, o);
+        return refine(d, _mm_rsqrt_ps(d));
+    }
+
+    static inline void block(const float *in, float *out,
+                             std::integral_constant<std::size_t, 2>)
+    {
+        __m128 a0 = _mm_loadu_ps(in), a1 = _mm_loadu_ps(in + 4);
+        __m128 r = reciprocal(_mm_mul_ps(a0, a0), _mm_mul_ps(a1, a1));
+        _mm_storeu_ps(out, _mm_mul_ps(a0, _mm_unpacklo_ps(r, r)));
+        _mm_storeu_ps(out + 4, _mm_mul_ps(a1, _mm_unpackhi_ps(r, r)));
+    }
+
+    /**
+     * Registers hold (x0, y0, z0, x1), (y1, z1, x2, y2), (z2, x3, y3, z3),
+     * squares are gathered into x, y and z of four vectors
+     */
+    static inline void block(const float *in, float *out,
+                             std::integral_constant<std::size_t, 3>)
+    {
+        __m128 a0 = _mm_loadu_ps(in), a1 = _mm_loadu_ps(in + 4);
+        __m128 a2 = _mm_loadu_ps(in + 8);
+        __m128 s0 = _mm_mul_ps(a0, a0), s1 = _mm_mul_ps(a1, a1);
+        __m128 s2 = _mm_mul_ps(a2, a2);
+        __m128 t = _mm_shuffle_ps(s1, s2, _MM_SHUFFLE(1, 0, 3, 2));
+        __m128 u = _mm_shuffle_ps(s0, s1, _MM_SHUFFLE(1, 0, 3, 2));
+        __m128 x = _mm_shuffle_ps(s0, t, _MM_SHUFFLE(3, 0, 3, 0));
+        __m128 p = _mm_shuffle_ps(s0, u, _MM_SHUFFLE(2, 2, 1, 1));
+        __m128 q = _mm_shuffle_ps(t, s2, _MM_SHUFFLE(2, 2, 1, 1));
+        __m128 y = _mm_shuffle_ps(p, q, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 w = _mm_shuffle_ps(t, s2, _MM_SHUFFLE(3, 3, 2, 2));
+        __m128 z = _mm_shuffle_ps(u, w, _MM_SHUFFLE(2, 0, 3, 0));
+        __m128 d = _mm_add_ps(_mm_add_ps(x, y), z);
+        __m128 r = refine(d, _mm_rsqrt_ps(d));
+        _mm_storeu_ps(out, _mm_mul_ps(a0, _mm_shuffle_ps(r, r,
+                                          _MM_SHUFFLE(1, 0, 0, 0))));
+        _mm_storeu_ps(out + 4, _mm_mul_ps(a1, _mm_shuffle_ps(r, r,
+                                              _MM_SHUFFLE(2, 2, 1, 1))));
+        _mm_storeu_ps(out + 8, _mm_mul_ps(a2, _mm_shuffle_ps(r, r,
+                                              _MM_SHUFFLE(3, 3, 3, 2))));
+    }
+
+    static inline void block(const float *in, float *out,
+                             std::integral_constant<std::size_t, 4>)
+    {
+        __m128 a0 = _mm_loadu_ps(in), a1 = _mm_loadu_ps(in + 4);
+        __m128 a2 = _mm_loadu_ps(in + 8), a3 = _mm_loadu_ps(in + 12);
+        __m128 s0 = _mm_mul_ps(a0, a0), s1 = _mm_mul_ps(a1, a1);
+        __m128 s2 = _mm_mul_ps(a2, a2), s3 = _mm_mul_ps(a3, a3);
+        _MM_TRANSPOSE4_PS(s0, s1, s2, s3);
+        __m128 d = _mm_add_ps(_mm_add_ps(s0, s1), _mm_add_ps(s2, s3));
+        __m128 r = refine(d, _mm_rsqrt_ps(d));
+        _mm_storeu_ps(out, _mm_mul_ps(a0, _mm_shuffle_ps(r, r,
+                                          _MM_SHUFFLE(0, 0, 0, 0))));
+        _mm_storeu_ps(out + 4, _mm_mul_ps(a1, _mm_shuffle_ps(r, r,
+                                              _MM_SHUFFLE(1, 1, 1, 1))));
+        _mm_storeu_ps(out + 8, _mm_mul_ps(a2, _mm_shuffle_ps(r, r,
+                                              _MM_SHUFFLE(2, 2, 2, 2))));
+        _mm_storeu_ps(out + 12, _mm_mul_ps(a3, _mm_shuffle_ps(r, r,
+                                               _MM_SHUFFLE(3, 3, 3, 3))));
+    }
+
+    /**
+     * Other sizes, squared lengths are summed per vector
+     */
+    template<std::size_t N>
+    static inline void block(const float *in, float *out,
+                             std::integral_constant<std::size_t, N>)
+    {
+        float d[4];
+        for (std::size_t l = 0; l < 4; l++)
+        {
+            d[l] = 0.0f;
+            for (std::size_t k = 0; k < N; k++)
+                d[l] += in[N * l + k] * in[N * l + k];
+        }
+        __m128 m = _mm_setr_ps(d[0], d[1], d[2], d[3]);
+        _mm_storeu_ps(d, refine(m, _mm_rsqrt_ps(m)));
+        for (std::size_t l = 0; l < 4; l++)
+            for (std::size_t k = 0; k < N; k++)
+                out[N * l + k] = in[N * l + k] * d[l];
+    }
+};
+
+/**
+ * Homogeneous vector class, SSE specialization
+ *
+ * Construction is constexpr, arithmetic runs on registers at run time.
+ */
+template<>
+class alignas(16) vector<4, float>
+{
+    typedef float type;
+
+public:
+    float x, y, z, w;
+
+    /**
+     * Construct vector (n, n, n, 1)
+     */
+    explicit constexpr vector(float n = 0.0f) :
+        x(n), y(n), z(n), w(1.0f)
+    {
+    }
+
+    /**
+     * Construct vector (x, y, z, w)
+     */
+    constexpr vector(float x, float y, float z, float w = 1.0f) :
+        x(x), y(y), z(z), w(w)
+    {
+    }
+
+    /**
+     * Construct vector from array
+     */
+    explicit constexpr vector(const float *a) :
+        x(a[0]), y(a[1]), z(a[2]), w(a[3])
+    {
+    }
+
+    /**
+     * Construct vector (x, y, z, w) from (x, y)
+     */
+    constexpr vector(const vector2<float> &v, float z = 0.0f,
+                      float w = 1.0f) :
+        x(v.x), y(v.y), z(z), w(w)
+    {
+    }
+
+    /**
+     * Construct vector (x, y, z, w) from (x, y, z)
+     */
+    constexpr vector(const vector3<float> &v, float w = 1.0f) :
+        x(v.x), y(v.y), z(v.z), w(w)
+    {
+    }
+
+    /**
+     * Construct vector from register
+     */
+    explicit vector(__m128 m)
+    {
+        set_simd(m);
+    }
+
+    /**
+     * Array access operator
+     * @return reference to i element of vector
+     */
+    inline float &operator [](unsigned int i)
+    {
+        return get(i);
+    }
+
+    /**
+     * Array access
+     * @return reference to i element of constant vector
+     */
+    inline const float &operator [](unsigned int i) const
+    {
+        return get(i);
+    }
+
+    /**
+     * Access operator
+     * @return reference to i element of vector
+     */
+    inline float &operator ()(unsigned int i)
+    {
+        return get(i);
+    }
+
+    /**
+     * Access operator
+     * @return reference to i element of constant vector
+     */
+    inline const float &operator ()(unsigned int i) const
+    {
+        return get(i);
+    }
+
+    /**
+     * Type cast
+     * @return array pointer
+     */
+    inline operator float *()
+    {
+        return &x;
+    }
+
+    /**
+     * Type cast
+     * @return constant array pointer
+     */
+    inline operator const float *() const
+    {
+        return &x;
+    }
+
+    /**
+     * Explicit getter
+     * @return reference to i element of vector
+     */
+    inline float &get(unsigned int i)
+    {
+        return *(&x + i);
+    }
+
+    /**
+     * Explicit getter
+     * @return reference to i element of constant vector
+     */
+    inline const float &get(unsigned int i) const
+    {
+        return *(&x + i);
+    }
+
+    /**
+     * Explicit getter
+     * @return vector loaded into register
+     */
+    inline __m128 get_simd() const
+    {
+        return _mm_load_ps(&x);
+    }
+
+    /**
+     * Set vector (n, n, n, 1)
+     */
+    inline vector4<float> &set(float n = 0.0f)
+    {
+        return set_simd(_mm_setr_ps(n, n, n, 1.0f));
+    }
+
+    /**
+     * Set vector (x, y, z, w)
+     */
+    inline vector4<float> &set(float x, float y, float z, float w = 1.0f)
+    {
+        return set_simd(_mm_setr_ps(x, y, z, w));
+    }
+
+    /**
+     * Set vector from array
+     */
+    inline vector4<float> &set(const float *a)
+    {
+        return set_simd(_mm_loadu_ps(a));
+    }
+
+    /**
+     * Set vector from register
+     */
+    inline vector4<float> &set_simd(__m128 m)
+    {
+        _mm_store_ps(&x, m);
+        return *this;
+    }
+
+    /**
+     * Operator +=
+     */
+    inline vector4<float> &operator +=(const vector4<float> &rhs)
+    {
+        return set_simd(_mm_add_ps(get_simd(), rhs.get_simd()));
+    }
+
+    /**
+     * Operator +
+     */
+    inline vector4<float> operator +(const vector4<float> &rhs) const
+    {
+        return vector4<float>(_mm_add_ps(get_simd(), rhs.get_simd()));
+    }
+
+    /**
+     * Operator -=
+     */
+    inline vector4<float> &operator -=(const vector4<float> &rhs)
+    {
+        return set_simd(_mm_sub_ps(get_simd(), rhs.get_simd()));
+    }
+
+    /**
+     * Operator -
+     */
+    inline vector4<float> operator -() const
+    {
+        return vector4<float>(_mm_xor_ps(get_simd(), _mm_set1_ps(-0.0f)));
+    }
+
+    /**
+     * Operator -
+     */
+    inline vector4<float> operator -(const vector4<float> &rhs) const
+    {
+        return vector4<float>(_mm_sub_ps(get_simd(), rhs.get_simd()));
+    }
+
+    /**
+     * Operator *=
+     */
+    inline vector4<float> &operator *=(float rhs)
+    {
+        return set_simd(_mm_mul_ps(get_simd(), _mm_set1_ps(rhs)));
+    }
+
+    /**
+     * Operator *
+     */
+    inline vector4<float> operator *(float rhs) const
+    {
+        return vector4<float>(_mm_mul_ps(get_simd(), _mm_set1_ps(rhs)));
+    }
+
+    /**
+     * Operator *
+     */
+    friend inline vector4<float> operator *(float lhs,
+                                            const vector4<float> &rhs)
+    {
+        return vector4<float>(_mm_mul_ps(_mm_set1_ps(lhs), rhs.get_simd()));
+    }
+
+    /**
+     * Operator /=
+     */
+    inline vector4<float> &operator /=(float rhs)
+    {
+        return operator *=(1.0f / rhs);
+    }
+
+    /**
+     * Operator /
+     */
+    inline vector4<float> operator /(float rhs) const
+    {
+        return operator *(1.0f / rhs);
+    }
+
+    /**
+     * Operator ==
+     */
+    inline bool operator ==(const vector4<float> &rhs) const
+    {
+        return _mm_movemask_ps(_mm_cmpeq_ps(get_simd(), rhs.get_simd())) == 0xf;
+    }
+
+    /**
+     * Operator !=
+     */
+    inline bool operator !=(const vector4<float> &rhs) const
+    {
+        return !operator ==(rhs);
+    }
+
+    /**
+     * @return scalar product broadcast to all lanes
+     */
+    static inline __m128 dot_simd(__m128 lhs, __m128 rhs)
+    {
+        __m128 m = _mm_mul_ps(lhs, rhs);
+        m = _mm_add_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_add_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+    }
+
+    /**
+     * @return scalar product
+     */
+    friend inline float dot(const vector4<float> &lhs,
+                            const vector4<float> &rhs)
+    {
+        return _mm_cvtss_f32(dot_simd(lhs.get_simd(), rhs.get_simd()));
+    }
+
+    /**
+     * @return vector length
+     */
+    inline float norm() const
+    {
+        __m128 m = get_simd();
+        return _mm_cvtss_f32(_mm_sqrt_ss(dot_simd(m, m)));
+    }
+
+    /**
+     * @return normalized vector
+     */
+    inline vector4<float> normalize() const
+    {
+        __m128 m = get_simd();
+        return vector4<float>(_mm_div_ps(m, _mm_sqrt_ps(dot_simd(m, m))));
+    }
+
+    /**
+     * @return normalized vector, approximation of normalize() by
+     * rsqrt_kernel
+     */
+    inline vector4<float> normalize_fast() const
+    {
+        __m128 m = get_simd(), d = dot_simd(m, m);
+        return vector4<float>(_mm_mul_ps(m, rsqrt_kernel<float>::refine(
+                                                d, _mm_rsqrt_ps(d))));
+    }
+
+    friend inline std::ostream &operator <<(std::ostream &lhs,
+                                            const vector4<float> &rhs)
+    {
+        return lhs << "(" << rhs.x << ", "
+                          << rhs.y << ", "
+                          << rhs.z << ", "
+                          << rhs.w << ")";
+    }
+};
+}
+
+#endif
+
+#endif